@@ -47,6 +47,18 @@ fi
 cd $home
 echo "download fdk-aac success"
 
+#download opus
+echo "download opus..."
+cd $home
+OPUS_DIR=./opus
+if [ ! -d "$OPUS_DIR" ]; then
+    wget --no-check-certificate https://downloads.xiph.org/releases/opus/opus-1.3.1.tar.gz
+    tar xzvf opus-1.3.1.tar.gz
+    mv opus-1.3.1 opus
+fi
+cd $home
+echo "download opus success"
+
 ##compile x264
 echo "compile x264..."
 cd $home/x264
@@ -74,17 +86,29 @@ cp -rf ./lib/* $home/ffmpeg/lib/fdk-aac
 cd $home
 echo "compile fdk-aac success"
 
+##compile opus
+echo "compile opus..."
+cd $home/opus
+./configure --prefix=$home/opus --enable-static --disable-shared --with-pic --disable-doc --disable-extra-programs
+make && make install
+mkdir -p $home/ffmpeg/include/opus
+cp -rf ./include/opus/* $home/ffmpeg/include/opus
+mkdir -p $home/ffmpeg/lib/opus
+cp -rf ./lib/* $home/ffmpeg/lib/opus
+cd $home
+echo "compile opus success"
+
 ##compile ffmpeg
 echo "compile ffmpeg..."
 cd $home/ffmpeg
 echo `pwd`
-PKG_CONFIG_PATH=./lib/x264:./lib/fdk-aac/pkgconfig ./configure --disable-yasm --enable-static --enable-gpl --disable-vdpau --disable-doc --disable-avdevice\
+PKG_CONFIG_PATH=./lib/x264:./lib/fdk-aac/pkgconfig:./lib/opus/pkgconfig ./configure --disable-yasm --enable-static --enable-gpl --disable-vdpau --disable-doc --disable-avdevice\
     --disable-postproc --enable-avfilter --disable-network --enable-memalign-hack --enable-libx264 --disable-lzma\
-    --enable-decoder=h264 --enable-decoder=hevc --enable-decoder=aac --enable-encoder=aac --enable-libfdk-aac --enable-nonfree\
+    --enable-decoder=h264 --enable-decoder=hevc --enable-decoder=aac --enable-encoder=aac --enable-libfdk-aac --enable-libopus --enable-nonfree\
     --disable-devices --disable-vaapi  --enable-hardcoded-tables --enable-decoder=svq3  --enable-protocol=file --enable-small\
-    --extra-cflags='-fPIC -I/usr/local/include -I./include/x264 -I./include/fdk-aac'\
-    --extra-ldflags='-L/local/lib -L/usr/local/lib -L./lib/x264 -L./lib/fdk-aac'\
-    --extra-libs="./lib/x264/libx264.a ./lib/fdk-aac/libfdk-aac.a -lstdc++ -ldl"\
+    --extra-cflags='-fPIC -I/usr/local/include -I./include/x264 -I./include/fdk-aac -I./include/opus'\
+    --extra-ldflags='-L/local/lib -L/usr/local/lib -L./lib/x264 -L./lib/fdk-aac -L./lib/opus'\
+    --extra-libs="./lib/x264/libx264.a ./lib/fdk-aac/libfdk-aac.a ./lib/opus/libopus.a -lstdc++ -ldl"\
     --enable-runtime-cpudetect --prefix=.
 
 make -j 10 && make install
@@ -100,6 +124,7 @@ cp -rf $home/ffmpeg/include/* $dir/include
 cp -rf $home/ffmpeg/lib/*.a $dir/lib
 cp -rf $home/ffmpeg/lib/x264/*.a $dir/lib
 cp -rf $home/ffmpeg/lib/fdk-aac/*.a $dir/lib
+cp -rf $home/ffmpeg/lib/opus/*.a $dir/lib
 
 cp -rvf $home/ffmpeg/libavformat/avc.h $dir/include/libavformat
 cp -rvf $home/ffmpeg/libavutil/atomic.h $dir/include/libavutil
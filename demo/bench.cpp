@@ -0,0 +1,482 @@
+#include "Log.h"
+#include "MixSdk.h"
+#include "Util.h"
+
+#include "json/json.h"
+
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace hercules;
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using std::ifstream;
+
+// 每个job的统计
+struct BenchJob
+{
+    BenchJob() : m_task(nullptr), m_stop(false), m_videoFrames(0)
+    {
+    }
+
+    string m_taskId;
+    string m_json;
+    MixTask *m_task;
+    std::thread m_feeder;
+    std::atomic<bool> m_stop;
+
+    std::atomic<uint32_t> m_videoFrames;
+    std::mutex m_latencyMutex;
+    vector<uint32_t> m_latencies;
+};
+
+// 按处理顺序输出的各阶段, 与LatencyStage一致
+static const char* kBenchStages[] = {
+    "recv_deliver", "deliver_decode", "decode_mixed", "mixed_encode", "encode_send", "end_to_end"
+};
+
+struct BenchResult
+{
+    double m_avgFps;
+    double m_minFps;
+    uint32_t m_p50;
+    uint32_t m_p90;
+    uint32_t m_p99;
+    // 各阶段视频延迟p99, 取所有job和输入中最差的一个
+    std::map<string, uint32_t> m_stageP99;
+    double m_cpuPerJob;
+    double m_maxCpuJob;
+    double m_sharedCpu;
+    long m_peakRssKb;
+};
+
+void usage(const char* errmsg)
+{
+    cerr << errmsg << endl;
+    cerr << "usage:" << endl;
+    cerr << "   ./mixbench configPath [maxJobs] [inputsPerJob] [stepSeconds] [jobStep] [maxP99Ms] [decodeQuality]" << endl;
+    cerr << "   maxJobs      最多启动的job数, 默认64" << endl;
+    cerr << "   inputsPerJob 每个job的输入流数, 0表示使用配置中的输入, 默认0" << endl;
+    cerr << "   stepSeconds  每一档的统计时长(秒), 默认10" << endl;
+    cerr << "   jobStep      每一档新增的job数, 默认1" << endl;
+    cerr << "   maxP99Ms     输出延迟p99上限(毫秒), 默认1000" << endl;
+    cerr << "   decodeQuality full/balanced/fast, 覆盖配置中的decode_quality" << endl;
+}
+
+void logCallback(const std::string& s)
+{
+    std::cout << s << std::endl;
+}
+
+bool readJson(const string& configFile, Json::Value& root)
+{
+    ifstream fs(configFile);
+    if (!fs)
+    {
+        logErr(MIXLOG << configFile << " open file failed.");
+        return false;
+    }
+
+    Json::Reader reader;
+    if (!reader.parse(fs, root, false))
+    {
+        logErr(MIXLOG << configFile << " read json failed. REASON:"
+               << reader.getFormattedErrorMessages());
+        return false;
+    }
+    return true;
+}
+
+// 以配置为模板生成第index个job的json, inputs>0时用第一个流平铺出inputs个输入,
+// 文字/图片/gif等其他元素保持不变
+Json::Value makeJobConfig(const Json::Value& tmpl, int index, int inputs)
+{
+    Json::Value root = tmpl;
+    root["task_id"] = tmpl["task_id"].asString() + "_bench_" + std::to_string(index);
+    root["out_stream"]["stream_name"] =
+        tmpl["out_stream"]["stream_name"].asString() + "_" + std::to_string(index);
+    root["out_stream"]["push_type"] = "local";
+
+    if (inputs <= 0)
+    {
+        return root;
+    }
+
+    Json::Value streamTmpl;
+    Json::Value others(Json::arrayValue);
+    for (auto iter = tmpl["input_stream_list"].begin();
+            iter != tmpl["input_stream_list"].end();
+            ++iter)
+    {
+        const Json::Value& val = *iter;
+        if (val["type"].asString() == "av_stream")
+        {
+            if (streamTmpl.isNull())
+            {
+                streamTmpl = val;
+            }
+            continue;
+        }
+        others.append(val);
+    }
+
+    if (streamTmpl.isNull())
+    {
+        return root;
+    }
+
+    int width = tmpl["out_stream"]["codec"]["video"]["width"].asInt();
+    int height = tmpl["out_stream"]["codec"]["video"]["height"].asInt();
+    int cols = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(inputs))));
+    int rows = (inputs + cols - 1) / cols;
+    int tileW = width / cols / 2 * 2;
+    int tileH = height / rows / 2 * 2;
+
+    Json::Value list(Json::arrayValue);
+    for (int i = 0; i < inputs; ++i)
+    {
+        Json::Value val = streamTmpl;
+        val["stream_name"] = "input_" + std::to_string(i);
+        val["z_order"] = i;
+        val["put_rect"]["left"] = (i % cols) * tileW;
+        val["put_rect"]["top"] = (i / cols) * tileH;
+        val["put_rect"]["right"] = (i % cols + 1) * tileW;
+        val["put_rect"]["bottom"] = (i / cols + 1) * tileH;
+        list.append(val);
+    }
+    for (auto iter = others.begin(); iter != others.end(); ++iter)
+    {
+        list.append(*iter);
+    }
+    root["input_stream_list"] = list;
+
+    return root;
+}
+
+void onJobData(BenchJob* job, const AVData& data)
+{
+    if (data.m_dataType != DATA_TYPE_FLV_VIDEO)
+    {
+        return;
+    }
+
+    ++job->m_videoFrames;
+
+    // 输出dts是合成时刻的运行时间, 差值即合成->编码->发送的延迟
+    uint32_t latency = TimestampAdjuster::getElapseFromServerStart() - data.m_dts;
+    std::unique_lock<std::mutex> lock(job->m_latencyMutex);
+    job->m_latencies.push_back(latency);
+}
+
+void feedJob(BenchJob* job)
+{
+    uint64_t preUpdateMs = getNowMs();
+    while (!job->m_stop)
+    {
+        // job 10s没有收到json会超时, 输入数据由job的文件输入自己读取
+        if (getNowMs() - preUpdateMs > 5000)
+        {
+            job->m_task->updateJson(job->m_json);
+            preUpdateMs = getNowMs();
+        }
+        sleepms(10);
+    }
+}
+
+bool startJob(BenchJob* job, const Json::Value& root)
+{
+    Json::FastWriter writer;
+    job->m_taskId = root["task_id"].asString();
+    job->m_json = writer.write(root);
+    job->m_task = MixTaskManager::getInstance()->addTask(job->m_json,
+        std::bind(onJobData, job, std::placeholders::_1));
+    if (job->m_task == nullptr)
+    {
+        logErr(MIXLOG << "task init failed: " << job->m_taskId);
+        return false;
+    }
+
+    for (auto iter = root["input_stream_list"].begin();
+            iter != root["input_stream_list"].end();
+            ++iter)
+    {
+        const Json::Value& val = *iter;
+        string streamname = val["stream_name"].asString();
+        string srcFile = val["src"].asString();
+        if (streamname.empty() || srcFile.size() < 3 || srcFile.substr(srcFile.size() - 3) != "flv")
+        {
+            continue;
+        }
+        // 循环并按时间戳实时送数据, 模拟线上拉流
+        job->m_task->addFileInput(streamname, srcFile, true, true);
+    }
+
+    job->m_feeder = std::thread(feedJob, job);
+    return true;
+}
+
+void stopJob(BenchJob* job)
+{
+    job->m_stop = true;
+    if (job->m_feeder.joinable())
+    {
+        job->m_feeder.join();
+    }
+    if (job->m_task != nullptr)
+    {
+        MixTaskManager::getInstance()->stopTask(job->m_taskId);
+        job->m_task->join();
+        delete job->m_task;
+        job->m_task = nullptr;
+    }
+}
+
+long getPeakRssKb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+uint32_t percentile(const vector<uint32_t>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+double sumStages(const std::map<string, double>& stages)
+{
+    double sum = 0;
+    for (const auto& stage : stages)
+    {
+        sum += stage.second;
+    }
+    return sum;
+}
+
+BenchResult measure(vector<BenchJob*>& jobs, int seconds)
+{
+    for (auto job : jobs)
+    {
+        job->m_videoFrames = 0;
+        std::unique_lock<std::mutex> lock(job->m_latencyMutex);
+        job->m_latencies.clear();
+    }
+    MixTaskManager::getInstance()->resetLatencyStats("");
+
+    // 每秒采一次各job线程的CPU, 共享的解码线程记在""下
+    std::map<string, double> jobCpu;
+    double sharedCpu = 0;
+    int samples = 0;
+    uint64_t startMs = getNowMs();
+    for (int i = 0; i < seconds; ++i)
+    {
+        sleep(1);
+        CpuUsage usage = MixTaskManager::getInstance()->getCpuUsage();
+        for (auto job : jobs)
+        {
+            auto iter = usage.find(job->m_taskId);
+            jobCpu[job->m_taskId] += iter == usage.end() ? 0 : sumStages(iter->second);
+        }
+        auto shared = usage.find("");
+        sharedCpu += shared == usage.end() ? 0 : sumStages(shared->second);
+        ++samples;
+    }
+    double elapseSec = (getNowMs() - startMs) / 1000.0;
+
+    BenchResult result;
+    result.m_avgFps = 0;
+    result.m_minFps = 0;
+    result.m_cpuPerJob = 0;
+    result.m_maxCpuJob = 0;
+    result.m_sharedCpu = samples > 0 ? sharedCpu / samples / 100.0 : 0;
+    result.m_peakRssKb = getPeakRssKb();
+    if (jobs.empty())
+    {
+        result.m_p50 = result.m_p90 = result.m_p99 = 0;
+        return result;
+    }
+
+    result.m_minFps = -1;
+    vector<uint32_t> latencies;
+    for (auto job : jobs)
+    {
+        double fps = job->m_videoFrames / elapseSec;
+        result.m_avgFps += fps;
+        if (result.m_minFps < 0 || fps < result.m_minFps)
+        {
+            result.m_minFps = fps;
+        }
+        // 单位: 核, 1.0表示占满一个核
+        double cpu = samples > 0 ? jobCpu[job->m_taskId] / samples / 100.0 : 0;
+        result.m_cpuPerJob += cpu;
+        result.m_maxCpuJob = std::max(result.m_maxCpuJob, cpu);
+        std::unique_lock<std::mutex> lock(job->m_latencyMutex);
+        latencies.insert(latencies.end(), job->m_latencies.begin(), job->m_latencies.end());
+    }
+    result.m_avgFps /= jobs.size();
+    result.m_cpuPerJob /= jobs.size();
+
+    std::sort(latencies.begin(), latencies.end());
+    result.m_p50 = percentile(latencies, 0.50);
+    result.m_p90 = percentile(latencies, 0.90);
+    result.m_p99 = percentile(latencies, 0.99);
+
+    auto stats = MixTaskManager::getInstance()->getLatencyStats();
+    for (auto job : jobs)
+    {
+        for (const auto& input : stats[job->m_taskId])
+        {
+            for (const auto& stage : input.second.m_video)
+            {
+                uint32_t& p99 = result.m_stageP99[stage.first];
+                p99 = std::max(p99, stage.second.m_p99);
+            }
+        }
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        usage("missing argument");
+        return 1;
+    }
+
+    int maxJobs = argc > 2 ? atoi(argv[2]) : 64;
+    int inputsPerJob = argc > 3 ? atoi(argv[3]) : 0;
+    int stepSeconds = argc > 4 ? atoi(argv[4]) : 10;
+    int jobStep = argc > 5 ? atoi(argv[5]) : 1;
+    uint32_t maxP99Ms = argc > 6 ? atoi(argv[6]) : 1000;
+    string decodeQuality = argc > 7 ? argv[7] : "";
+    if (maxJobs <= 0 || stepSeconds <= 0 || jobStep <= 0)
+    {
+        usage("invalid argument");
+        return 1;
+    }
+
+    // 压测时只输出错误日志
+    MixTaskManager::getInstance()->init("../data/font/msyhl.ttc", logCallback, LOG_LEVEL_ERROR);
+
+    Json::Value tmpl;
+    if (!readJson(argv[1], tmpl))
+    {
+        return 1;
+    }
+    if (!decodeQuality.empty())
+    {
+        tmpl["decode_quality"] = decodeQuality;
+    }
+
+    double targetFps = tmpl["out_stream"]["codec"]["video"]["fps"].asDouble();
+    if (targetFps <= 0)
+    {
+        targetFps = 30;
+    }
+    // 最慢的job低于目标帧率95%即认为饱和
+    double minFps = targetFps * 0.95;
+
+    cout << "jobs\tavg_fps\tmin_fps\tp50_ms\tp90_ms\tp99_ms";
+    for (const char* stage : kBenchStages)
+    {
+        cout << "\t" << stage << "_p99";
+    }
+    cout << "\tcpu/job\tmax_cpu/job\tshared_cpu\tpeak_rss_mb" << endl;
+
+    vector<BenchJob*> jobs;
+    int saturatedAt = -1;
+    bool startFailed = false;
+    while (static_cast<int>(jobs.size()) < maxJobs)
+    {
+        for (int i = 0; i < jobStep && static_cast<int>(jobs.size()) < maxJobs; ++i)
+        {
+            BenchJob* job = new BenchJob();
+            if (!startJob(job, makeJobConfig(tmpl, jobs.size(), inputsPerJob)))
+            {
+                stopJob(job);
+                delete job;
+                startFailed = true;
+                break;
+            }
+            jobs.push_back(job);
+        }
+        // 新job起不来(如准入拒绝)即视为饱和
+        if (startFailed)
+        {
+            break;
+        }
+
+        // 预热: 等待编码器初始化和队列稳定
+        sleep(std::max(1, stepSeconds / 2));
+        BenchResult result = measure(jobs, stepSeconds);
+
+        cout << jobs.size()
+             << "\t" << result.m_avgFps
+             << "\t" << result.m_minFps
+             << "\t" << result.m_p50
+             << "\t" << result.m_p90
+             << "\t" << result.m_p99;
+        for (const char* stage : kBenchStages)
+        {
+            cout << "\t" << result.m_stageP99[stage];
+        }
+        cout << "\t" << result.m_cpuPerJob
+             << "\t" << result.m_maxCpuJob
+             << "\t" << result.m_sharedCpu
+             << "\t" << result.m_peakRssKb / 1024
+             << endl;
+
+        if (result.m_minFps < minFps || result.m_p99 > maxP99Ms)
+        {
+            saturatedAt = jobs.size();
+            break;
+        }
+    }
+
+    if (startFailed)
+    {
+        cout << "start failed at " << jobs.size() + 1 << " jobs, max sustainable: "
+             << jobs.size() << endl;
+    }
+    else if (saturatedAt > 0)
+    {
+        cout << "saturated at " << saturatedAt << " jobs, max sustainable: "
+             << saturatedAt - jobStep << endl;
+    }
+    else
+    {
+        cout << "not saturated with " << jobs.size() << " jobs" << endl;
+    }
+
+    for (auto job : jobs)
+    {
+        stopJob(job);
+        delete job;
+    }
+
+    return 0;
+}
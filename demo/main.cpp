@@ -4,16 +4,13 @@
 #include "FlvHelper.h"
 #include "FlvFile.h"
 #include "Job.h"
-#include "InFlvStream.h"
 
 #include "json/json.h"
 
 #include <string>
-#include <thread>
 #include <fstream>
 #include <iostream>
 #include <set>
-#include <vector>
 #include <ctime>
 #include <unistd.h>
 #include <arpa/inet.h>
@@ -23,9 +20,7 @@ using std::cout;
 using std::cerr;
 using std::endl;
 using std::set;
-using std::vector;
 using std::string;
-using std::shared_ptr;
 using std::ifstream;
 
 std::fstream outFs;
@@ -142,9 +137,8 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    // 读取json中指定的输入flv文件
+    // json中指定的输入flv文件由task自己读取
     set<string> streamNames;
-    vector< shared_ptr<InFlvStream> > inputStreams;
     for (auto iter = root["input_stream_list"].begin();
             iter != root["input_stream_list"].end();
             ++iter)
@@ -167,7 +161,7 @@ int main(int argc, char** argv)
         streamNames.insert(streamname);
 
         // demo只支持flv文件
-        if (srcFile.substr(srcFile.size() - 3) != "flv")
+        if (srcFile.size() < 3 || srcFile.substr(srcFile.size() - 3) != "flv")
         {
             logErr(MIXLOG << "input_stream_list streamname:" << streamname
                    << "src: " << srcFile
@@ -175,35 +169,17 @@ int main(int argc, char** argv)
             continue;
         }
 
-        inputStreams.push_back(std::make_shared<InFlvStream>(streamname, srcFile));
+        // loop: 循环播放, realtime: 按时间戳实时送数据
+        task->addFileInput(streamname, srcFile, val["loop"].asBool(), val["realtime"].asBool());
     }
 
-    // 定时发送json，因为任务是10s超时的
-    std::thread t(updateJson, atoi(argv[2]), task, root);
-
-    // 开始解析flv，向task喂数据
-    logInfo(MIXLOG << "feeding data to task");
-    vector<AVData> dataBuffer;
-    do
+    // offline任务读完所有输入并处理完后结束, 其它任务混画timeout秒,
+    // 期间定时发送json，因为任务是10s超时的
+    bool offline = root["offline"].asBool();
+    if (!offline)
     {
-        dataBuffer.clear();
-        for (int i = 0; i < inputStreams.size(); ++i)
-        {
-            static AVData data;
-            if (inputStreams[i]->getAVData(data))
-            {
-                dataBuffer.push_back(data);
-            }
-        }
-
-        for (int i = 0; i < dataBuffer.size(); ++i)
-        {
-            task->addAVData(dataBuffer[i]);
-        }
-
-    } while (!dataBuffer.empty());
-
-    t.join();
+        updateJson(atoi(argv[2]), task, root);
+    }
 
     // 轮询判断任务完成
     while (!task->canStop())
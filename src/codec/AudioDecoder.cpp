@@ -143,8 +143,8 @@ namespace hercules
                     tMediaFrame.asAudio();
                     tMediaFrame.setCodecType(tMediaPacket.getCodecType());
                     tMediaFrame.setStreamId(tMediaPacket.getStreamId());
-                    tMediaFrame.setStreamName(tMediaPacket.getStreamName());
-                    tMediaFrame.setIdTimeTrace(tMediaPacket.getIdTimeTrace());
+                    tMediaFrame.setStreamIndex(tMediaPacket.getStreamIndex());
+                    tMediaFrame.setTimeTrace(tMediaPacket.getTimeTrace());
                     tMediaFrame.setFrameId(tMediaPacket.getFrameId());
 
                     int ret = doDecode(tMediaPacket, tMediaFrame);
@@ -233,8 +233,12 @@ namespace hercules
 
     bool AudioDecoder::popMediaPacket(MediaPacket &tMediaPacket)
     {
-        return getInVideoQueue() ?
-            getInVideoQueue()->pop(tMediaPacket, DEFAULT_QUEUE_TIMEOUT_MS) : false;
+        if (!getInVideoQueue() || !getInVideoQueue()->pop(tMediaPacket, DEFAULT_QUEUE_TIMEOUT_MS))
+        {
+            return false;
+        }
+        tMediaPacket.addIdTimeTrace(tMediaPacket.getStreamIndex(), TimeTraceKey::DELIVER, getNowMs32());
+        return true;
     }
 
     void AudioDecoder::pushMediaFrame(MediaFrame &tMediaFrame)
@@ -285,7 +289,7 @@ namespace hercules
         tMediaFrame.setDts(tMediaPacket.getDts());
         tMediaFrame.setPts(tMediaFrame.getDts());
         tMediaFrame.setFrameId(tMediaPacket.getFrameId());
-        tMediaFrame.addIdTimeTrace(tMediaFrame.getStreamId(), TimeTraceKey::DECODE, getNowMs32());
+        tMediaFrame.addIdTimeTrace(tMediaFrame.getStreamIndex(), TimeTraceKey::DECODE, getNowMs32());
         return 0;
     }
 
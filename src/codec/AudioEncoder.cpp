@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "AudioEncoder.h"
+#include "CodecPool.h"
 #include "Common.h"
 #include "OpenCVOperator.h"
 #include "MediaPacket.h"
@@ -92,7 +93,7 @@ namespace hercules
     {
         if (m_encodeCtx != nullptr)
         {
-            avcodec_free_context(&m_encodeCtx);
+            CodecPool::getInstance()->checkin(m_encodeCtx);
             m_encodeCtx = nullptr;
         }
     }
@@ -137,6 +138,29 @@ namespace hercules
         m_codec.m_kbps = bitrate;
     }
 
+    void AudioEncoder::setFrameDuration(int frameMs)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+
+        m_codec.m_frameMs = getOpusFrameMs(frameMs);
+
+        logInfo(MIXLOG << traceInfo() << ", codec: " << m_codec.print());
+        m_ready = false;
+    }
+
+    bool AudioEncoder::canOpen(int channels, int sampleRate, int kbps, const string &codec, int frameMs)
+    {
+        AudioCodec audioCodec = getAudioCodec(channels, sampleRate, kbps, codec);
+        audioCodec.m_frameMs = getOpusFrameMs(frameMs);
+        AVCodecContext *ctx = openEncoder(audioCodec);
+        if (ctx == nullptr)
+        {
+            return false;
+        }
+        avcodec_free_context(&ctx);
+        return true;
+    }
+
     void AudioEncoder::threadEntry()
     {
         logInfo(MIXLOG << traceInfo() << " thread start");
@@ -213,7 +237,7 @@ namespace hercules
                     << ", input video queue size: " << getInVideoQueue()->size() 
                     << ", ouput video queue size: " << getOutVideoQueue()->size());
 
-                tMediaPacket.asAAC();
+                tMediaPacket.setCodecType(m_codec.m_codecType);
                 tMediaPacket.setAVPacket(avpacket);
                 pushMediaPacket(tMediaPacket);
 
@@ -234,45 +258,126 @@ namespace hercules
         logInfo(MIXLOG << "thread stop: " << traceInfo());
     }
 
-    int AudioEncoder::setupEncoder()
+    AVCodecContext *AudioEncoder::openEncoder(const AudioCodec &codec)
     {
-        reset();
+        if (codec.m_codecType == CodecType::OGG_OPUS)
+        {
+            return openOpusEncoder(codec);
+        }
 
         string encoder_name = "libfdk_aac";
         AVCodec *avcodec = avcodec_find_encoder_by_name(encoder_name.c_str());
 
         if (avcodec == nullptr)
         {
-            logErr(MIXLOG << traceInfo() << ", can't find avcodec: " << encoder_name);
-            return -1;
+            logErr(MIXLOG << "can't find avcodec: " << encoder_name);
+            return nullptr;
         }
 
-        m_encodeCtx = avcodec_alloc_context3(avcodec);
-        return_if(!m_encodeCtx, "allocate encode context fail");
+        AVCodecContext *ctx = avcodec_alloc_context3(avcodec);
+        if (ctx == nullptr)
+        {
+            logErr(MIXLOG << "allocate encode context fail");
+            return nullptr;
+        }
 
-        m_encodeCtx->codec_id = AV_CODEC_ID_AAC;
-        m_encodeCtx->codec_type = AVMEDIA_TYPE_AUDIO;
+        ctx->codec_id = AV_CODEC_ID_AAC;
+        ctx->codec_type = AVMEDIA_TYPE_AUDIO;
 
-        m_encodeCtx->bit_rate = m_codec.m_kbps * 1000;
-        m_encodeCtx->sample_fmt = AV_SAMPLE_FMT_S16;
-        m_encodeCtx->sample_rate = m_codec.m_sampleRate;
-        m_encodeCtx->channel_layout = AV_CH_LAYOUT_STEREO;
-        m_encodeCtx->channels = m_codec.m_channels;
-        m_encodeCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        ctx->bit_rate = codec.m_kbps * 1000;
+        ctx->sample_fmt = AV_SAMPLE_FMT_S16;
+        ctx->sample_rate = codec.m_sampleRate;
+        ctx->channel_layout = AV_CH_LAYOUT_STEREO;
+        ctx->channels = codec.m_channels;
+        ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
-        logInfo(MIXLOG << traceInfo() 
-            << ", channels: " << m_encodeCtx->channels 
-            << ", sampleRate: " << m_encodeCtx->sample_rate 
-            << ", kbps: " << m_encodeCtx->bit_rate);
+        logInfo(MIXLOG << "channels: " << ctx->channels 
+            << ", sampleRate: " << ctx->sample_rate 
+            << ", kbps: " << ctx->bit_rate);
 
-        int ret = avcodec_open2(m_encodeCtx, m_encodeCtx->codec, nullptr);
+        int ret = avcodec_open2(ctx, ctx->codec, nullptr);
         if (ret < 0)
         {
-            reset();
-            logErr(MIXLOG << traceInfo() << ", open encode codec fail, ret:" << ret);
+            avcodec_free_context(&ctx);
+            logErr(MIXLOG << "open encode codec fail, ret:" << ret);
+            return nullptr;
+        }
+
+        return ctx;
+    }
+
+    AVCodecContext *AudioEncoder::openOpusEncoder(const AudioCodec &codec)
+    {
+        string encoder_name = "libopus";
+        AVCodec *avcodec = avcodec_find_encoder_by_name(encoder_name.c_str());
+
+        if (avcodec == nullptr)
+        {
+            logErr(MIXLOG << "can't find avcodec: " << encoder_name);
+            return nullptr;
+        }
+
+        AVCodecContext *ctx = avcodec_alloc_context3(avcodec);
+        if (ctx == nullptr)
+        {
+            logErr(MIXLOG << "allocate encode context fail");
+            return nullptr;
+        }
+
+        ctx->codec_id = AV_CODEC_ID_OPUS;
+        ctx->codec_type = AVMEDIA_TYPE_AUDIO;
+
+        ctx->bit_rate = codec.m_kbps * 1000;
+        ctx->sample_fmt = AV_SAMPLE_FMT_S16;
+        ctx->sample_rate = OPUS_SAMPLE_RATE;
+        ctx->channels = codec.m_channels;
+        ctx->channel_layout = av_get_default_channel_layout(codec.m_channels);
+        // frames are stamped in ms, the pre-skip is then subtracted in ms as well
+        ctx->time_base = AVRational{1, 1000};
+        ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+        // lowdelay drops the speech/music analysis and most of the lookahead
+        AVDictionary *opts = nullptr;
+        av_dict_set(&opts, "application", "lowdelay", 0);
+        av_dict_set(&opts, "frame_duration", std::to_string(codec.m_frameMs).c_str(), 0);
+
+        logInfo(MIXLOG << "opus channels: " << ctx->channels
+            << ", sampleRate: " << ctx->sample_rate
+            << ", kbps: " << ctx->bit_rate
+            << ", frame ms: " << codec.m_frameMs);
+
+        int ret = avcodec_open2(ctx, ctx->codec, &opts);
+        av_dict_free(&opts);
+        if (ret < 0)
+        {
+            avcodec_free_context(&ctx);
+            logErr(MIXLOG << "open opus encode codec fail, ret:" << ret);
+            return nullptr;
+        }
+
+        if (ctx->frame_size != codec.frameSamples())
+        {
+            logWarn(MIXLOG << "opus frame size: " << ctx->frame_size
+                << ", mixer frame size: " << codec.frameSamples());
+        }
+
+        return ctx;
+    }
+
+    int AudioEncoder::setupEncoder()
+    {
+        reset();
+
+        AudioCodec codec = m_codec;
+        m_encodeCtx = CodecPool::getInstance()->checkout(CodecPoolKey::audio(codec),
+            [codec]() { return AudioEncoder::openEncoder(codec); });
+        if (m_encodeCtx == nullptr)
+        {
+            logErr(MIXLOG << traceInfo() << ", open encode codec fail");
             return -1;
         }
 
+        int ret = 0;
         AVIOContext *pb;
         uint8_t *P = nullptr;
         ret = avio_open_dyn_buf(&pb);
@@ -289,12 +394,12 @@ namespace hercules
         if (m_audioHeader.m_len == 0)
         {
             logErr(MIXLOG << traceInfo() 
-                << ", setup audio encoder get aac config fail");
+                << ", setup audio encoder get codec config fail");
             return -1;
         }
 
         string sNewHex = dump(m_audioHeader.m_config, m_audioHeader.m_len);
-        logInfo(MIXLOG << traceInfo() << ", dump new aac header: "
+        logInfo(MIXLOG << traceInfo() << ", dump new audio header: "
             << sNewHex << ", header len: " << m_audioHeader.m_len);
 
         MediaPacket tMediaPacket;
@@ -302,7 +407,7 @@ namespace hercules
         tMediaPacket.setDts(0);
         tMediaPacket.setPts(0);
         tMediaPacket.asAudio();
-        tMediaPacket.asAAC();
+        tMediaPacket.setCodecType(m_codec.m_codecType);
 
         AVPacket *avPacket = av_packet_alloc();
         size_t avpacket_buf_size = m_audioHeader.m_len;
@@ -345,7 +450,7 @@ namespace hercules
 
     void AudioEncoder::insertFrameMetadata(int64_t key, const MediaFrame &tMediaFrame)
     {
-        FrameMetadata frameMetadata(tMediaFrame.getIdTimestamp(), tMediaFrame.getIdTimeTrace());
+        FrameMetadata frameMetadata(tMediaFrame.getTimeTrace());
         m_frameMetadata.insert(make_pair(key, frameMetadata));
 
         if (m_frameMetadata.size() >= MAX_FRAME_METADATA_SIZE)
@@ -363,8 +468,7 @@ namespace hercules
             return false;
         }
 
-        tMediaPacket.setIdTimeTrace(iter->second.m_idTimeTrace);
-        tMediaPacket.setIdTimestamp(iter->second.m_idTimestamp);
+        tMediaPacket.setTimeTrace(iter->second.m_timeTrace);
 
         m_frameMetadata.erase(m_frameMetadata.begin(), iter);
 
@@ -65,21 +65,22 @@ namespace hercules
         void setCodec(int channels, int sampleRate,
             int kbps, const std::string &codec);
         void setBitrate(int bitrate);
+        // opus frame length, rounded to 10/20/40/60 ms
+        void setFrameDuration(int frameMs);
         void setLowLatency(bool lowLatency) { m_lowLatency = lowLatency; }
+        // opens and frees an encoder for codec, false when this build can't encode it
+        static bool canOpen(int channels, int sampleRate, int kbps, const std::string &codec, int frameMs);
 
         virtual std::string traceInfo() { return ""; }
 
     private:
         struct FrameMetadata
         {
-            FrameMetadata(const std::map<uint64_t, uint32_t> &idTimestamp,
-                const std::map<uint64_t, std::map<TimeTraceKey, uint32_t>> &idTimeTrace)
-                : m_idTimestamp(idTimestamp), m_idTimeTrace(idTimeTrace)
+            explicit FrameMetadata(const TimeTrace &timeTrace) : m_timeTrace(timeTrace)
             {
             }
 
-            std::map<uint64_t, uint32_t> m_idTimestamp;
-            std::map<uint64_t, std::map<TimeTraceKey, uint32_t>> m_idTimeTrace;
+            TimeTrace m_timeTrace;
         };
 
         std::map<int64_t, FrameMetadata> m_frameMetadata;
@@ -97,6 +98,9 @@ namespace hercules
         int doEncode(AVFrame *tFrame, AVPacket *tPacket);
         int setupEncoder();
 
+        static AVCodecContext *openEncoder(const AudioCodec &codec);
+        static AVCodecContext *openOpusEncoder(const AudioCodec &codec);
+
         void reset();
 
     protected:
@@ -26,13 +26,22 @@ namespace hercules
 
 AudioResampler::AudioResampler():
     m_context(nullptr),
+    m_oSampleFmt(AV_SAMPLE_FMT_S16),
+    m_oSampleRate(DEFAULT_SAMPLE_RATE),
+    m_oChannelNum(DEFAULT_CHANNEL_NUM),
     m_audioFifo(nullptr),
     m_inputSamples(0),
-    m_nbSamples(1024),  // aac
+    m_nbSamples(DEFAULT_AUDIO_FRAME_SAMPLES),
     m_shouldResample(false),
     m_inited(false),
     m_useResampleCount(0),
-    m_resampleCount(0)
+    m_resampleCount(0),
+    m_streamIndex(kInvalidStreamIndex),
+    m_codecType(CodecType::UNKNOWN),
+    m_formatChanged(false),
+    m_pendingSampleRate(DEFAULT_SAMPLE_RATE),
+    m_pendingChannels(DEFAULT_CHANNEL_NUM),
+    m_pendingSamples(DEFAULT_AUDIO_FRAME_SAMPLES)
 {
 }
 
@@ -40,15 +49,14 @@ bool AudioResampler::init(
     AVSampleFormat iSampleFmt, int32_t iSampleRate, int32_t iChannelNum,
     AVSampleFormat oSampleFmt, int32_t oSampleRate, int32_t oChannelNum)
 {
-    if(iSampleFmt == oSampleFmt &&
+    // an identity swr context still feeds the fifo that cuts the output frames
+    m_shouldResample = !(iSampleFmt == oSampleFmt &&
         iSampleRate == oSampleRate &&
-        iChannelNum == oChannelNum)
+        iChannelNum == oChannelNum);
+    if(!m_shouldResample)
     {
-        logInfo(MIXLOG << traceInfo() << "sample sample_fmt sample_rate channels, no need resample");
-        m_shouldResample == false;
-        return true;
+        logInfo(MIXLOG << traceInfo() << "same sample_fmt sample_rate channels, no need resample");
     }
-    m_shouldResample = true;
 
     m_context = swr_alloc();
     if(m_context == nullptr)
@@ -88,6 +96,47 @@ bool AudioResampler::init(
     return true;
 }
 
+void AudioResampler::setOutputFormat(int32_t sampleRate, int32_t channels, uint32_t nbSamples)
+{
+    std::unique_lock<std::mutex> lock(m_formatMutex);
+    m_pendingSampleRate = sampleRate;
+    m_pendingChannels = channels;
+    m_pendingSamples = nbSamples;
+    m_formatChanged = true;
+}
+
+// runs on the resampler thread, samples still in the fifo are dropped
+void AudioResampler::applyOutputFormat()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_formatMutex);
+        if (!m_formatChanged)
+        {
+            return;
+        }
+        m_formatChanged = false;
+        m_oSampleRate = m_pendingSampleRate;
+        m_oChannelNum = m_pendingChannels;
+        m_nbSamples = m_pendingSamples;
+    }
+
+    if (m_inited)
+    {
+        logInfo(MIXLOG << traceInfo() << "restart resampler, sample rate: " << m_oSampleRate
+            << ", channels: " << m_oChannelNum << ", frame samples: " << m_nbSamples);
+    }
+    destory();
+    if (m_audioFifo != nullptr)
+    {
+        av_audio_fifo_free(m_audioFifo);
+        m_audioFifo = nullptr;
+    }
+    m_samples2Dts.clear();
+    m_resampleCount = 0;
+    m_useResampleCount = 0;
+    m_inited = false;
+}
+
 void AudioResampler::destory()
 {
     if(m_context != nullptr)
@@ -112,6 +161,7 @@ void AudioResampler::threadEntry()
     {
         while (!isStop())
         {
+            applyOutputFormat();
             MediaFrame tMediaFrame;
             if (popMediaFrame(tMediaFrame) && tMediaFrame.getAVFrame() != nullptr)
             {
@@ -120,7 +170,8 @@ void AudioResampler::threadEntry()
                 {
                     logInfo(MIXLOG << traceInfo() << " init resampler");
                     AVFrame* avframe = tMediaFrame.getAVFrame();
-                    init((AVSampleFormat)avframe->format, avframe->sample_rate, avframe->channels);
+                    init((AVSampleFormat)avframe->format, avframe->sample_rate, avframe->channels,
+                        m_oSampleFmt, m_oSampleRate, m_oChannelNum);
                     m_inited = true;
                 }
 
@@ -133,6 +184,12 @@ void AudioResampler::threadEntry()
                     {
                         logErr(MIXLOG << traceInfo() << "resample fail!");
                     }
+                    else
+                    {
+                        m_timeTrace = tMediaFrame.getTimeTrace();
+                        m_streamIndex = tMediaFrame.getStreamIndex();
+                        m_codecType = tMediaFrame.getCodecType();
+                    }
                 }
             }
 
@@ -164,17 +221,19 @@ int AudioResampler::doResample(AVFrame* srcFrame)
 {
     int32_t outputSamples = static_cast<int>(
         av_rescale_rnd(srcFrame->nb_samples, m_oSampleRate, m_iSampleRate, AV_ROUND_UP));
-    int outBufSize = outputSamples * av_get_bytes_per_sample(
-            static_cast<AVSampleFormat>(srcFrame->format)) * srcFrame->channels;
+    // sized for the packed output, a mono input upmixed to stereo needs more than the input
+    int outBufSize = outputSamples * av_get_bytes_per_sample(m_oSampleFmt) * m_oChannelNum;
     uint8_t* outBuf = reinterpret_cast<uint8_t*>(malloc(outBufSize));
     int resampleSize = resample(reinterpret_cast<void**>(srcFrame->data),
             srcFrame->nb_samples, reinterpret_cast<void **>(&outBuf));
     if(resampleSize <  0)
     {
+        free(outBuf);
         return -1;
     }
     logDebug(MIXLOG << traceInfo() << "resampleSize:" << resampleSize);
     av_audio_fifo_write(m_audioFifo, reinterpret_cast<void**>(&outBuf), resampleSize);
+    free(outBuf);
     // TODO limit
     m_samples2Dts[m_resampleCount] = srcFrame->pkt_dts;
     m_resampleCount += resampleSize;
@@ -249,8 +308,10 @@ bool AudioResampler::getResampleFrame(MediaFrame& mediaFrame)
 
     mediaFrame.setDts(dts);
     mediaFrame.setPts(pts);
-    mediaFrame.asAAC();
+    mediaFrame.setCodecType(m_codecType);
     mediaFrame.setAVFrame(dstFrame);
+    mediaFrame.setStreamIndex(m_streamIndex);
+    mediaFrame.setTimeTrace(m_timeTrace);
     return true;
 }
 
@@ -267,6 +328,7 @@ void AudioResampler::pushMediaFrame(MediaFrame &frame)
 
 void AudioResampler::addSubscriber(const std::string &subscriberName, SubscribeContext *context)
 {
+    std::unique_lock<std::mutex> lock(m_subscriberMutex);
     auto itr = m_subscriberMap.find(subscriberName);
     if (itr == m_subscriberMap.end())
     {
@@ -282,6 +344,7 @@ void AudioResampler::addSubscriber(const std::string &subscriberName, SubscribeC
 
 void AudioResampler::delSubscriber(const std::string &subscriberName)
 {
+    std::unique_lock<std::mutex> lock(m_subscriberMutex);
     auto itr = m_subscriberMap.find(subscriberName);
     if (m_subscriberMap.end() != itr)
     {
@@ -296,6 +359,7 @@ void AudioResampler::delSubscriber(const std::string &subscriberName)
 
 void AudioResampler::dispatch(MediaFrame &frame)
 {
+    std::unique_lock<std::mutex> lock(m_subscriberMutex);
     for (const auto &subscriber : m_subscriberMap)
     {
         logDebug(MIXLOG << traceInfo());
@@ -18,6 +18,7 @@
 #include "MediaFrame.h"
 #include "OneCycleThread.h"
 #include "SubscribeContext.h"
+#include "Common.h"
 
 #include <memory>
 
@@ -33,6 +34,7 @@ extern "C"
 }
 
 #include <map>
+#include <mutex>
 #include <string>
 
 namespace hercules
@@ -46,8 +48,12 @@ public:
     ~AudioResampler() {destory();}
 
     bool init(AVSampleFormat iSampleFmt, int32_t iSampleRate, int32_t iChannelNum,
-        AVSampleFormat oSampleFmt = AV_SAMPLE_FMT_S16, int32_t oSampleRate = 44100,
-        int32_t oChannelNum = 2);
+        AVSampleFormat oSampleFmt = AV_SAMPLE_FMT_S16, int32_t oSampleRate = DEFAULT_SAMPLE_RATE,
+        int32_t oChannelNum = DEFAULT_CHANNEL_NUM);
+
+    // output of the resampler thread, frames carry nbSamples each; a change while
+    // running restarts the resampler with the next input frame
+    void setOutputFormat(int32_t sampleRate, int32_t channels, uint32_t nbSamples);
 
     void destory();
 
@@ -72,6 +78,8 @@ public:
 protected:
     void threadEntry();
     void dispatch(MediaFrame &frame);
+private:
+    void applyOutputFormat();
 private:
     SwrContext* m_context;
     AVSampleFormat m_iSampleFmt;
@@ -93,6 +101,17 @@ private:
     bool m_shouldResample;
     // nb_samples => dts
     std::map<uint64_t, uint64_t> m_samples2Dts;
+    // trace of the newest input, output frames mostly hold its samples
+    TimeTrace m_timeTrace;
+    StreamIndex m_streamIndex;
+    // codec the newest input was decoded from
+    CodecType m_codecType;
+    std::mutex m_formatMutex;
+    bool m_formatChanged;
+    int32_t m_pendingSampleRate;
+    int32_t m_pendingChannels;
+    uint32_t m_pendingSamples;
+    std::mutex m_subscriberMutex;
     std::map<std::string, SubscribeContext *> m_subscriberMap;
 };
 
@@ -0,0 +1,365 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CodecPool.h"
+#include "Log.h"
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+}
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+namespace hercules
+{
+
+    CodecPoolKey CodecPoolKey::video(const VideoCodec &codec, bool lowLatency)
+    {
+        CodecPoolKey key;
+        key.m_mediaType = MediaType::VIDEO;
+        key.m_codecType = codec.m_codecType;
+        key.m_width = codec.m_width;
+        key.m_height = codec.m_height;
+        key.m_fps = codec.m_fps;
+        key.m_kbpsClass = (codec.m_kbps + kCodecPoolBitrateClassKbps / 2) / kCodecPoolBitrateClassKbps;
+        key.m_lowLatency = lowLatency;
+        return key;
+    }
+
+    CodecPoolKey CodecPoolKey::audio(const AudioCodec &codec)
+    {
+        // aac can not change bitrate after open, so keep it exact
+        CodecPoolKey key;
+        key.m_mediaType = MediaType::AUDIO;
+        key.m_codecType = codec.m_codecType;
+        key.m_channels = codec.m_channels;
+        key.m_sampleRate = codec.m_sampleRate;
+        key.m_kbpsClass = codec.m_kbps;
+        if (codec.m_codecType == CodecType::OGG_OPUS)
+        {
+            key.m_frameMs = codec.m_frameMs;
+        }
+        return key;
+    }
+
+    bool CodecPoolKey::operator<(const CodecPoolKey &rhs) const
+    {
+        return std::tie(m_mediaType, m_codecType, m_width, m_height, m_fps,
+                        m_channels, m_sampleRate, m_kbpsClass, m_lowLatency, m_frameMs)
+            < std::tie(rhs.m_mediaType, rhs.m_codecType, rhs.m_width, rhs.m_height, rhs.m_fps,
+                       rhs.m_channels, rhs.m_sampleRate, rhs.m_kbpsClass, rhs.m_lowLatency,
+                       rhs.m_frameMs);
+    }
+
+    std::string CodecPoolKey::print() const
+    {
+        std::ostringstream os;
+        os << MediaType2Str(m_mediaType) << "|" << CodecType2Str(m_codecType);
+        if (m_mediaType == MediaType::VIDEO)
+        {
+            os << "|" << m_width << "x" << m_height << "@" << m_fps
+               << "|kbps class: " << m_kbpsClass << "|lowLatency: " << m_lowLatency;
+        }
+        else
+        {
+            os << "|channels: " << m_channels << "|sampleRate: " << m_sampleRate
+               << "|kbps: " << m_kbpsClass;
+            if (m_frameMs != 0)
+            {
+                os << "|frameMs: " << m_frameMs;
+            }
+        }
+        return os.str();
+    }
+
+    CodecPool::CodecPool() : m_hit(0), m_miss(0)
+    {
+        // serves every job, stays unpinned
+        ThreadGroupGuard guard("");
+        startThread("CodecPool");
+    }
+
+    CodecPool::~CodecPool()
+    {
+        stopThread();
+        m_cond.notify_all();
+        joinThread();
+
+        for (auto &kv : m_slots)
+        {
+            for (auto ctx : kv.second.m_ready)
+            {
+                avcodec_free_context(&ctx);
+            }
+        }
+        m_slots.clear();
+
+        for (auto ctx : m_closing)
+        {
+            avcodec_free_context(&ctx);
+        }
+        m_closing.clear();
+    }
+
+    AVCodecContext *CodecPool::checkout(const CodecPoolKey &key, const Opener &opener)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+
+        Slot &slot = m_slots[key];
+        if (!slot.m_opener)
+        {
+            slot.m_opener = opener;
+        }
+        slot.m_lastUseMs = getNowMs();
+
+        AVCodecContext *ctx = nullptr;
+        bool hit = !slot.m_ready.empty();
+        if (hit)
+        {
+            ctx = slot.m_ready.front();
+            slot.m_ready.pop_front();
+            ++slot.m_hit;
+            ++m_hit;
+            m_cond.notify_one();
+        }
+        else
+        {
+            ++slot.m_miss;
+            ++m_miss;
+            // the pool would open the same context next to this one, hold it off
+            slot.m_holdFill = true;
+
+            lockGuard.unlock();
+            ctx = opener();
+            lockGuard.lock();
+        }
+
+        // the slot may have been dropped while the opener ran
+        Slot &out = m_slots[key];
+        if (ctx != nullptr)
+        {
+            ++out.m_out;
+            m_checkedOut[ctx] = key;
+        }
+        else
+        {
+            out.m_holdFill = false;
+        }
+
+        logInfo(MIXLOG << "checkout codec: " << key.print() << ", hit: " << hit
+            << ", ready: " << out.m_ready.size() << ", out: " << out.m_out);
+        return ctx;
+    }
+
+    void CodecPool::checkin(AVCodecContext *ctx)
+    {
+        if (ctx == nullptr)
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        auto iter = m_checkedOut.find(ctx);
+        if (iter != m_checkedOut.end())
+        {
+            auto found = m_slots.find(iter->second);
+            if (found != m_slots.end())
+            {
+                Slot &slot = found->second;
+                if (slot.m_out > 0)
+                {
+                    --slot.m_out;
+                }
+                slot.m_holdFill = false;
+                slot.m_lastUseMs = getNowMs();
+            }
+            m_checkedOut.erase(iter);
+        }
+        m_closing.push_back(ctx);
+        m_cond.notify_one();
+    }
+
+    void CodecPool::setTargetSize(const CodecPoolKey &key, const Opener &opener, size_t size)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+
+        Slot &slot = m_slots[key];
+        slot.m_opener = opener;
+        slot.m_target = size;
+        slot.m_sized = true;
+        slot.m_holdFill = false;
+        slot.m_lastUseMs = getNowMs();
+        while (slot.m_ready.size() > size)
+        {
+            m_closing.push_back(slot.m_ready.back());
+            slot.m_ready.pop_back();
+        }
+        m_cond.notify_one();
+    }
+
+    bool CodecPool::findShortSlot(CodecPoolKey &key, Opener &opener)
+    {
+        if (readyCount() >= kCodecPoolMaxReady)
+        {
+            return false;
+        }
+
+        // most recently used key first, it is the likeliest to be asked for again
+        const std::pair<const CodecPoolKey, Slot> *best = nullptr;
+        for (const auto &kv : m_slots)
+        {
+            const Slot &slot = kv.second;
+            if (slot.m_opener && !slot.m_holdFill && slot.m_ready.size() < slot.m_target
+                && (best == nullptr || slot.m_lastUseMs > best->second.m_lastUseMs))
+            {
+                best = &kv;
+            }
+        }
+        if (best == nullptr)
+        {
+            return false;
+        }
+        key = best->first;
+        opener = best->second.m_opener;
+        return true;
+    }
+
+    size_t CodecPool::readyCount() const
+    {
+        size_t count = 0;
+        for (const auto &kv : m_slots)
+        {
+            count += kv.second.m_ready.size();
+        }
+        return count;
+    }
+
+    void CodecPool::evictIdle()
+    {
+        uint64_t now = getNowMs();
+        for (auto iter = m_slots.begin(); iter != m_slots.end();)
+        {
+            const Slot &slot = iter->second;
+            if (slot.m_sized || slot.m_out > 0 || slot.m_lastUseMs + kCodecPoolIdleMs > now)
+            {
+                ++iter;
+                continue;
+            }
+            logInfo(MIXLOG << "codec pool drop idle key: " << iter->first.print()
+                << ", ready: " << slot.m_ready.size());
+            m_closing.insert(m_closing.end(), slot.m_ready.begin(), slot.m_ready.end());
+            iter = m_slots.erase(iter);
+        }
+
+        // over the cap, e.g. after setTargetSize, the least recently used keys give up theirs
+        size_t ready = readyCount();
+        while (ready > kCodecPoolMaxReady)
+        {
+            Slot *oldest = nullptr;
+            for (auto &kv : m_slots)
+            {
+                if (!kv.second.m_ready.empty() && (oldest == nullptr || kv.second.m_lastUseMs < oldest->m_lastUseMs))
+                {
+                    oldest = &kv.second;
+                }
+            }
+            m_closing.push_back(oldest->m_ready.back());
+            oldest->m_ready.pop_back();
+            --ready;
+        }
+    }
+
+    void CodecPool::threadEntry()
+    {
+        while (!isStop())
+        {
+            checkTimer();
+
+            AVCodecContext *closing = nullptr;
+            CodecPoolKey key;
+            Opener opener;
+            {
+                std::unique_lock<std::mutex> lockGuard(m_mutex);
+                if (!m_closing.empty())
+                {
+                    closing = m_closing.front();
+                    m_closing.pop_front();
+                }
+                else if (!findShortSlot(key, opener))
+                {
+                    m_cond.wait_for(lockGuard, std::chrono::milliseconds(100));
+                    continue;
+                }
+            }
+
+            if (closing != nullptr)
+            {
+                avcodec_free_context(&closing);
+                continue;
+            }
+
+            uint64_t begin = getNowMs();
+            AVCodecContext *ctx = opener();
+            if (ctx == nullptr)
+            {
+                logErr(MIXLOG << "open codec fail: " << key.print() << ", stop filling it");
+                std::unique_lock<std::mutex> lockGuard(m_mutex);
+                auto iter = m_slots.find(key);
+                if (iter != m_slots.end())
+                {
+                    iter->second.m_target = 0;
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            auto iter = m_slots.find(key);
+            if (iter == m_slots.end())
+            {
+                // dropped as idle while opening
+                m_closing.push_back(ctx);
+                continue;
+            }
+            iter->second.m_ready.push_back(ctx);
+            logInfo(MIXLOG << "codec ready: " << key.print() << ", cost: " << getNowMs() - begin
+                << ", ready: " << iter->second.m_ready.size());
+        }
+    }
+
+    void CodecPool::oneSecondTimeout(uint64_t counter)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        evictIdle();
+        if (counter % 10 != 0)
+        {
+            return;
+        }
+
+        logInfo(MIXLOG << "codec pool hit: " << m_hit << ", miss: " << m_miss
+            << ", keys: " << m_slots.size() << ", closing: " << m_closing.size());
+        for (const auto &kv : m_slots)
+        {
+            logInfo(MIXLOG << "codec pool key: " << kv.first.print()
+                << ", target: " << kv.second.m_target << ", ready: " << kv.second.m_ready.size()
+                << ", out: " << kv.second.m_out
+                << ", hit: " << kv.second.m_hit << ", miss: " << kv.second.m_miss);
+        }
+    }
+
+} // namespace hercules
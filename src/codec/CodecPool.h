@@ -0,0 +1,144 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "CodecUtil.h"
+#include "OneCycleThread.h"
+#include "Singleton.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+struct AVCodecContext;
+
+namespace hercules
+{
+
+    // bitrate is rounded to this to share contexts, the exact value is set on checkout
+    constexpr int kCodecPoolBitrateClassKbps = 500;
+    // ready contexts kept per key once it has been asked for
+    constexpr size_t kCodecPoolDefaultSize = 1;
+    // ready contexts kept over all keys, least recently used keys give theirs up first
+    constexpr size_t kCodecPoolMaxReady = 8;
+    // a key nobody has used for this long is dropped with its ready contexts
+    constexpr uint64_t kCodecPoolIdleMs = 60 * 1000;
+
+    struct CodecPoolKey
+    {
+        MediaType m_mediaType;
+        CodecType m_codecType;
+        int m_width;
+        int m_height;
+        int m_fps;
+        int m_channels;
+        int m_sampleRate;
+        int m_kbpsClass;
+        bool m_lowLatency;
+        int m_frameMs;
+
+        CodecPoolKey() : m_mediaType(MediaType::UNKNOWN),
+                         m_codecType(CodecType::UNKNOWN),
+                         m_width(0),
+                         m_height(0),
+                         m_fps(0),
+                         m_channels(0),
+                         m_sampleRate(0),
+                         m_kbpsClass(0),
+                         m_lowLatency(false),
+                         m_frameMs(0)
+        {
+        }
+
+        static CodecPoolKey video(const VideoCodec &codec, bool lowLatency);
+        static CodecPoolKey audio(const AudioCodec &codec);
+
+        bool operator<(const CodecPoolKey &rhs) const;
+        std::string print() const;
+    };
+
+    // pre-opened encoder contexts, a job checks one out when its encoder starts
+    // and checks it in on reset, used contexts carry stream state so they are
+    // closed in the background and replaced by fresh ones; keys that go idle
+    // are dropped unless sized with setTargetSize
+    class CodecPool : public OneCycleThread, public Singleton<CodecPool>
+    {
+        friend class Singleton<CodecPool>;
+
+    public:
+        typedef std::function<AVCodecContext *()> Opener;
+
+    private:
+        CodecPool();
+        ~CodecPool();
+
+    public:
+        // ready context for key, on a miss opener runs on the caller's thread and
+        // the key is only refilled once that context is checked in, nullptr if it fails
+        AVCodecContext *checkout(const CodecPoolKey &key, const Opener &opener);
+
+        // ctx is freed on the pool thread
+        void checkin(AVCodecContext *ctx);
+
+        // the key is kept warm with size contexts and never dropped as idle
+        void setTargetSize(const CodecPoolKey &key, const Opener &opener, size_t size);
+
+        uint64_t getHitCount() const { return m_hit; }
+        uint64_t getMissCount() const { return m_miss; }
+
+        virtual void threadEntry();
+        virtual void oneSecondTimeout(uint64_t counter);
+
+    private:
+        struct Slot
+        {
+            Slot() : m_target(kCodecPoolDefaultSize), m_sized(false), m_holdFill(false),
+                     m_out(0), m_lastUseMs(0), m_hit(0), m_miss(0) {}
+
+            size_t m_target;
+            // set by setTargetSize, not dropped when idle
+            bool m_sized;
+            // a miss opened in place, wait for its checkin before refilling
+            bool m_holdFill;
+            // contexts of this key checked out and not back yet
+            size_t m_out;
+            uint64_t m_lastUseMs;
+            Opener m_opener;
+            std::deque<AVCodecContext *> m_ready;
+            uint64_t m_hit;
+            uint64_t m_miss;
+        };
+
+        bool findShortSlot(CodecPoolKey &key, Opener &opener);
+        size_t readyCount() const;
+        void evictIdle();
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::map<CodecPoolKey, Slot> m_slots;
+        // checked out contexts and the key they count against
+        std::map<AVCodecContext *, CodecPoolKey> m_checkedOut;
+        std::deque<AVCodecContext *> m_closing;
+
+        std::atomic<uint64_t> m_hit;
+        std::atomic<uint64_t> m_miss;
+    };
+
+} // namespace hercules
@@ -15,6 +15,7 @@
 #pragma once
 
 #include "MediaPacket.h"
+#include "Common.h"
 
 #include <stdint.h>
 #include <string.h>
@@ -92,24 +93,51 @@ namespace hercules
         int m_sampleRate;
         int m_kbps;
         CodecType m_codecType;
+        // opus only, aac frames are always 1024 samples
+        int m_frameMs;
 
         AudioCodec(int channels, int sampleRate, int kbps,
             CodecType codecType = CodecType::AAC)
             : m_channels(channels), m_sampleRate(sampleRate), m_kbps(kbps), m_codecType(codecType)
+            , m_frameMs(OPUS_DEFAULT_FRAME_MS)
         {
         }
 
+        int frameSamples() const
+        {
+            if (m_codecType == CodecType::OGG_OPUS)
+            {
+                return m_sampleRate * m_frameMs / 1000;
+            }
+            return DEFAULT_AUDIO_FRAME_SAMPLES;
+        }
+
         std::string print()
         {
             std::ostringstream os;
 
             os << "channels: " << m_channels << ", sample rate: " << m_sampleRate 
                 << ", kbps: " << m_kbps << ", codec type: " << CodecType2Str(m_codecType);
+            if (m_codecType == CodecType::OGG_OPUS)
+            {
+                os << ", frame ms: " << m_frameMs;
+            }
 
             return os.str();
         }
     };
 
+    struct DecodeStats
+    {
+        DecodeStats() : m_suspended(false), m_skipped(0)
+        {
+        }
+        // only key frames are decoded while no layer of the stream is drawn
+        bool m_suspended;
+        // packets not decoded since the decoder started
+        uint64_t m_skipped;
+    };
+
     static VideoCodec getVideoCodec(int width, int height, int fps, int kbps, const std::string &codec = "")
     {
         CodecType codecType = CodecType::H264;
@@ -127,12 +155,98 @@ namespace hercules
 
         if (codec == "opus" || codec == "OPUS")
         {
+            // the encoder resamples nothing itself, run the whole mix at the opus rate
             codecType = CodecType::OGG_OPUS;
+            sampleRate = OPUS_SAMPLE_RATE;
         }
 
         return AudioCodec(channels, sampleRate, kbps, codecType);
     }
 
+    // opus encodes 2.5 to 60 ms per frame, the mixer ticks in whole ms so 10 is the floor
+    static int getOpusFrameMs(int frameMs)
+    {
+        if (frameMs <= 10)
+        {
+            return 10;
+        }
+        if (frameMs <= 20)
+        {
+            return 20;
+        }
+        return frameMs <= 40 ? 40 : 60;
+    }
+
+    // size of the nal length prefix from avcC / hvcC
+    static int getNalLengthSize(const CodecHeader &header)
+    {
+        if (header.m_codecType == CodecType::H265)
+        {
+            return header.m_len > 21 ? (header.m_config[21] & 0x03) + 1 : 4;
+        }
+        return header.m_len > 4 ? (header.m_config[4] & 0x03) + 1 : 4;
+    }
+
+    // hevc sub-layer non-reference pictures may still be referenced from higher
+    // temporal layers, so they are only safe to drop in single layer streams
+    static bool canDropNonRef(const CodecHeader &header)
+    {
+        if (header.m_codecType == CodecType::H265)
+        {
+            return header.m_len > 21 && ((header.m_config[21] >> 3) & 0x07) == 1;
+        }
+        return header.m_codecType == CodecType::H264;
+    }
+
+    // true when no slice of the length prefixed access unit is used for reference
+    static bool isNonRefPicture(const uint8_t *data, size_t size, CodecType codecType, int nalLengthSize)
+    {
+        bool hasSlice = false;
+        size_t offset = 0;
+        while (offset + nalLengthSize < size)
+        {
+            size_t nalSize = 0;
+            for (int i = 0; i < nalLengthSize; ++i)
+            {
+                nalSize = (nalSize << 8) | data[offset + i];
+            }
+            offset += nalLengthSize;
+            if (nalSize == 0 || offset + nalSize > size)
+            {
+                return false;
+            }
+
+            uint8_t nal = data[offset];
+            if (codecType == CodecType::H265)
+            {
+                int nalType = (nal >> 1) & 0x3f;
+                if (nalType <= 31)
+                {
+                    // TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N and reserved _N are even
+                    if (nalType > 14 || nalType % 2 != 0)
+                    {
+                        return false;
+                    }
+                    hasSlice = true;
+                }
+            }
+            else
+            {
+                int nalType = nal & 0x1f;
+                if (nalType >= 1 && nalType <= 5)
+                {
+                    if ((nal >> 5) & 0x03)
+                    {
+                        return false;
+                    }
+                    hasSlice = true;
+                }
+            }
+            offset += nalSize;
+        }
+        return hasSlice;
+    }
+
     static CodecHeader getHeader(const MediaPacket &tMediaPacket)
     {
         CodecHeader avcHeader;
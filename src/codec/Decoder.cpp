@@ -26,6 +26,7 @@ extern "C"
 #include "x264/x264.h"
 }
 
+#include <algorithm>
 #include <utility>
 #include <string>
 
@@ -53,6 +54,25 @@ namespace hercules
         , m_ready(false)
         , m_inVideoPacketQueue(NULL)
         , m_outVideoFrameQueue(NULL)
+        , m_visible(true)
+        , m_hiddenSinceMs(0)
+        , m_suspended(false)
+        , m_waitKeyFrame(false)
+        , m_skippedNum(0)
+        , m_quality(DecodeQuality::FULL)
+        , m_displayWidth(0)
+        , m_displayHeight(0)
+        , m_overloaded(false)
+        , m_hintDirty(false)
+        , m_codedWidth(0)
+        , m_codedHeight(0)
+        , m_outputFps(0)
+        , m_canDropNonRef(false)
+        , m_nalLengthSize(4)
+        , m_lastDts(-1)
+        , m_inIntervalMs(0)
+        , m_nextSampleDts(0)
+        , m_decimatedNum(0)
     {
         logInfo(MIXLOG);
     }
@@ -148,17 +168,23 @@ namespace hercules
 
                 if (m_ready)
                 {
-                    MediaFrame tMediaFrame;
-                    tMediaFrame.asVideo();
-                    tMediaFrame.setCodecType(tMediaPacket.getCodecType());
-                    tMediaFrame.setStreamId(tMediaPacket.getStreamId());
-                    tMediaFrame.setStreamName(tMediaPacket.getStreamName());
-                    tMediaFrame.setIdTimeTrace(tMediaPacket.getIdTimeTrace());
-                    tMediaFrame.setFrameId(tMediaPacket.getFrameId());
+                    if (!filterHidden(tMediaPacket))
+                    {
+                        continue;
+                    }
 
-                    int ret = doDecode(tMediaPacket, tMediaFrame);
-                    ++m_numOfDecoded;
+                    if (m_hintDirty.exchange(false))
+                    {
+                        applyDecodeHint();
+                    }
+
+                    if (decimate(tMediaPacket))
+                    {
+                        continue;
+                    }
 
+                    MediaFrame tMediaFrame;
+                    int ret = decodePacket(tMediaPacket, tMediaFrame);
                     if (ret != 0)
                     {
                         continue;
@@ -233,6 +259,7 @@ namespace hercules
 
         m_decodeCtx->thread_count = DEFAULT_DECODER_THREAD_COUNT;
 
+        ThreadSpawnScope spawn("decode");
         int ret = avcodec_open2(m_decodeCtx, m_decodeCtx->codec, NULL);
         if (ret < 0)
         {
@@ -243,14 +270,22 @@ namespace hercules
         {
             logInfo(MIXLOG << traceInfo() << "open codec success");
         }
+        spawn.adopt(m_decodeCtx);
 
+        m_hintDirty = true;
+        m_canDropNonRef = canDropNonRef(m_videoHeader);
+        m_nalLengthSize = getNalLengthSize(m_videoHeader);
         return 0;
     }
 
     bool Decoder::popMediaPacket(MediaPacket &tMediaPacket)
     {
-        return getInVideoQueue() ? 
-            getInVideoQueue()->pop(tMediaPacket, DEFAULT_QUEUE_TIMEOUT_MS) : false;
+        if (!getInVideoQueue() || !getInVideoQueue()->pop(tMediaPacket, DEFAULT_QUEUE_TIMEOUT_MS))
+        {
+            return false;
+        }
+        tMediaPacket.addIdTimeTrace(tMediaPacket.getStreamIndex(), TimeTraceKey::DELIVER, getNowMs32());
+        return true;
     }
 
     void Decoder::pushMediaFrame(MediaFrame &tMediaFrame)
@@ -267,6 +302,261 @@ namespace hercules
             getOutVideoQueue()->pop(tFrame, DEFAULT_QUEUE_TIMEOUT_MS) : false;
     }
 
+    int Decoder::decodePacket(MediaPacket &tMediaPacket, MediaFrame &tMediaFrame)
+    {
+        tMediaFrame.asVideo();
+        tMediaFrame.setCodecType(tMediaPacket.getCodecType());
+        tMediaFrame.setStreamId(tMediaPacket.getStreamId());
+        tMediaFrame.setStreamIndex(tMediaPacket.getStreamIndex());
+        tMediaFrame.setTimeTrace(tMediaPacket.getTimeTrace());
+        tMediaFrame.setFrameId(tMediaPacket.getFrameId());
+
+        int ret = doDecode(tMediaPacket, tMediaFrame);
+        ++m_numOfDecoded;
+        return ret;
+    }
+
+    DecodeStats Decoder::getDecodeStats() const
+    {
+        DecodeStats stats;
+        stats.m_suspended = m_suspended;
+        stats.m_skipped = m_skippedNum;
+        return stats;
+    }
+
+    void Decoder::setVisible(bool visible)
+    {
+        if (m_visible == visible)
+        {
+            return;
+        }
+        m_hiddenSinceMs = getNowMs();
+        m_visible = visible;
+        logInfo(MIXLOG << traceInfo() << " visible: " << visible);
+    }
+
+    DecodeQuality Decoder::parseDecodeQuality(const std::string &quality)
+    {
+        if (quality == "balanced")
+        {
+            return DecodeQuality::BALANCED;
+        }
+        if (quality == "fast")
+        {
+            return DecodeQuality::FAST;
+        }
+        return DecodeQuality::FULL;
+    }
+
+    void Decoder::setDecodeQuality(DecodeQuality quality)
+    {
+        m_quality = quality;
+        m_hintDirty = true;
+    }
+
+    void Decoder::setOverloaded(bool overloaded)
+    {
+        if (m_overloaded.exchange(overloaded) != overloaded)
+        {
+            m_hintDirty = true;
+        }
+    }
+
+    void Decoder::setDisplaySize(int width, int height)
+    {
+        if (m_displayWidth == width && m_displayHeight == height)
+        {
+            return;
+        }
+        m_displayWidth = width;
+        m_displayHeight = height;
+        m_hintDirty = true;
+    }
+
+    // fraction of the coded size actually shown, 0 when unknown
+    double Decoder::getDisplayScale() const
+    {
+        if (m_displayWidth <= 0 || m_displayHeight <= 0 || m_codedWidth <= 0 || m_codedHeight <= 0)
+        {
+            return 0;
+        }
+        return std::max(static_cast<double>(m_displayWidth) / m_codedWidth,
+                        static_cast<double>(m_displayHeight) / m_codedHeight);
+    }
+
+    // runs on the decode thread, the skip fields are read per frame by the codec
+    void Decoder::applyDecodeHint()
+    {
+        if (m_decodeCtx == NULL)
+        {
+            return;
+        }
+
+        double scale = getDisplayScale();
+        AVDiscard skipLoopFilter = AVDISCARD_DEFAULT;
+        AVDiscard skipIdct = AVDISCARD_DEFAULT;
+        if (m_overloaded)
+        {
+            skipLoopFilter = AVDISCARD_ALL;
+            skipIdct = AVDISCARD_NONREF;
+        }
+        else if (scale > 0 && scale <= kDecoderReduceScale)
+        {
+            if (m_quality == DecodeQuality::BALANCED)
+            {
+                skipLoopFilter = AVDISCARD_NONREF;
+            }
+            else if (m_quality == DecodeQuality::FAST)
+            {
+                skipLoopFilter = AVDISCARD_ALL;
+                skipIdct = AVDISCARD_NONREF;
+            }
+        }
+
+        if (m_decodeCtx->skip_loop_filter != skipLoopFilter || m_decodeCtx->skip_idct != skipIdct)
+        {
+            logInfo(MIXLOG << traceInfo() << " decode hint, quality: " << static_cast<int>(m_quality.load())
+                << ", overloaded: " << m_overloaded
+                << ", display: " << m_displayWidth << "x" << m_displayHeight
+                << ", coded: " << m_codedWidth << "x" << m_codedHeight
+                << ", skip loop filter: " << skipLoopFilter << ", skip idct: " << skipIdct);
+        }
+        m_decodeCtx->skip_loop_filter = skipLoopFilter;
+        m_decodeCtx->skip_idct = skipIdct;
+
+        // coded size is only known after the first picture
+        if (m_codedWidth <= 0)
+        {
+            m_hintDirty = true;
+        }
+    }
+
+    // drops a non-reference picture the output cadence would never sample,
+    // a picture is sampled when it is the first at or after the next output tick
+    bool Decoder::decimate(const MediaPacket &tMediaPacket)
+    {
+        int64_t dts = tMediaPacket.getDts();
+        if (m_lastDts >= 0 && dts > m_lastDts)
+        {
+            double interval = static_cast<double>(dts - m_lastDts);
+            m_inIntervalMs = m_inIntervalMs > 0 ? m_inIntervalMs * 0.9 + interval * 0.1 : interval;
+        }
+        else if (dts < m_lastDts)
+        {
+            m_nextSampleDts = 0;
+        }
+        m_lastDts = dts;
+
+        int outputFps = m_outputFps;
+        if (outputFps <= 0 || m_inIntervalMs <= 0 || !m_canDropNonRef)
+        {
+            return false;
+        }
+        double outIntervalMs = 1000.0 / outputFps;
+        if (outIntervalMs < m_inIntervalMs * kDecoderDecimateRatio)
+        {
+            return false;
+        }
+
+        if (dts + m_inIntervalMs / 2 >= m_nextSampleDts)
+        {
+            m_nextSampleDts = std::max(m_nextSampleDts + outIntervalMs, dts + outIntervalMs / 2);
+            return false;
+        }
+
+        AVPacket *avPacket = tMediaPacket.getAVPacket();
+        if (tMediaPacket.isIFrame() || avPacket == NULL
+            || !isNonRefPicture(avPacket->data, avPacket->size, m_videoHeader.m_codecType, m_nalLengthSize))
+        {
+            return false;
+        }
+
+        ++m_decimatedNum;
+        if (m_decimatedNum % 1000 == 1)
+        {
+            logInfo(MIXLOG << traceInfo() << " decimate, input interval: " << m_inIntervalMs
+                << ", output fps: " << outputFps << ", decimated: " << m_decimatedNum);
+        }
+        return true;
+    }
+
+    // returns false when the packet is held or dropped instead of decoded
+    bool Decoder::filterHidden(const MediaPacket &tMediaPacket)
+    {
+        bool suspend = !m_visible && getNowMs() >= m_hiddenSinceMs + kDecoderSuspendMs;
+        if (suspend != m_suspended)
+        {
+            m_suspended = suspend;
+            if (suspend)
+            {
+                logInfo(MIXLOG << traceInfo() << " suspend decode, skipped: " << m_skippedNum);
+            }
+            else
+            {
+                resumeHeld();
+            }
+        }
+
+        if (m_waitKeyFrame)
+        {
+            if (!tMediaPacket.isIFrame())
+            {
+                ++m_skippedNum;
+                return false;
+            }
+            m_waitKeyFrame = false;
+        }
+
+        if (!m_suspended)
+        {
+            return true;
+        }
+
+        // a new gop makes the held one useless
+        if (tMediaPacket.isIFrame())
+        {
+            m_skippedNum += m_heldPackets.size();
+            m_heldPackets.clear();
+            return true;
+        }
+
+        if (m_heldPackets.size() >= kDecoderMaxHeldPackets)
+        {
+            m_skippedNum += m_heldPackets.size() + 1;
+            m_heldPackets.clear();
+            m_waitKeyFrame = true;
+            return false;
+        }
+
+        m_heldPackets.push_back(tMediaPacket);
+        return false;
+    }
+
+    // catch up through the held gop, only the newest picture is dispatched
+    void Decoder::resumeHeld()
+    {
+        size_t held = m_heldPackets.size();
+        MediaFrame lastFrame;
+        bool gotFrame = false;
+        for (auto &packet : m_heldPackets)
+        {
+            MediaFrame frame;
+            if (decodePacket(packet, frame) == 0)
+            {
+                lastFrame = frame;
+                gotFrame = true;
+            }
+        }
+        m_heldPackets.clear();
+
+        if (gotFrame)
+        {
+            dispatch(lastFrame);
+        }
+        logInfo(MIXLOG << traceInfo() << " resume decode, held: " << held
+            << ", skipped: " << m_skippedNum);
+    }
+
     int Decoder::doDecode(MediaPacket &tMediaPacket, MediaFrame &tMediaFrame)
     {
         int got_frame = 0;
@@ -294,6 +584,9 @@ namespace hercules
                 << ", ret: " << ret << ", dts: " << tMediaPacket.getDts());
         }
 
+        m_codedWidth = m_decodeCtx->coded_width;
+        m_codedHeight = m_decodeCtx->coded_height;
+
         tMediaFrame.setAVFrame(avframe);
         tMediaFrame.setWidth(tMediaFrame.getAVFrame()->width);
         tMediaFrame.setHeight(tMediaFrame.getAVFrame()->height);
@@ -301,13 +594,14 @@ namespace hercules
         tMediaFrame.setDts(tMediaPacket.getDts());
         tMediaFrame.setPts(tMediaFrame.getDts() + cts);
         tMediaFrame.setFrameId(tMediaPacket.getFrameId());
-        tMediaFrame.addIdTimeTrace(tMediaFrame.getStreamId(), TimeTraceKey::DECODE, getNowMs32());
+        tMediaFrame.addIdTimeTrace(tMediaFrame.getStreamIndex(), TimeTraceKey::DECODE, getNowMs32());
 
         return 0;
     }
 
     void Decoder::addSubscriber(const std::string &subscriberName, SubscribeContext *context)
     {
+        std::unique_lock<std::mutex> lock(m_subscriberMutex);
         if (m_subscriberMap.find(subscriberName) == m_subscriberMap.end())
         {
             logInfo(MIXLOG << "subscriber name " << subscriberName << " insert");
@@ -322,6 +616,7 @@ namespace hercules
 
     void Decoder::delSubscriber(const std::string &subscriberName)
     {
+        std::unique_lock<std::mutex> lock(m_subscriberMutex);
         auto itr = m_subscriberMap.find(subscriberName);
         if (m_subscriberMap.end() != itr)
         {
@@ -336,6 +631,7 @@ namespace hercules
 
     void Decoder::dispatch(MediaFrame &frame)
     {
+        std::unique_lock<std::mutex> lock(m_subscriberMutex);
         for (auto &subscriber : m_subscriberMap)
         {
             logInfo(MIXLOG << " stream name: " << m_streamName << ", dts: " << frame.getDts());
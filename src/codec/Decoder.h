@@ -32,6 +32,8 @@ extern "C"
 #include <iostream>
 #include <string>
 #include <map>
+#include <mutex>
+#include <vector>
 
 struct AVCodecContext;
 struct AVPacket;
@@ -43,6 +45,25 @@ namespace hercules
     class MediaPacket;
     class MediaFrame;
 
+    // hidden longer than this, only keyframes are decoded and the rest of
+    // the gop is held so the stream can resume without waiting a keyframe
+    constexpr uint64_t kDecoderSuspendMs = 2000;
+    constexpr size_t kDecoderMaxHeldPackets = 500;
+
+    // how much picture quality a job trades for decode cpu on downscaled tiles,
+    // FULL unless the job opts in
+    enum class DecodeQuality
+    {
+        FULL = 0,       // always decode everything
+        BALANCED = 1,   // skip loop filter of non-reference frames
+        FAST = 2,       // skip all loop filter, and idct where the codec allows
+    };
+    // tiles shown at or below this fraction of the coded size get cheaper decoding
+    constexpr double kDecoderReduceScale = 0.5;
+    // non-reference pictures are decimated once the input interval is this
+    // much shorter than the output one
+    constexpr double kDecoderDecimateRatio = 1.2;
+
     class Decoder : public OneCycleThread, public Property
     {
     public:
@@ -75,10 +96,31 @@ namespace hercules
 
         AVCodecContext *getDecodeContext();
 
+        // set by the compositor when none of the layers of this stream is drawn
+        void setVisible(bool visible);
+        DecodeStats getDecodeStats() const;
+
+        static DecodeQuality parseDecodeQuality(const std::string &quality);
+        void setDecodeQuality(DecodeQuality quality);
+        // largest size of the source the layout needs, 0 when unknown
+        void setDisplaySize(int width, int height);
+        // cheapest decode regardless of quality and display size
+        void setOverloaded(bool overloaded);
+        // fastest cadence the frames of this decoder are sampled at
+        void setOutputFps(int fps) { m_outputFps = fps; }
+        uint64_t getDecimatedNum() const { return m_decimatedNum; }
+
     private:
         void threadEntry();
         int setupDecoder(const MediaPacket &tMediaPacket);
 
+        int decodePacket(MediaPacket &tMediaPacket, MediaFrame &tMediaFrame);
+        bool filterHidden(const MediaPacket &tMediaPacket);
+        void resumeHeld();
+        double getDisplayScale() const;
+        void applyDecodeHint();
+        bool decimate(const MediaPacket &tMediaPacket);
+
         void dispatch(MediaFrame &frame);
 
     private:
@@ -91,7 +133,32 @@ namespace hercules
         Queue<MediaPacket> *m_inVideoPacketQueue;
         Queue<MediaFrame> *m_outVideoFrameQueue;
 
+        std::atomic<bool> m_visible;
+        std::atomic<uint64_t> m_hiddenSinceMs;
+        std::atomic<bool> m_suspended;
+        bool m_waitKeyFrame;
+        std::vector<MediaPacket> m_heldPackets;
+        std::atomic<uint64_t> m_skippedNum;
+
+        std::atomic<DecodeQuality> m_quality;
+        std::atomic<int> m_displayWidth;
+        std::atomic<int> m_displayHeight;
+        std::atomic<bool> m_overloaded;
+        std::atomic<bool> m_hintDirty;
+        int m_codedWidth;
+        int m_codedHeight;
+
+        std::atomic<int> m_outputFps;
+        bool m_canDropNonRef;
+        int m_nalLengthSize;
+        int64_t m_lastDts;
+        double m_inIntervalMs;
+        double m_nextSampleDts;
+        std::atomic<uint64_t> m_decimatedNum;
+
         CycleCounterStat<1000> m_decodeFpsStat;
+        // shared decoders gain and lose subscribers while running
+        std::mutex m_subscriberMutex;
         std::map<std::string, SubscribeContext *> m_subscriberMap;
     };
 } // namespace hercules
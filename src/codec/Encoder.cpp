@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "Encoder.h"
+#include "CodecPool.h"
 #include "Common.h"
 #include "OpenCVOperator.h"
 #include "MediaPacket.h"
@@ -29,6 +30,8 @@ extern "C"
 #include "x264/x264.h"
 }
 
+#include <string.h>
+
 #include <utility>
 #include <string>
 
@@ -59,6 +62,11 @@ namespace hercules
         , m_lastSendDts(0)
         , m_lastSendPts(0)
         , m_lowLatency(true)
+        , m_fastPreset(false)
+        , m_lastCanvasHash(0)
+        , m_lastEncodePts(-1)
+        , m_lastKeyPts(-1)
+        , m_repeatSkippedNum(0)
         , m_copyDecoder(nullptr)
     {
         logInfo(MIXLOG);
@@ -84,7 +92,8 @@ namespace hercules
     {
         if (m_encodeCtx != nullptr)
         {
-            avcodec_free_context(&m_encodeCtx);
+            // x264 with many threads is slow to close, let the pool do it
+            CodecPool::getInstance()->checkin(m_encodeCtx);
             m_encodeCtx = nullptr;
         }
     }
@@ -126,6 +135,23 @@ namespace hercules
         m_ready = false;
     }
 
+    void Encoder::setFastPreset(bool fast)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        if (m_fastPreset == fast)
+        {
+            return;
+        }
+
+        logInfo(MIXLOG << traceInfo() << "fast preset: " << fast << ", low latency: " << m_lowLatency);
+        m_fastPreset = fast;
+        if (!m_lowLatency)
+        {
+            // reopened on the next frame, the new stream starts with a keyframe
+            m_ready = false;
+        }
+    }
+
     void Encoder::setBitrate(int bitrate)
     {
         m_codec.m_kbps = bitrate;
@@ -163,6 +189,11 @@ namespace hercules
                     }
                 }
 
+                if (skipRepeat(tMediaFrame))
+                {
+                    continue;
+                }
+
                 int64_t avframe_pts = (int64_t)tMediaFrame.getPts();
                 tMediaFrame.getAVFrame()->pts = avframe_pts;
 
@@ -231,6 +262,7 @@ namespace hercules
                     if (pictType == AV_PICTURE_TYPE_I)
                     {
                         print = true;
+                        m_lastKeyPts = pts;
                         tMediaFrame.asIFrame();
                         tMediaPacket.asIFrame();
                     }
@@ -295,12 +327,70 @@ namespace hercules
         logInfo(MIXLOG << "thread stop: " << traceInfo());
     }
 
-    int Encoder::setupEncoder()
+    // the mixer re-sends its last canvas while no layer changed, and a paused
+    // input composites to the same picture too; both are caught by the hash.
+    // a keepalive after a skipped stretch longer than a gop is forced to a keyframe
+    bool Encoder::skipRepeat(MediaFrame &tMediaFrame)
     {
-        reset();
+        AVFrame *frame = tMediaFrame.getAVFrame();
+        int64_t pts = tMediaFrame.getPts();
+        uint64_t hash = hashCanvas(frame);
+        bool repeat = m_lastEncodePts >= 0 && hash == m_lastCanvasHash;
+        m_lastCanvasHash = hash;
+
+        if (repeat && pts >= m_lastEncodePts && pts < m_lastEncodePts + kEncoderRepeatKeepaliveMs)
+        {
+            if (++m_repeatSkippedNum % 1000 == 0)
+            {
+                logInfo(MIXLOG << traceInfo() << " repeated canvas skipped: " << m_repeatSkippedNum);
+            }
+            return true;
+        }
+
+        frame->pict_type = AV_PICTURE_TYPE_NONE;
+        if (repeat && m_encodeCtx != nullptr && m_codec.m_fps > 0 && m_lastKeyPts >= 0)
+        {
+            int64_t gopMs = static_cast<int64_t>(m_encodeCtx->gop_size) * 1000 / m_codec.m_fps;
+            if (pts >= m_lastKeyPts + gopMs)
+            {
+                frame->pict_type = AV_PICTURE_TYPE_I;
+            }
+        }
+        m_lastEncodePts = pts;
+        return false;
+    }
+
+    uint64_t Encoder::hashCanvas(const AVFrame *frame)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (int plane = 0; plane < 3 && frame->data[plane] != nullptr; ++plane)
+        {
+            int width = plane == 0 ? frame->width : (frame->width + 1) / 2;
+            int height = plane == 0 ? frame->height : (frame->height + 1) / 2;
+            for (int y = 0; y < height; ++y)
+            {
+                const uint8_t *row = frame->data[plane] + static_cast<int64_t>(y) * frame->linesize[plane];
+                int x = 0;
+                for (; x + 8 <= width; x += 8)
+                {
+                    uint64_t word;
+                    memcpy(&word, row + x, sizeof(word));
+                    hash = (hash ^ word) * 1099511628211ULL;
+                }
+                for (; x < width; ++x)
+                {
+                    hash = (hash ^ row[x]) * 1099511628211ULL;
+                }
+            }
+        }
+        return hash;
+    }
 
+    AVCodecContext *Encoder::openEncoder(const VideoCodec &codec, bool lowLatency, bool fastPreset,
+        Decoder *copyDecoder)
+    {
         string encoderName = "libx264";
-        if (m_codec.m_codecType == CodecType::H265)
+        if (codec.m_codecType == CodecType::H265)
         {
             // TODO IMP
         }
@@ -309,75 +399,73 @@ namespace hercules
 
         if (avcodec == nullptr)
         {
-            logErr(MIXLOG << traceInfo() << " can't find avcodec: " << encoderName);
-            return -1;
+            logErr(MIXLOG << "can't find avcodec: " << encoderName);
+            return nullptr;
         }
 
-        m_encodeCtx = avcodec_alloc_context3(avcodec);
-        return_if(!m_encodeCtx, "allocate encode context fail");
+        AVCodecContext *ctx = avcodec_alloc_context3(avcodec);
+        if (ctx == nullptr)
+        {
+            logErr(MIXLOG << "allocate encode context fail");
+            return nullptr;
+        }
 
-        m_encodeCtx->time_base = (AVRational){1, 1000};
-        m_encodeCtx->flags |= CODEC_FLAG_GLOBAL_HEADER;
-        m_encodeCtx->width = m_codec.m_width;
-        m_encodeCtx->height = m_codec.m_height;
-        m_encodeCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+        ctx->time_base = (AVRational){1, 1000};
+        ctx->flags |= CODEC_FLAG_GLOBAL_HEADER;
+        ctx->width = codec.m_width;
+        ctx->height = codec.m_height;
+        ctx->pix_fmt = AV_PIX_FMT_YUV420P;
 
-        if (m_lowLatency)
+        if (lowLatency)
         {
-            m_encodeCtx->gop_size = m_codec.m_fps * 1;
-            m_encodeCtx->max_b_frames = 0;
+            ctx->gop_size = codec.m_fps * 1;
+            ctx->max_b_frames = 0;
         }
         else
         {
-            m_encodeCtx->gop_size = m_codec.m_fps * 3;
+            ctx->gop_size = codec.m_fps * 3;
 
-            if (m_codec.m_codecType == CodecType::H264)
+            if (codec.m_codecType == CodecType::H264)
             {
-                m_encodeCtx->max_b_frames = 1;
+                ctx->max_b_frames = 1;
             }
         }
 
-        logInfo(MIXLOG << traceInfo() << ", width: " << m_codec.m_width << ", height: " 
-            << m_codec.m_height << ", fps: " << m_codec.m_fps);
+        logInfo(MIXLOG << "width: " << codec.m_width << ", height: " 
+            << codec.m_height << ", fps: " << codec.m_fps);
 
-        int bit_rate = m_codec.m_kbps * 1024;
-        m_encodeCtx->bit_rate = bit_rate;
-        m_encodeCtx->rc_min_rate = bit_rate;
-        m_encodeCtx->rc_max_rate = bit_rate;
-        m_encodeCtx->bit_rate_tolerance = bit_rate;
-        m_encodeCtx->rc_buffer_size = bit_rate * 9 / 20;
-        m_encodeCtx->rc_initial_buffer_occupancy = m_encodeCtx->rc_buffer_size * 4 / 5;
-        m_encodeCtx->qcompress = 1.0;
+        applyBitrate(ctx, codec.m_kbps);
+        ctx->qcompress = 1.0;
 
-        logInfo(MIXLOG << "encoder bitrate: " << m_encodeCtx->bit_rate);
+        logInfo(MIXLOG << "encoder bitrate: " << ctx->bit_rate);
 
-        if (m_copyDecoder != nullptr)
+        if (copyDecoder != nullptr)
         {
             logInfo(MIXLOG << "copy decoder1");
-            AVCodecContext *decoder = m_copyDecoder->getDecodeContext();
+            AVCodecContext *decoder = copyDecoder->getDecodeContext();
             if (decoder != nullptr)
             {
                 logInfo(MIXLOG << "copy decoder"
                     << ", bitrate:" << decoder->bit_rate 
                     << ", gop size:" << decoder->gop_size);
-                m_encodeCtx->width = decoder->width;
-                m_encodeCtx->height = decoder->height;
-                m_encodeCtx->pix_fmt = decoder->pix_fmt;
+                ctx->width = decoder->width;
+                ctx->height = decoder->height;
+                ctx->pix_fmt = decoder->pix_fmt;
             }
         }
 
-        if (m_lowLatency)
+        if (lowLatency)
         {
-            av_opt_set(m_encodeCtx->priv_data, "mbtree", "0", 0);
-            av_opt_set(m_encodeCtx->priv_data, "rc-lookahead", "0", 0);
+            av_opt_set(ctx->priv_data, "mbtree", "0", 0);
+            av_opt_set(ctx->priv_data, "rc-lookahead", "0", 0);
         }
 
-        if (m_codec.m_codecType == CodecType::H264)
+        if (codec.m_codecType == CodecType::H264)
         {
             // fps
             char x264opts[512] = {0};
             char param[16] = {0};
-            snprintf(param, sizeof(param), "fps=%u/%u", m_codec.m_fps, 1);
+            snprintf(param, sizeof(param), "fps=%u/%u", codec.m_fps, 1);
 
             ADD_X264OPTS(x264opts, param);
             ADD_X264OPTS(x264opts, "annexb=0");
@@ -385,31 +473,82 @@ namespace hercules
             ADD_X264OPTS(x264opts, "psy=0");
             ADD_X264OPTS(x264opts, "psnr=1");
 
-            if (m_lowLatency)
+            if (lowLatency)
             {
-                av_opt_set(m_encodeCtx->priv_data, "preset", "ultrafast", 0);
-                av_opt_set(m_encodeCtx->priv_data, "tune", "zerolatency", 0);
+                av_opt_set(ctx->priv_data, "preset", "ultrafast", 0);
+                av_opt_set(ctx->priv_data, "tune", "zerolatency", 0);
             }
             else
             {
-                av_opt_set(m_encodeCtx->priv_data, "preset", "faster", 0);
-                av_opt_set(m_encodeCtx->priv_data, "mbtree", "0", 0);
-                av_opt_set(m_encodeCtx->priv_data, "rc-lookahead", "5", 0);
+                av_opt_set(ctx->priv_data, "preset", fastPreset ? "superfast" : "faster", 0);
+                av_opt_set(ctx->priv_data, "mbtree", "0", 0);
+                av_opt_set(ctx->priv_data, "rc-lookahead", "5", 0);
             }
 
-            m_encodeCtx->thread_count = 16;
-            av_opt_set(m_encodeCtx->priv_data, "x264opts", x264opts, 0);
+            ctx->thread_count = 16;
+            av_opt_set(ctx->priv_data, "x264opts", x264opts, 0);
         }
-        else if (m_codec.m_codecType == CodecType::H265)
+        else if (codec.m_codecType == CodecType::H265)
         {
             // TODO IMP
         }
 
-        av_opt_set(m_encodeCtx->priv_data, "b-pyramid", "0", 0);
-        logInfo(MIXLOG << "bitrate:" << m_encodeCtx->bit_rate);
-        if (avcodec_open2(m_encodeCtx, m_encodeCtx->codec, nullptr) < 0)
+        av_opt_set(ctx->priv_data, "b-pyramid", "0", 0);
+        logInfo(MIXLOG << "bitrate:" << ctx->bit_rate);
+        // x264 starts its worker threads here
+        ThreadSpawnScope spawn("encode");
+        if (avcodec_open2(ctx, ctx->codec, nullptr) < 0)
+        {
+            avcodec_free_context(&ctx);
+            logErr(MIXLOG << "open encode codec fail!");
+            return nullptr;
+        }
+        spawn.adopt(ctx);
+
+        return ctx;
+    }
+
+
+    void Encoder::applyBitrate(AVCodecContext *ctx, int kbps)
+    {
+        int bit_rate = kbps * 1024;
+        ctx->bit_rate = bit_rate;
+        ctx->rc_min_rate = bit_rate;
+        ctx->rc_max_rate = bit_rate;
+        ctx->bit_rate_tolerance = bit_rate;
+        ctx->rc_buffer_size = bit_rate * 9 / 20;
+        ctx->rc_initial_buffer_occupancy = ctx->rc_buffer_size * 4 / 5;
+    }
+
+    int Encoder::setupEncoder()
+    {
+        reset();
+        m_lastEncodePts = -1;
+        m_lastKeyPts = -1;
+
+        // copy decoder takes size and format from the input, not poolable
+        // the pool only holds default preset contexts
+        if (m_copyDecoder == nullptr && (m_lowLatency || !m_fastPreset))
+        {
+            VideoCodec codec = m_codec;
+            bool lowLatency = m_lowLatency;
+            m_encodeCtx = CodecPool::getInstance()->checkout(CodecPoolKey::video(codec, lowLatency),
+                [codec, lowLatency]() { return Encoder::openEncoder(codec, lowLatency, false, nullptr); });
+            if (m_encodeCtx != nullptr)
+            {
+                // x264 picks up the new rate control on the next encode call
+                applyBitrate(m_encodeCtx, m_codec.m_kbps);
+                // on a hit its workers were opened by the pool thread, from now on they work for this job
+                ThreadManager::getInstance()->moveOwner(m_encodeCtx, ThreadManager::currentGroup());
+            }
+        }
+        else
+        {
+            m_encodeCtx = openEncoder(m_codec, m_lowLatency, m_fastPreset, m_copyDecoder);
+        }
+
+        if (m_encodeCtx == nullptr)
         {
-            reset();
             logErr(MIXLOG << traceInfo() << "|open encode codec fail!");
             return -1;
         }
@@ -511,7 +650,7 @@ namespace hercules
 
     void Encoder::insertFrameMetadata(int64_t key, const MediaFrame &tMediaFrame)
     {
-        FrameMetadata frameMetadata(tMediaFrame.getIdTimestamp(), tMediaFrame.getIdTimeTrace());
+        FrameMetadata frameMetadata(tMediaFrame.getTimeTrace());
         m_frameMetadata.insert(make_pair(key, frameMetadata));
 
         if (m_frameMetadata.size() >= 100)
@@ -529,8 +668,7 @@ namespace hercules
             return false;
         }
 
-        tMediaPacket.setIdTimeTrace(iter->second.m_idTimeTrace);
-        tMediaPacket.setIdTimestamp(iter->second.m_idTimestamp);
+        tMediaPacket.setTimeTrace(iter->second.m_timeTrace);
 
         m_frameMetadata.erase(m_frameMetadata.begin(), iter);
 
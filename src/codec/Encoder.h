@@ -44,6 +44,9 @@ namespace hercules
     class MediaPacket;
     class Decoder;
 
+    // an unchanged canvas is encoded at least this often to keep the stream alive
+    constexpr int64_t kEncoderRepeatKeepaliveMs = 500;
+
     class Encoder : public OneCycleThread, public Property
     {
     public:
@@ -66,18 +69,18 @@ namespace hercules
             int kbps, const std::string &codec);
         void setBitrate(int bitrate);
         void setLowLatency(bool lowLatency) { m_lowLatency = lowLatency; }
+        // one preset cheaper while the host is overloaded, low latency is already ultrafast
+        void setFastPreset(bool fast);
+        uint64_t getRepeatSkippedNum() const { return m_repeatSkippedNum; }
 
     private:
         struct FrameMetadata
         {
-            FrameMetadata(const std::map<uint64_t, uint32_t> &idTimestamp,
-                          const std::map<uint64_t, std::map<TimeTraceKey, uint32_t>> &idTimeTrace)
-                : m_idTimestamp(idTimestamp), m_idTimeTrace(idTimeTrace)
+            explicit FrameMetadata(const TimeTrace &timeTrace) : m_timeTrace(timeTrace)
             {
             }
 
-            std::map<uint64_t, uint32_t> m_idTimestamp;
-            std::map<uint64_t, std::map<TimeTraceKey, uint32_t>> m_idTimeTrace;
+            TimeTrace m_timeTrace;
         };
 
         std::map<int64_t, FrameMetadata> m_frameMetadata;
@@ -94,6 +97,12 @@ namespace hercules
 
         int doEncode(AVFrame *tFrame, AVPacket *tPacket);
         int setupEncoder();
+        bool skipRepeat(MediaFrame &tMediaFrame);
+        static uint64_t hashCanvas(const AVFrame *frame);
+
+        static AVCodecContext *openEncoder(const VideoCodec &codec, bool lowLatency, bool fastPreset,
+            Decoder *copyDecoder);
+        static void applyBitrate(AVCodecContext *ctx, int kbps);
 
         void reset();
 
@@ -116,6 +125,12 @@ namespace hercules
         uint32_t m_lastSendPts;
 
         bool m_lowLatency;
+        bool m_fastPreset;
+
+        uint64_t m_lastCanvasHash;
+        int64_t m_lastEncodePts;
+        int64_t m_lastKeyPts;
+        std::atomic<uint64_t> m_repeatSkippedNum;
 
         Decoder *m_copyDecoder;
     };
@@ -24,6 +24,9 @@ namespace hercules
     constexpr int DEFAULT_CHANNEL_NUM = 2;
     constexpr int DEFAULT_SAMPLE_RATE = 44100;
     constexpr int DEFAULT_AUDIO_BPS = 192;
+    constexpr int DEFAULT_AUDIO_FRAME_SAMPLES = 1024; // aac
+    constexpr int OPUS_SAMPLE_RATE = 48000;
+    constexpr int OPUS_DEFAULT_FRAME_MS = 10;
 
     // decoder property
     constexpr int DEFAULT_DECODER_EXTRADATA_SIZE = 1024;
@@ -0,0 +1,250 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FanoutPublisher.h"
+#include "RtmpPublisher.h"
+#include "LocalPublisher.h"
+#include "MediaPacket.h"
+#include "Log.h"
+
+#include <string>
+
+namespace hercules
+{
+
+    using std::string;
+
+    FanoutPublisher::FanoutPublisher(const string &taskId)
+        : OneCycleThread()
+        , m_taskId(taskId)
+        , m_hasVideoHeader(false)
+        , m_hasAudioHeader(false)
+    {
+    }
+
+    FanoutPublisher::~FanoutPublisher()
+    {
+        logInfo(MIXLOG << "~FanoutPublisher");
+    }
+
+    int FanoutPublisher::addDestination(const string &type, const string &url)
+    {
+        Destination dest;
+        if (type == "rtmp")
+        {
+            dest.m_streamer = std::shared_ptr<Streamer>(new RtmpPublisher());
+        }
+        else if (type == "local")
+        {
+            dest.m_streamer = std::shared_ptr<Streamer>(new LocalPublisher(m_taskId));
+        }
+        else
+        {
+            logErr(MIXLOG << "error, unknown destination type: " << type);
+            return -1;
+        }
+
+        dest.m_url = url;
+        dest.m_streamer->setParam(getStreamName(), url.empty() ? m_url : url, getUid());
+        if (m_destinations.empty() && !m_latencyKey.empty())
+        {
+            dest.m_streamer->setLatencyKey(m_latencyKey);
+        }
+        m_destinations.push_back(dest);
+        logInfo(MIXLOG << "add destination, type: " << type << ", url: " << url
+            << ", destinations: " << m_destinations.size());
+        return 0;
+    }
+
+    void FanoutPublisher::setParam(const string &streamname, const string &url, uint64_t uid)
+    {
+        Streamer::setParam(streamname, url, uid);
+        for (auto &dest : m_destinations)
+        {
+            dest.m_streamer->setParam(streamname, dest.m_url.empty() ? url : dest.m_url, uid);
+        }
+    }
+
+    void FanoutPublisher::setVideoCodec(int width, int height, int fps, int kbps, const string &codec)
+    {
+        Streamer::setVideoCodec(width, height, fps, kbps, codec);
+        for (auto &dest : m_destinations)
+        {
+            dest.m_streamer->setVideoCodec(width, height, fps, kbps, codec);
+        }
+    }
+
+    void FanoutPublisher::setAudioCodec(int channels, int sampleRate, int kbps, const string &codec)
+    {
+        Streamer::setAudioCodec(channels, sampleRate, kbps, codec);
+        for (auto &dest : m_destinations)
+        {
+            dest.m_streamer->setAudioCodec(channels, sampleRate, kbps, codec);
+        }
+    }
+
+    void FanoutPublisher::setLatencyKey(const string &jobKey)
+    {
+        m_latencyKey = jobKey;
+        if (!m_destinations.empty())
+        {
+            m_destinations.front().m_streamer->setLatencyKey(jobKey);
+        }
+    }
+
+    void FanoutPublisher::start()
+    {
+        for (auto &dest : m_destinations)
+        {
+            dest.m_streamer->setOpt(m_opt);
+            dest.m_streamer->start();
+        }
+        OneCycleThread::startThread("fanout");
+    }
+
+    void FanoutPublisher::stop()
+    {
+        OneCycleThread::stopThread();
+        for (auto &dest : m_destinations)
+        {
+            dest.m_streamer->stop();
+        }
+    }
+
+    void FanoutPublisher::join()
+    {
+        OneCycleThread::joinThread();
+        for (auto &dest : m_destinations)
+        {
+            dest.m_streamer->join();
+        }
+    }
+
+    void FanoutPublisher::threadEntry()
+    {
+        logInfo(MIXLOG << "fanout publisher thread start, stream name: " << getStreamName()
+            << ", destinations: " << m_destinations.size());
+        while (!isStop())
+        {
+            uint64_t seq = queueSeq();
+            bool forwarded = false;
+            MediaPacket packet;
+            if (getVideoQueue()->pop(packet, 0))
+            {
+                forwarded = true;
+                if (packet.isHeaderFrame())
+                {
+                    m_videoHeader = packet;
+                    m_hasVideoHeader = true;
+                }
+                for (auto &dest : m_destinations)
+                {
+                    forwardVideo(dest, packet);
+                }
+            }
+
+            while (getAudioQueue()->pop(packet, 0))
+            {
+                forwarded = true;
+                if (packet.isHeaderFrame())
+                {
+                    m_audioHeader = packet;
+                    m_hasAudioHeader = true;
+                }
+                for (auto &dest : m_destinations)
+                {
+                    forwardAudio(dest, packet);
+                }
+            }
+
+            if (!forwarded)
+            {
+                waitQueued(seq, kPublishWaitMs);
+            }
+        }
+        logInfo(MIXLOG << "fanout publisher thread stop, stream name: " << getStreamName());
+    }
+
+    // the header goes in just ahead of the packet that resumes the destination
+    static void pushWithHeader(Queue<MediaPacket> *queue, const MediaPacket &header,
+                               const MediaPacket &packet)
+    {
+        MediaPacket resend(header);
+        uint32_t dts = packet.getDts() > 0 ? packet.getDts() - 1 : 0;
+        resend.setDts(dts);
+        resend.setPts(dts);
+        queue->push(dts, resend);
+    }
+
+    void FanoutPublisher::forwardVideo(Destination &dest, const MediaPacket &packet)
+    {
+        if (dest.m_waitKeyFrame && !packet.isHeaderFrame())
+        {
+            if (!packet.isIFrame())
+            {
+                ++dest.m_dropped;
+                return;
+            }
+            dest.m_waitKeyFrame = false;
+        }
+
+        Queue<MediaPacket> *queue = dest.m_streamer->getVideoQueue();
+        if (dest.m_needVideoHeader && !packet.isHeaderFrame() && m_hasVideoHeader)
+        {
+            pushWithHeader(queue, m_videoHeader, packet);
+        }
+        dest.m_needVideoHeader = false;
+        queue->push(packet.getDts(), packet);
+        trimBacklog(dest);
+    }
+
+    void FanoutPublisher::forwardAudio(Destination &dest, const MediaPacket &packet)
+    {
+        // audio resumes with the video so the destination does not play sound over a frozen picture
+        if (dest.m_waitKeyFrame && m_opt.m_publishVideo)
+        {
+            ++dest.m_dropped;
+            return;
+        }
+
+        Queue<MediaPacket> *queue = dest.m_streamer->getAudioQueue();
+        if (dest.m_needAudioHeader && !packet.isHeaderFrame() && m_hasAudioHeader)
+        {
+            pushWithHeader(queue, m_audioHeader, packet);
+        }
+        dest.m_needAudioHeader = false;
+        queue->push(packet.getDts(), packet);
+        trimBacklog(dest);
+    }
+
+    void FanoutPublisher::trimBacklog(Destination &dest)
+    {
+        Queue<MediaPacket> *videoQueue = dest.m_streamer->getVideoQueue();
+        Queue<MediaPacket> *audioQueue = dest.m_streamer->getAudioQueue();
+        if (videoQueue->span() <= kFanoutMaxBacklogMs && audioQueue->span() <= kFanoutMaxBacklogMs)
+        {
+            return;
+        }
+
+        size_t dropped = videoQueue->clear() + audioQueue->clear();
+        dest.m_dropped += dropped;
+        // the cleared packets may have held the headers the destination has not sent yet
+        dest.m_waitKeyFrame = m_opt.m_publishVideo;
+        dest.m_needVideoHeader = true;
+        dest.m_needAudioHeader = true;
+        logWarn(MIXLOG << "destination behind, url: " << (dest.m_url.empty() ? m_url : dest.m_url)
+            << ", dropped: " << dropped << ", total dropped: " << dest.m_dropped);
+    }
+
+} // namespace hercules
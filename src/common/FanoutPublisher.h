@@ -0,0 +1,85 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "OneCycleThread.h"
+#include "Queue.h"
+#include "Streamer.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace hercules
+{
+
+    // a destination whose queue spans more than this is cut back to the next keyframe
+    constexpr uint32_t kFanoutMaxBacklogMs = 3000;
+
+    // serves the packets of one encoder to several publishers, each one has its
+    // own queues so a slow or reconnecting destination only loses its own backlog
+    class FanoutPublisher : public OneCycleThread, public Streamer
+    {
+    public:
+        explicit FanoutPublisher(const std::string &taskId);
+        ~FanoutPublisher();
+
+        // type is "rtmp" or "local", an empty url follows the stream name
+        int addDestination(const std::string &type, const std::string &url);
+
+        void setParam(const std::string &streamname, const std::string &url, uint64_t uid);
+        void setVideoCodec(int width, int height, int fps, int kbps, const std::string &codec);
+        void setAudioCodec(int channels, int sampleRate, int kbps, const std::string &codec);
+        // only the first destination is measured, one sample per packet like a single publisher
+        void setLatencyKey(const std::string &jobKey);
+
+        void start();
+        void stop();
+        void join();
+
+    protected:
+        void threadEntry();
+
+    private:
+        struct Destination
+        {
+            Destination() : m_waitKeyFrame(false), m_needVideoHeader(false),
+                            m_needAudioHeader(false), m_dropped(0)
+            {
+            }
+            std::shared_ptr<Streamer> m_streamer;
+            std::string m_url;
+            bool m_waitKeyFrame;
+            bool m_needVideoHeader;
+            bool m_needAudioHeader;
+            uint64_t m_dropped;
+        };
+
+        void forwardVideo(Destination &dest, const MediaPacket &packet);
+        void forwardAudio(Destination &dest, const MediaPacket &packet);
+        void trimBacklog(Destination &dest);
+
+    private:
+        std::string m_taskId;
+        std::string m_latencyKey;
+        std::vector<Destination> m_destinations;
+
+        MediaPacket m_videoHeader;
+        MediaPacket m_audioHeader;
+        bool m_hasVideoHeader;
+        bool m_hasAudioHeader;
+    };
+
+} // namespace hercules
@@ -0,0 +1,228 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FileWatcher.h"
+#include "Log.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <iterator>
+#include <string>
+
+namespace hercules
+{
+
+    // editors usually write a temp file and rename it over the original,
+    // so watch the directory and match by name instead of the file inode
+    static const uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+    static const int kPollTimeoutMs = 200;
+
+    FileWatcher::FileWatcher() : m_fd(-1)
+    {
+        m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_fd < 0)
+        {
+            logErr(MIXLOG << "inotify init failed, err: " << strerror(errno));
+            return;
+        }
+
+        // process wide
+        ThreadGroupGuard guard("");
+        startThread("FileWatcher");
+    }
+
+    FileWatcher::~FileWatcher()
+    {
+        stopThread();
+        joinThread();
+
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    int FileWatcher::watch(const std::string &fileName, std::atomic<bool> *dirty)
+    {
+        if (m_fd < 0)
+        {
+            return -1;
+        }
+
+        char resolved[PATH_MAX];
+        std::string path = realpath(fileName.c_str(), resolved) ? resolved : fileName;
+        size_t pos = path.rfind('/');
+        std::string dir = pos == std::string::npos ? "." : (pos == 0 ? "/" : path.substr(0, pos));
+
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+
+        if (m_dirWd.find(dir) == m_dirWd.end())
+        {
+            int wd = inotify_add_watch(m_fd, dir.c_str(), kWatchMask);
+            if (wd < 0)
+            {
+                logErr(MIXLOG << "watch dir " << dir << " failed, err: " << strerror(errno));
+                return -1;
+            }
+            m_wdDir[wd] = dir;
+            m_dirWd[dir] = wd;
+        }
+
+        if (m_fileFlags[path].insert(dirty).second)
+        {
+            logInfo(MIXLOG << "watch file: " << path);
+        }
+
+        return 0;
+    }
+
+    void FileWatcher::unwatch(std::atomic<bool> *dirty)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+
+        std::set<std::string> dirs;
+        auto iter = m_fileFlags.begin();
+        while (iter != m_fileFlags.end())
+        {
+            iter->second.erase(dirty);
+            if (iter->second.empty())
+            {
+                size_t pos = iter->first.rfind('/');
+                dirs.insert(pos == std::string::npos ? "." : (pos == 0 ? "/" : iter->first.substr(0, pos)));
+                iter = m_fileFlags.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+
+        for (const auto &dir : dirs)
+        {
+            removeEmptyDir(dir);
+        }
+    }
+
+    void FileWatcher::removeEmptyDir(const std::string &dir)
+    {
+        std::string prefix = dir == "/" ? dir : dir + "/";
+        for (auto iter = m_fileFlags.lower_bound(prefix);
+             iter != m_fileFlags.end() && iter->first.compare(0, prefix.size(), prefix) == 0; ++iter)
+        {
+            if (iter->first.find('/', prefix.size()) == std::string::npos)
+            {
+                return;
+            }
+        }
+
+        auto iter = m_dirWd.find(dir);
+        if (iter != m_dirWd.end())
+        {
+            inotify_rm_watch(m_fd, iter->second);
+            m_wdDir.erase(iter->second);
+            m_dirWd.erase(iter);
+        }
+    }
+
+    void FileWatcher::threadEntry()
+    {
+        struct pollfd pfd;
+        pfd.fd = m_fd;
+        pfd.events = POLLIN;
+
+        while (!isStop())
+        {
+            pfd.revents = 0;
+            int ret = poll(&pfd, 1, kPollTimeoutMs);
+            if (ret > 0 && (pfd.revents & POLLIN))
+            {
+                handleEvents();
+            }
+            else if (ret < 0 && errno != EINTR)
+            {
+                logErr(MIXLOG << "poll inotify failed, err: " << strerror(errno));
+                sleepms(kPollTimeoutMs);
+            }
+        }
+    }
+
+    void FileWatcher::handleEvents()
+    {
+        char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        while (true)
+        {
+            ssize_t len = read(m_fd, buf, sizeof(buf));
+            if (len <= 0)
+            {
+                break;
+            }
+
+            for (char *p = buf; p < buf + len;)
+            {
+                const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+                p += sizeof(struct inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    logWarn(MIXLOG << "inotify queue overflow, mark all files changed");
+                    notify("");
+                    continue;
+                }
+
+                if (event->len == 0)
+                {
+                    continue;
+                }
+
+                std::string dir;
+                {
+                    std::unique_lock<std::mutex> lockGuard(m_mutex);
+                    auto iter = m_wdDir.find(event->wd);
+                    if (iter == m_wdDir.end())
+                    {
+                        continue;
+                    }
+                    dir = iter->second;
+                }
+
+                notify(dir == "/" ? dir + event->name : dir + "/" + event->name);
+            }
+        }
+    }
+
+    void FileWatcher::notify(const std::string &path)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+
+        auto iter = path.empty() ? m_fileFlags.begin() : m_fileFlags.find(path);
+        auto end = path.empty() || iter == m_fileFlags.end() ? m_fileFlags.end() : std::next(iter);
+        for (; iter != end; ++iter)
+        {
+            for (auto flag : iter->second)
+            {
+                *flag = true;
+            }
+
+            logInfo(MIXLOG << "file changed: " << iter->first << ", watchers: " << iter->second.size());
+        }
+    }
+
+} // namespace hercules
@@ -0,0 +1,61 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "OneCycleThread.h"
+#include "Singleton.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace hercules
+{
+
+    // process wide inotify watcher, sets the registered flags when a watched file
+    // is rewritten, so callers only need an atomic load to find out
+    class FileWatcher : public OneCycleThread, public Singleton<FileWatcher>
+    {
+        friend class Singleton<FileWatcher>;
+
+    private:
+        FileWatcher();
+        ~FileWatcher();
+
+    public:
+        int watch(const std::string &fileName, std::atomic<bool> *dirty);
+        void unwatch(std::atomic<bool> *dirty);
+
+        virtual void threadEntry();
+
+    private:
+        void handleEvents();
+        void notify(const std::string &path);
+        void removeEmptyDir(const std::string &dir);
+
+    private:
+        int m_fd;
+        std::mutex m_mutex;
+
+        // watch descriptor -> directory
+        std::map<int, std::string> m_wdDir;
+        std::map<std::string, int> m_dirWd;
+        // file path -> flags to set on change
+        std::map<std::string, std::set<std::atomic<bool> *>> m_fileFlags;
+    };
+
+} // namespace hercules
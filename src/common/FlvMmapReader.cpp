@@ -0,0 +1,342 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FlvMmapReader.h"
+#include "Util.h"
+#include "Log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+namespace hercules
+{
+
+    using namespace flvhelper;
+
+    namespace flv
+    {
+        // used as loop gap when the file has no video to estimate it from
+        constexpr uint32_t DEFAULT_TAG_INTERVAL_MS = 40;
+        // timestamp jump bigger than this resets the pacing base instead of sleeping
+        constexpr uint32_t MAX_PACE_SLEEP_MS = 1000;
+
+        static inline uint32_t readU24(const unsigned char *p)
+        {
+            return (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+        }
+
+        static inline uint32_t readU32(const unsigned char *p)
+        {
+            return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+                | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+        }
+
+        FlvMmapReader::FlvMmapReader() : m_fd(-1),
+                                         m_base(nullptr),
+                                         m_size(0),
+                                         m_firstTagOffset(0),
+                                         m_offset(0),
+                                         m_loop(false),
+                                         m_realtime(false),
+                                         m_indexed(false),
+                                         m_firstTimestamp(0),
+                                         m_lastTimestamp(0),
+                                         m_loopOffset(0),
+                                         m_lastOutTimestamp(0),
+                                         m_frameInterval(DEFAULT_TAG_INTERVAL_MS),
+                                         m_paceBaseMs(-1),
+                                         m_paceBaseTimestamp(0)
+        {
+        }
+
+        FlvMmapReader::~FlvMmapReader()
+        {
+            destroy();
+        }
+
+        int FlvMmapReader::init(const std::string &fileName, bool buildIdx)
+        {
+            destroy();
+
+            m_fileName = fileName;
+            m_fd = open(fileName.c_str(), O_RDONLY);
+            if (m_fd < 0)
+            {
+                logErr(MIXLOG << "open " << fileName << " failed, err: " << strerror(errno));
+                return -1;
+            }
+
+            struct stat st;
+            if (fstat(m_fd, &st) != 0 || st.st_size < static_cast<off_t>(FLV_HEADER_SIZE + HLS_PREV_TAGSIZE_LEN))
+            {
+                logErr(MIXLOG << "invalid flv file: " << fileName);
+                destroy();
+                return -1;
+            }
+            m_size = st.st_size;
+
+            void *addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                logErr(MIXLOG << "mmap " << fileName << " failed, err: " << strerror(errno));
+                m_size = 0;
+                destroy();
+                return -1;
+            }
+            m_base = reinterpret_cast<const unsigned char *>(addr);
+            madvise(addr, m_size, MADV_SEQUENTIAL);
+
+            if (memcmp(m_base, "FLV", 3) != 0)
+            {
+                logErr(MIXLOG << "not flv file: " << fileName);
+                destroy();
+                return -1;
+            }
+
+            m_firstTagOffset = readU32(m_base + 5) + HLS_PREV_TAGSIZE_LEN;
+            m_offset = m_firstTagOffset;
+
+            TagView first;
+            if (parseTag(m_firstTagOffset, first))
+            {
+                m_firstTimestamp = first.m_timestamp;
+                m_lastTimestamp = first.m_timestamp;
+            }
+
+            if (buildIdx)
+            {
+                buildIndex();
+            }
+
+            logInfo(MIXLOG << "file: " << fileName << ", size: " << m_size
+                << ", keyframes: " << m_keyFrames.size()
+                << ", duration: " << getDuration()
+                << ", interval: " << m_frameInterval);
+
+            return 0;
+        }
+
+        void FlvMmapReader::destroy()
+        {
+            if (m_base != nullptr)
+            {
+                munmap(const_cast<unsigned char *>(m_base), m_size);
+                m_base = nullptr;
+            }
+            if (m_fd >= 0)
+            {
+                close(m_fd);
+                m_fd = -1;
+            }
+            m_size = 0;
+            m_offset = 0;
+            m_indexed = false;
+            m_loopOffset = 0;
+            m_lastOutTimestamp = 0;
+            m_paceBaseMs = -1;
+            m_keyFrames.clear();
+        }
+
+        bool FlvMmapReader::parseTag(uint64_t offset, TagView &view) const
+        {
+            if (offset + TAG_HEADER_SIZE > m_size)
+            {
+                return false;
+            }
+
+            const unsigned char *p = m_base + offset;
+            uint32_t dataSize = readU24(p + 1);
+            if (offset + TAG_HEADER_SIZE + dataSize > m_size)
+            {
+                logWarn(MIXLOG << "truncated tag at " << offset << ", file: " << m_fileName);
+                return false;
+            }
+
+            view.m_data = p;
+            view.m_size = TAG_HEADER_SIZE + dataSize;
+            view.m_tagType = static_cast<TagType>(p[0] & 0x1f);
+            view.m_timestamp = readU24(p + 4) | (static_cast<uint32_t>(p[7]) << 24);
+            view.m_keyFrame = false;
+            view.m_sequenceHeader = false;
+            view.m_offset = offset;
+
+            const unsigned char *body = p + TAG_HEADER_SIZE;
+            if (view.m_tagType == TAG_TYPE_VIDEO && dataSize >= 2)
+            {
+                view.m_keyFrame = ((body[0] & 0xf0) >> 4) == FRAME_TYPE_KEY;
+                view.m_sequenceHeader = body[1] == AVC_PACKET_TYPE_SEQUENCE_HEADER;
+            }
+            else if (view.m_tagType == TAG_TYPE_AUDIO && dataSize >= 2)
+            {
+                view.m_sequenceHeader = ((body[0] & 0xf0) >> 4) == AUDIO_FORMAT_AAC
+                    && body[1] == AAC_PACKET_TYPE_AAC_SEQUENCE_HEADER;
+            }
+
+            return true;
+        }
+
+        void FlvMmapReader::buildIndex()
+        {
+            m_keyFrames.clear();
+
+            uint64_t offset = m_firstTagOffset;
+            uint32_t videoCount = 0;
+            uint32_t firstVideoTs = 0;
+            uint32_t lastVideoTs = 0;
+            TagView view;
+            while (parseTag(offset, view))
+            {
+                m_lastTimestamp = std::max(m_lastTimestamp, view.m_timestamp);
+                if (view.m_tagType == TAG_TYPE_VIDEO && !view.m_sequenceHeader)
+                {
+                    if (videoCount == 0)
+                    {
+                        firstVideoTs = view.m_timestamp;
+                    }
+                    lastVideoTs = view.m_timestamp;
+                    ++videoCount;
+
+                    if (view.m_keyFrame)
+                    {
+                        KeyFrameEntry entry;
+                        entry.m_timestamp = view.m_timestamp;
+                        entry.m_offset = offset;
+                        m_keyFrames.push_back(entry);
+                    }
+                }
+                offset += view.m_size + HLS_PREV_TAGSIZE_LEN;
+            }
+
+            if (videoCount > 1 && lastVideoTs > firstVideoTs)
+            {
+                m_frameInterval = (lastVideoTs - firstVideoTs) / (videoCount - 1);
+                if (m_frameInterval == 0)
+                {
+                    m_frameInterval = 1;
+                }
+            }
+
+            m_indexed = true;
+        }
+
+        void FlvMmapReader::pace(uint32_t timestamp)
+        {
+            int64_t now = clockGetNowMs();
+            if (m_paceBaseMs < 0 || timestamp < m_paceBaseTimestamp)
+            {
+                m_paceBaseMs = now;
+                m_paceBaseTimestamp = timestamp;
+                return;
+            }
+
+            int64_t due = m_paceBaseMs + (timestamp - m_paceBaseTimestamp);
+            int64_t wait = due - now;
+            if (wait > MAX_PACE_SLEEP_MS)
+            {
+                logWarn(MIXLOG << "timestamp jump, file: " << m_fileName
+                    << ", ts: " << timestamp << ", wait: " << wait);
+                m_paceBaseMs = now;
+                m_paceBaseTimestamp = timestamp;
+                return;
+            }
+            if (wait > 0)
+            {
+                sleepms(static_cast<int>(wait));
+            }
+        }
+
+        bool FlvMmapReader::next(TagView &view)
+        {
+            if (m_base == nullptr)
+            {
+                return false;
+            }
+
+            if (!parseTag(m_offset, view))
+            {
+                if (!m_loop || m_offset == m_firstTagOffset)
+                {
+                    return false;
+                }
+                rewind();
+                if (!parseTag(m_offset, view))
+                {
+                    return false;
+                }
+            }
+
+            m_offset += view.m_size + HLS_PREV_TAGSIZE_LEN;
+            if (!m_indexed)
+            {
+                m_lastTimestamp = std::max(m_lastTimestamp, view.m_timestamp);
+            }
+
+            view.m_timestamp += m_loopOffset;
+            if (view.m_tagType != TAG_TYPE_SCRIPT)
+            {
+                m_lastOutTimestamp = std::max(m_lastOutTimestamp, view.m_timestamp);
+            }
+
+            if (m_realtime)
+            {
+                pace(view.m_timestamp);
+            }
+
+            return true;
+        }
+
+        int FlvMmapReader::seek(uint32_t timestamp)
+        {
+            if (!m_indexed || m_keyFrames.empty())
+            {
+                logErr(MIXLOG << "seek without keyframe index, file: " << m_fileName);
+                return -1;
+            }
+
+            auto iter = std::upper_bound(m_keyFrames.begin(), m_keyFrames.end(), timestamp,
+                [](uint32_t ts, const KeyFrameEntry &entry) { return ts < entry.m_timestamp; });
+            if (iter != m_keyFrames.begin())
+            {
+                --iter;
+            }
+
+            m_offset = iter->m_offset;
+            // keep output timestamps increasing across the jump
+            if (m_lastOutTimestamp != 0)
+            {
+                m_loopOffset = m_lastOutTimestamp + m_frameInterval - iter->m_timestamp;
+            }
+
+            logInfo(MIXLOG << "seek file: " << m_fileName << " to " << timestamp
+                << ", keyframe ts: " << iter->m_timestamp << ", offset: " << m_offset);
+            return 0;
+        }
+
+        void FlvMmapReader::rewind()
+        {
+            m_offset = m_firstTagOffset;
+            if (m_lastOutTimestamp != 0)
+            {
+                m_loopOffset = m_lastOutTimestamp + m_frameInterval - m_firstTimestamp;
+            }
+        }
+
+    } // namespace flv
+} // namespace hercules
@@ -0,0 +1,116 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "FlvHelper.h"
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace hercules
+{
+
+    namespace flv
+    {
+        // non-owning view of one tag inside the mapped file,
+        // m_data points to the tag header, m_size includes TAG_HEADER_SIZE
+        struct TagView
+        {
+            const unsigned char *m_data;
+            uint32_t m_size;
+            flvhelper::TagType m_tagType;
+            uint32_t m_timestamp;    // tag timestamp, shifted by loop offset
+            bool m_keyFrame;
+            bool m_sequenceHeader;
+            uint64_t m_offset;       // offset of tag header in file
+
+            TagView() : m_data(nullptr), m_size(0), m_tagType(flvhelper::TAG_TYPE_SCRIPT),
+                        m_timestamp(0), m_keyFrame(false), m_sequenceHeader(false), m_offset(0)
+            {
+            }
+
+            const unsigned char *body() const { return m_data + flvhelper::TAG_HEADER_SIZE; }
+            uint32_t bodySize() const { return m_size - flvhelper::TAG_HEADER_SIZE; }
+        };
+
+        class FlvMmapReader
+        {
+        public:
+            struct KeyFrameEntry
+            {
+                uint32_t m_timestamp;
+                uint64_t m_offset;
+            };
+
+            FlvMmapReader();
+            ~FlvMmapReader();
+
+            int init(const std::string &fileName, bool buildIndex = true);
+            void destroy();
+
+            bool next(TagView &view);
+
+            // seek to the last keyframe at or before timestamp, needs index
+            int seek(uint32_t timestamp);
+            void rewind();
+
+            void setLoop(bool loop) { m_loop = loop; }
+            bool isLoop() const { return m_loop; }
+
+            // sleep in next() until tag timestamp is due on wall clock
+            void setRealtime(bool realtime) { m_realtime = realtime; }
+            bool isRealtime() const { return m_realtime; }
+
+            bool isEof() const { return m_offset >= m_size && !m_loop; }
+            uint32_t getDuration() const { return m_lastTimestamp - m_firstTimestamp; }
+            const std::vector<KeyFrameEntry> &getKeyFrameIndex() const { return m_keyFrames; }
+            const std::string &getFileName() const { return m_fileName; }
+
+        private:
+            bool parseTag(uint64_t offset, TagView &view) const;
+            void buildIndex();
+            void pace(uint32_t timestamp);
+
+        private:
+            FlvMmapReader(const FlvMmapReader &);
+            FlvMmapReader &operator=(const FlvMmapReader &);
+
+        private:
+            std::string m_fileName;
+            int m_fd;
+            const unsigned char *m_base;
+            uint64_t m_size;
+            uint64_t m_firstTagOffset;
+            uint64_t m_offset;
+
+            bool m_loop;
+            bool m_realtime;
+            bool m_indexed;
+
+            uint32_t m_firstTimestamp;
+            uint32_t m_lastTimestamp;
+            uint32_t m_loopOffset;
+            uint32_t m_lastOutTimestamp;
+            uint32_t m_frameInterval;
+
+            int64_t m_paceBaseMs;
+            uint32_t m_paceBaseTimestamp;
+
+            std::vector<KeyFrameEntry> m_keyFrames;
+        };
+    } // namespace flv
+} // namespace hercules
@@ -0,0 +1,259 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "JitterBuffer.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace hercules
+{
+
+    JitterBuffer::JitterBuffer()
+        : m_underrunTarget(kJitterUnderrunTarget)
+        , m_offsetValid(false)
+        , m_offsetMs(0)
+        , m_lastUpdateMs(0)
+    {
+    }
+
+    void JitterBuffer::setUnderrunTarget(double ratio)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_underrunTarget = std::min(std::max(ratio, 0.0), 0.5);
+    }
+
+    bool JitterBuffer::onArrival(MediaType type, TIMESTAMP dts, uint64_t nowMs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        Track &tr = track(type);
+        int64_t transit = static_cast<int64_t>(nowMs) - static_cast<int64_t>(dts);
+
+        if (tr.m_started && !tr.m_minTransits.empty())
+        {
+            int64_t minTransit = tr.m_minTransits.front().second;
+            if (transit - minTransit > kJitterResetMs || minTransit - transit > kJitterResetMs)
+            {
+                logInfo(MIXLOG << "jitter buffer reset, " << MediaType2Str(type)
+                    << " dts: " << dts << ", transit: " << transit << ", min transit: " << minTransit);
+                resetTrack(m_audio);
+                resetTrack(m_video);
+                m_offsetValid = false;
+                ++m_stats.m_resets;
+            }
+        }
+
+        if (tr.m_lastPlayedDts >= 0 && static_cast<int64_t>(dts) <= tr.m_lastPlayedDts)
+        {
+            ++m_stats.m_lateDrops;
+            return false;
+        }
+
+        if (tr.m_lastArrivalDts >= 0 && static_cast<int64_t>(dts) > tr.m_lastArrivalDts)
+        {
+            tr.m_frameMs = std::min(static_cast<int64_t>(dts) - tr.m_lastArrivalDts, kJitterMaxFrameMs);
+        }
+        tr.m_lastArrivalDts = dts;
+        tr.m_started = true;
+
+        tr.m_transits.push_back(std::make_pair(nowMs, transit));
+        while (!tr.m_transits.empty() && nowMs - tr.m_transits.front().first > kJitterWindowMs)
+        {
+            tr.m_transits.pop_front();
+        }
+        while (!tr.m_minTransits.empty() && tr.m_minTransits.back().second >= transit)
+        {
+            tr.m_minTransits.pop_back();
+        }
+        tr.m_minTransits.push_back(std::make_pair(nowMs, transit));
+        while (nowMs - tr.m_minTransits.front().first > kJitterWindowMs)
+        {
+            tr.m_minTransits.pop_front();
+        }
+
+        return true;
+    }
+
+    void JitterBuffer::resetTrack(Track &track)
+    {
+        int64_t frameMs = track.m_frameMs;
+        track = Track();
+        track.m_frameMs = frameMs;
+    }
+
+    void JitterBuffer::update(uint64_t nowMs)
+    {
+        if (m_offsetValid && nowMs - m_lastUpdateMs < kJitterUpdateMs)
+        {
+            return;
+        }
+
+        bool found = false;
+        int64_t target = 0;
+        int64_t delay = 0;
+        std::vector<int64_t> spread;
+        for (Track *tr : {&m_audio, &m_video})
+        {
+            if (tr->m_transits.empty())
+            {
+                continue;
+            }
+
+            int64_t minTransit = tr->m_minTransits.front().second;
+
+            spread.clear();
+            for (const auto &sample : tr->m_transits)
+            {
+                spread.push_back(sample.second - minTransit);
+            }
+            size_t rank = static_cast<size_t>((1.0 - m_underrunTarget) * (spread.size() - 1));
+            std::nth_element(spread.begin(), spread.begin() + rank, spread.end());
+            tr->m_jitterMs = spread[rank];
+
+            int64_t trackDelay = std::min(tr->m_jitterMs + kJitterMarginMs, kJitterMaxDelayMs);
+            int64_t trackTarget = minTransit + trackDelay;
+            if (!found || trackTarget > target)
+            {
+                target = trackTarget;
+                delay = trackDelay;
+            }
+            found = true;
+        }
+
+        if (!found)
+        {
+            return;
+        }
+
+        if (!m_offsetValid || target >= m_offsetMs)
+        {
+            m_offsetMs = target;
+        }
+        else
+        {
+            int64_t shrink = static_cast<int64_t>((nowMs - m_lastUpdateMs) * kJitterShrinkPerMs);
+            m_offsetMs = std::max(target, m_offsetMs - std::max<int64_t>(shrink, 1));
+        }
+        m_offsetValid = true;
+        m_lastUpdateMs = nowMs;
+
+        m_stats.m_delayMs = static_cast<uint32_t>(std::max<int64_t>(delay + m_offsetMs - target, 0));
+        m_stats.m_jitterMs = static_cast<uint32_t>(std::max(m_audio.m_jitterMs, m_video.m_jitterMs));
+    }
+
+    bool JitterBuffer::playoutDts(uint64_t nowMs, int64_t &dts)
+    {
+        update(nowMs);
+        if (!m_offsetValid)
+        {
+            return false;
+        }
+        dts = static_cast<int64_t>(nowMs) - m_offsetMs;
+        return true;
+    }
+
+    void JitterBuffer::countUnderrun(Track &track, int64_t playDts)
+    {
+        if (track.m_lastPlayedDts < 0)
+        {
+            return;
+        }
+        int64_t from = std::max(track.m_lastPlayedDts, track.m_underrunDts);
+        if (playDts - from >= track.m_frameMs)
+        {
+            int64_t missed = (playDts - from) / track.m_frameMs;
+            m_stats.m_underruns += missed;
+            track.m_underrunDts = from + missed * track.m_frameMs;
+        }
+    }
+
+    void JitterBuffer::played(Track &track, const MediaFrame &frame)
+    {
+        track.m_lastPlayedDts = frame.getDts();
+        ++m_stats.m_played;
+    }
+
+    bool JitterBuffer::popAudio(Queue<MediaFrame> &queue, MediaFrame &frame, uint64_t nowMs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        int64_t playDts = 0;
+        if (!playoutDts(nowMs, playDts))
+        {
+            return false;
+        }
+
+        // only a frame whose whole slot has passed is late, frames that are merely
+        // due play in order so a burst is not cut down to its last frame
+        MediaFrame head;
+        uint32_t newest = 0;
+        while (queue.peek(head, newest) && static_cast<int64_t>(head.getDts()) + m_audio.m_frameMs < playDts)
+        {
+            ++m_stats.m_lateDrops;
+            queue.pop(head, 0);
+        }
+        if (!queue.peek(head, newest))
+        {
+            countUnderrun(m_audio, playDts);
+            return false;
+        }
+        if (static_cast<int64_t>(head.getDts()) > playDts)
+        {
+            return false;
+        }
+
+        queue.pop(frame, 0);
+        played(m_audio, frame);
+        return true;
+    }
+
+    bool JitterBuffer::popVideo(Queue<MediaFrame> &queue, MediaFrame &frame, uint64_t nowMs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        int64_t playDts = 0;
+        if (!playoutDts(nowMs, playDts))
+        {
+            return false;
+        }
+
+        // frames skipped here were only outpaced by the output frame rate
+        bool popped = false;
+        MediaFrame head;
+        uint32_t newest = 0;
+        while (queue.peek(head, newest) && static_cast<int64_t>(head.getDts()) <= playDts)
+        {
+            queue.pop(frame, 0);
+            popped = true;
+        }
+
+        if (!popped)
+        {
+            if (queue.empty())
+            {
+                countUnderrun(m_video, playDts);
+            }
+            return false;
+        }
+
+        played(m_video, frame);
+        return true;
+    }
+
+    JitterStats JitterBuffer::getStats()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+} // namespace hercules
@@ -0,0 +1,134 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "MediaFrame.h"
+#include "Queue.h"
+
+#include <stdint.h>
+
+#include <deque>
+#include <initializer_list>
+#include <mutex>
+#include <utility>
+
+namespace hercules
+{
+
+    // arrivals older than this no longer count towards the delay estimate
+    constexpr uint64_t kJitterWindowMs = 10000;
+    constexpr uint64_t kJitterUpdateMs = 100;
+    // share of frames allowed to miss their playout slot
+    constexpr double kJitterUnderrunTarget = 0.01;
+    constexpr int64_t kJitterMarginMs = 5;
+    constexpr int64_t kJitterMaxDelayMs = 1000;
+    // delay is given back at 20ms per second, growing it is immediate
+    constexpr double kJitterShrinkPerMs = 0.02;
+    // a transit this far off the window minimum means the sender reset its timestamps
+    constexpr int64_t kJitterResetMs = 10000;
+    constexpr int64_t kJitterDefaultFrameMs = 20;
+    constexpr int64_t kJitterMaxFrameMs = 200;
+
+    struct JitterStats
+    {
+        JitterStats()
+            : m_delayMs(0)
+            , m_jitterMs(0)
+            , m_played(0)
+            , m_underruns(0)
+            , m_lateDrops(0)
+            , m_resets(0)
+        {
+        }
+
+        // playout delay on top of the fastest transit seen in the window
+        uint32_t m_delayMs;
+        // arrival jitter quantile the delay was sized from
+        uint32_t m_jitterMs;
+        uint64_t m_played;
+        // playout slots that found no frame
+        uint64_t m_underruns;
+        // frames that arrived or were still queued after their slot passed
+        uint64_t m_lateDrops;
+        uint64_t m_resets;
+    };
+
+    // adaptive playout for one input. Transit (arrival - dts) is tracked per media
+    // type, the playout delay is the smallest that covers the underrun target over
+    // the window, and audio and video share one offset so they stay aligned.
+    class JitterBuffer
+    {
+    public:
+        JitterBuffer();
+
+        void setUnderrunTarget(double ratio);
+
+        // false when the frame is already behind the playout point and must be dropped
+        bool onArrival(MediaType type, TIMESTAMP dts, uint64_t nowMs);
+
+        // the oldest audio frame due now, frames whose whole slot has passed are dropped
+        bool popAudio(Queue<MediaFrame> &queue, MediaFrame &frame, uint64_t nowMs);
+        // the newest video frame due now
+        bool popVideo(Queue<MediaFrame> &queue, MediaFrame &frame, uint64_t nowMs);
+
+        JitterStats getStats();
+
+    private:
+        struct Track
+        {
+            Track()
+                : m_started(false)
+                , m_lastArrivalDts(-1)
+                , m_lastPlayedDts(-1)
+                , m_underrunDts(-1)
+                , m_frameMs(kJitterDefaultFrameMs)
+                , m_jitterMs(0)
+            {
+            }
+
+            bool m_started;
+            // arrival ms, transit ms
+            std::deque<std::pair<uint64_t, int64_t>> m_transits;
+            // increasing transits of m_transits, the front is the window minimum
+            std::deque<std::pair<uint64_t, int64_t>> m_minTransits;
+            int64_t m_lastArrivalDts;
+            int64_t m_lastPlayedDts;
+            // missed slots are counted up to here
+            int64_t m_underrunDts;
+            int64_t m_frameMs;
+            int64_t m_jitterMs;
+        };
+
+        Track &track(MediaType type) { return type == MediaType::VIDEO ? m_video : m_audio; }
+        void resetTrack(Track &track);
+        void update(uint64_t nowMs);
+        bool playoutDts(uint64_t nowMs, int64_t &dts);
+        void countUnderrun(Track &track, int64_t playDts);
+        void played(Track &track, const MediaFrame &frame);
+
+    private:
+        std::mutex m_mutex;
+        double m_underrunTarget;
+        Track m_audio;
+        Track m_video;
+
+        bool m_offsetValid;
+        int64_t m_offsetMs;
+        uint64_t m_lastUpdateMs;
+
+        JitterStats m_stats;
+    };
+
+} // namespace hercules
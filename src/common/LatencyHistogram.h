@@ -0,0 +1,153 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace hercules
+{
+
+    constexpr uint32_t kLatencySubBits = 6;
+    constexpr uint32_t kLatencySubCount = 1 << kLatencySubBits;
+    constexpr uint32_t kLatencyLinearMs = kLatencySubCount * 2;
+    // about 17 minutes, anything longer is clamped
+    constexpr uint32_t kLatencyTopBit = 20;
+    constexpr uint32_t kLatencyMaxMs = (1u << kLatencyTopBit) - 1;
+    constexpr size_t kLatencyBucketNum =
+        kLatencyLinearMs + (kLatencyTopBit - kLatencySubBits - 1) * kLatencySubCount;
+
+    struct LatencySummary
+    {
+        LatencySummary()
+            : m_count(0)
+            , m_p50(0)
+            , m_p90(0)
+            , m_p99(0)
+            , m_max(0)
+        {
+        }
+
+        uint64_t m_count;
+        uint32_t m_p50;
+        uint32_t m_p90;
+        uint32_t m_p99;
+        uint32_t m_max;
+    };
+
+    // log bucketed millisecond histogram in the HDR layout: exact below
+    // kLatencyLinearMs, then 64 sub buckets per power of two, so a reported
+    // value is within 1.6% of the recorded one. Not thread safe.
+    class LatencyHistogram
+    {
+    public:
+        LatencyHistogram() : m_counts(kLatencyBucketNum, 0), m_count(0), m_max(0)
+        {
+        }
+
+        void record(uint32_t ms)
+        {
+            ms = std::min<uint32_t>(ms, kLatencyMaxMs);
+            ++m_counts[index(ms)];
+            ++m_count;
+            m_max = std::max(m_max, ms);
+        }
+
+        uint64_t count() const { return m_count; }
+        uint32_t max() const { return m_max; }
+
+        // highest value equivalent to the bucket holding the percentile, never above max
+        uint32_t percentile(double percent) const
+        {
+            if (m_count == 0)
+            {
+                return 0;
+            }
+
+            uint64_t target = static_cast<uint64_t>(std::ceil(percent / 100.0 * m_count));
+            target = std::max<uint64_t>(target, 1);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kLatencyBucketNum; ++i)
+            {
+                seen += m_counts[i];
+                if (seen >= target)
+                {
+                    return std::min(upper(i), m_max);
+                }
+            }
+            return m_max;
+        }
+
+        LatencySummary summary() const
+        {
+            LatencySummary out;
+            out.m_count = m_count;
+            out.m_p50 = percentile(50.0);
+            out.m_p90 = percentile(90.0);
+            out.m_p99 = percentile(99.0);
+            out.m_max = m_max;
+            return out;
+        }
+
+        void reset()
+        {
+            std::fill(m_counts.begin(), m_counts.end(), 0);
+            m_count = 0;
+            m_max = 0;
+        }
+
+    private:
+        static uint32_t topBit(uint32_t value)
+        {
+            uint32_t bit = 0;
+            while (value >>= 1)
+            {
+                ++bit;
+            }
+            return bit;
+        }
+
+        static size_t index(uint32_t ms)
+        {
+            if (ms < kLatencyLinearMs)
+            {
+                return ms;
+            }
+            uint32_t shift = topBit(ms) - kLatencySubBits;
+            return kLatencyLinearMs + (shift - 1) * kLatencySubCount
+                + ((ms >> shift) - kLatencySubCount);
+        }
+
+        static uint32_t upper(size_t index)
+        {
+            if (index < kLatencyLinearMs)
+            {
+                return static_cast<uint32_t>(index);
+            }
+            size_t offset = index - kLatencyLinearMs;
+            uint32_t shift = static_cast<uint32_t>(offset / kLatencySubCount) + 1;
+            uint32_t sub = static_cast<uint32_t>(offset % kLatencySubCount) + kLatencySubCount;
+            return ((sub + 1) << shift) - 1;
+        }
+
+        std::vector<uint32_t> m_counts;
+        uint64_t m_count;
+        uint32_t m_max;
+    };
+
+} // namespace hercules
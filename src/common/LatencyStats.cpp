@@ -0,0 +1,171 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "LatencyStats.h"
+#include "Log.h"
+
+#include <string>
+#include <utility>
+
+namespace hercules
+{
+
+    using std::string;
+
+    std::string LatencyStage2Str(LatencyStage stage)
+    {
+        switch (stage)
+        {
+        case LatencyStage::RECV_DELIVER:
+            return "recv_deliver";
+        case LatencyStage::DELIVER_DECODE:
+            return "deliver_decode";
+        case LatencyStage::DECODE_MIXED:
+            return "decode_mixed";
+        case LatencyStage::MIXED_ENCODE:
+            return "mixed_encode";
+        case LatencyStage::ENCODE_SEND:
+            return "encode_send";
+        case LatencyStage::END_TO_END:
+            return "end_to_end";
+        default:
+            return "unknown";
+        }
+    }
+
+    void JobLatency::record(const MediaPacket &packet, uint32_t sendMs)
+    {
+        if (packet.isHeaderFrame() || (!packet.isVideo() && !packet.isAudio()))
+        {
+            return;
+        }
+
+        int recvIndex = TimeTraceKey2Index(TimeTraceKey::RECV);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::map<StreamIndex, Histograms> &inputs = packet.isVideo() ? m_video : m_audio;
+        packet.getTimeTrace().forEach([&](const TimeTraceRecord &in)
+        {
+            TimeTraceRecord record = in;
+            record.set(TimeTraceKey::SEND, sendMs);
+            Histograms &histograms = inputs[static_cast<StreamIndex>(record.m_id)];
+
+            // stamps are 32 bit milliseconds, a negative delta is a wrap or a stale stamp
+            for (size_t i = 0; i + 1 < kTimeTraceKeyNum; ++i)
+            {
+                if (!record.has(i) || !record.has(i + 1))
+                {
+                    continue;
+                }
+                int32_t delta = static_cast<int32_t>(record.m_stamps[i + 1] - record.m_stamps[i]);
+                if (delta >= 0)
+                {
+                    histograms.m_stages[i].record(static_cast<uint32_t>(delta));
+                }
+            }
+
+            if (record.has(recvIndex))
+            {
+                int32_t delta = static_cast<int32_t>(sendMs - record.m_stamps[recvIndex]);
+                if (delta >= 0)
+                {
+                    histograms.m_stages[static_cast<size_t>(LatencyStage::END_TO_END)]
+                        .record(static_cast<uint32_t>(delta));
+                }
+            }
+        });
+    }
+
+    StageLatency JobLatency::summarize(const Histograms &histograms)
+    {
+        StageLatency stages;
+        for (size_t i = 0; i < kLatencyStageNum; ++i)
+        {
+            if (histograms.m_stages[i].count() > 0)
+            {
+                stages[LatencyStage2Str(static_cast<LatencyStage>(i))] =
+                    histograms.m_stages[i].summary();
+            }
+        }
+        return stages;
+    }
+
+    std::map<string, InputLatency> JobLatency::getStats()
+    {
+        std::map<string, InputLatency> stats;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const auto &kv : m_video)
+        {
+            stats[StreamRegistry::getInstance()->getName(kv.first)].m_video = summarize(kv.second);
+        }
+        for (const auto &kv : m_audio)
+        {
+            stats[StreamRegistry::getInstance()->getName(kv.first)].m_audio = summarize(kv.second);
+        }
+        return stats;
+    }
+
+    void JobLatency::reset()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_video.clear();
+        m_audio.clear();
+    }
+
+    std::shared_ptr<JobLatency> LatencyStats::get(const string &jobKey)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::shared_ptr<JobLatency> &job = m_jobs[jobKey];
+        if (!job)
+        {
+            job = std::make_shared<JobLatency>();
+        }
+        return job;
+    }
+
+    std::map<string, std::map<string, InputLatency>> LatencyStats::getStats()
+    {
+        std::map<string, std::shared_ptr<JobLatency>> jobs;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            jobs = m_jobs;
+        }
+
+        std::map<string, std::map<string, InputLatency>> stats;
+        for (const auto &kv : jobs)
+        {
+            stats[kv.first] = kv.second->getStats();
+        }
+        return stats;
+    }
+
+    void LatencyStats::reset(const string &jobKey)
+    {
+        logInfo(MIXLOG << "reset latency stats, job: " << (jobKey.empty() ? "all" : jobKey));
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const auto &kv : m_jobs)
+        {
+            if (jobKey.empty() || kv.first == jobKey)
+            {
+                kv.second->reset();
+            }
+        }
+    }
+
+    void LatencyStats::remove(const string &jobKey)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobs.erase(jobKey);
+    }
+
+} // namespace hercules
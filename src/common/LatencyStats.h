@@ -0,0 +1,99 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "MediaPacket.h"
+#include "Singleton.h"
+#include "StreamRegistry.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace hercules
+{
+
+    // deltas between consecutive TimeTraceKey stamps, plus recv to send
+    enum class LatencyStage
+    {
+        RECV_DELIVER = 0,
+        DELIVER_DECODE = 1,
+        DECODE_MIXED = 2,
+        MIXED_ENCODE = 3,
+        ENCODE_SEND = 4,
+        END_TO_END = 5,
+    };
+
+    constexpr size_t kLatencyStageNum = 6;
+
+    std::string LatencyStage2Str(LatencyStage stage);
+
+    // stage name to summary, stages without samples are left out
+    typedef std::map<std::string, LatencySummary> StageLatency;
+
+    struct InputLatency
+    {
+        StageLatency m_video;
+        StageLatency m_audio;
+    };
+
+    // histograms of one job, fed by its publisher as packets leave
+    class JobLatency
+    {
+    public:
+        // sendMs stands in for the SEND stamp, packets are const on the way out
+        void record(const MediaPacket &packet, uint32_t sendMs);
+        // keyed by input stream name
+        std::map<std::string, InputLatency> getStats();
+        void reset();
+
+    private:
+        struct Histograms
+        {
+            LatencyHistogram m_stages[kLatencyStageNum];
+        };
+
+        static StageLatency summarize(const Histograms &histograms);
+
+        std::mutex m_mutex;
+        std::map<StreamIndex, Histograms> m_video;
+        std::map<StreamIndex, Histograms> m_audio;
+    };
+
+    class LatencyStats : public Singleton<LatencyStats>
+    {
+        friend class Singleton<LatencyStats>;
+
+    public:
+        // created on first use, shared by every publisher of the job
+        std::shared_ptr<JobLatency> get(const std::string &jobKey);
+        // job key to input stream name
+        std::map<std::string, std::map<std::string, InputLatency>> getStats();
+        // an empty key resets every job
+        void reset(const std::string &jobKey);
+        void remove(const std::string &jobKey);
+
+    private:
+        LatencyStats() {}
+
+        std::mutex m_mutex;
+        std::map<std::string, std::shared_ptr<JobLatency>> m_jobs;
+    };
+
+} // namespace hercules
@@ -42,21 +42,27 @@ namespace hercules
         logInfo(MIXLOG << "local publisher thread start, stream name:" << getStreamName());
         while (!isStop())
         {
-            sendVideo();
-            sendAudio();
+            MediaPacket packet;
+            bool isVideo = false;
+            if (popPaced(packet, isVideo))
+            {
+                isVideo ? sendVideo(packet) : sendAudio(packet);
+                recordLatency(packet);
+            }
         }
-        logInfo(MIXLOG << "local publisher thread stop, stream name:" << getStreamName());
-    }
 
-    int LocalPublisher::sendAudio()
-    {
         MediaPacket packet;
-
-        if (!getAudioPacket(packet))
+        bool isVideo = false;
+        while (popNext(packet, isVideo))
         {
-            return 0;
+            isVideo ? sendVideo(packet) : sendAudio(packet);
+            recordLatency(packet);
         }
+        logInfo(MIXLOG << "local publisher thread stop, stream name:" << getStreamName());
+    }
 
+    int LocalPublisher::sendAudio(const MediaPacket &packet)
+    {
         AVData data;
         MediaPacket::mediaPacketToFlvWithHeader(packet, data.m_data);
         data.m_pts = packet.getPts();
@@ -72,15 +78,8 @@ namespace hercules
         return 0;
     }
 
-    int LocalPublisher::sendVideo()
+    int LocalPublisher::sendVideo(const MediaPacket &packet)
     {
-        MediaPacket packet;
-
-        if (!getVideoPacket(packet))
-        {
-            return 0;
-        }
-
         logDebug(MIXLOG << "local publisher send video");
         AVData data;
         MediaPacket::mediaPacketToFlvWithHeader(packet, data.m_data);
@@ -95,11 +94,6 @@ namespace hercules
         return 0;
     }
 
-    bool LocalPublisher::getVideoPacket(MediaPacket &tMediaPacket)
-    {
-        return getVideoQueue() ? getVideoQueue()->pop(tMediaPacket, 5) : false;
-    }
-
     void LocalPublisher::pushAudioPacket(const MediaPacket &packet)
     {
         if (getAudioQueue())
@@ -108,9 +102,4 @@ namespace hercules
         }
     }
 
-    bool LocalPublisher::getAudioPacket(MediaPacket &tMediaPacket)
-    {
-        return getAudioQueue() ? getAudioQueue()->pop(tMediaPacket, 5) : false;
-    }
-
 } // namespace hercules
@@ -44,14 +44,12 @@ namespace hercules
 
         ~LocalPublisher();
 
-        bool getVideoPacket(MediaPacket &);
-        bool getAudioPacket(MediaPacket &);
         void pushAudioPacket(const MediaPacket &packet);
 
         void start()
         {
             connect();
-            OneCycleThread::startThread();
+            OneCycleThread::startThread("publish");
         }
 
         void stop()
@@ -68,8 +66,8 @@ namespace hercules
         void threadEntry();
 
         int connect();
-        int sendVideo();
-        int sendAudio();
+        int sendVideo(const MediaPacket &packet);
+        int sendAudio(const MediaPacket &packet);
 
         std::string m_taskId;
     };
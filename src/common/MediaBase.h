@@ -14,12 +14,16 @@
 
 #pragma once
 
+#include "StreamRegistry.h"
+
 #include <stdint.h>
 
 #include <atomic>
 #include <map>
+#include <memory>
 #include <string>
 #include <sstream>
+#include <vector>
 #include <algorithm>
 
 namespace hercules
@@ -152,6 +156,260 @@ namespace hercules
         return "UNKNOWN";
     }
 
+    constexpr size_t kTimeTraceKeyNum = 6;
+    // records kept inline in each frame: its own stream and one merged input
+    constexpr size_t kTimeTraceInline = 2;
+    // room reserved once when a mixed frame spills, a 9 input mix fits without regrowing
+    constexpr size_t kTimeTraceSpillReserve = 16;
+
+    static const TimeTraceKey kTimeTraceKeys[kTimeTraceKeyNum] = {
+        TimeTraceKey::RECV,
+        TimeTraceKey::DELIVER,
+        TimeTraceKey::DECODE,
+        TimeTraceKey::MIXED,
+        TimeTraceKey::ENCODE,
+        TimeTraceKey::SEND,
+    };
+
+    static inline int TimeTraceKey2Index(TimeTraceKey key)
+    {
+        switch (key)
+        {
+        case TimeTraceKey::RECV:
+            return 0;
+        case TimeTraceKey::DELIVER:
+            return 1;
+        case TimeTraceKey::DECODE:
+            return 2;
+        case TimeTraceKey::MIXED:
+            return 3;
+        case TimeTraceKey::ENCODE:
+            return 4;
+        case TimeTraceKey::SEND:
+            return 5;
+        default:
+            return -1;
+        }
+
+        return -1;
+    }
+
+    // stage stamps of one input stream, bit i of m_mask marks m_stamps[i] valid
+    struct TimeTraceRecord
+    {
+        static constexpr uint8_t kTimestampBit = 0x80;
+
+        TimeTraceRecord() : m_id(0), m_timestamp(0), m_mask(0), m_stamps()
+        {
+        }
+
+        void set(TimeTraceKey key, uint32_t stamp)
+        {
+            int index = TimeTraceKey2Index(key);
+            if (index >= 0)
+            {
+                m_stamps[index] = stamp;
+                m_mask |= 1 << index;
+            }
+        }
+
+        bool has(int index) const { return m_mask & (1 << index); }
+
+        void setTimestamp(uint32_t timestamp)
+        {
+            m_timestamp = timestamp;
+            m_mask |= kTimestampBit;
+        }
+
+        bool hasTimestamp() const { return m_mask & kTimestampBit; }
+
+        uint64_t m_id;
+        uint32_t m_timestamp;
+        uint8_t m_mask;
+        uint32_t m_stamps[kTimeTraceKeyNum];
+    };
+
+    typedef std::vector<TimeTraceRecord> TimeTraceRecords;
+
+    // trace of one frame without per stage allocation: the first records (the
+    // frame's own stream, then an input merged by the mixer) are inline and copied
+    // with the frame, the rest spill to a list shared by all copies and written in
+    // place while one copy holds it, a shared list is cloned once before a change;
+    // stamps for every input (encode, send) are kept once at frame level
+    class TimeTrace
+    {
+    public:
+        TimeTrace() : m_size(0), m_frameMask(0), m_frameStamps()
+        {
+        }
+
+        void setTimestamp(uint64_t id, uint32_t timestamp)
+        {
+            find(id)->setTimestamp(timestamp);
+        }
+
+        uint32_t getTimestamp(uint64_t id) const
+        {
+            const TimeTraceRecord *record = lookup(id);
+            return record != nullptr ? record->m_timestamp : 0;
+        }
+
+        void add(uint64_t id, TimeTraceKey key, uint32_t stamp)
+        {
+            find(id)->set(key, stamp);
+        }
+
+        void addAll(TimeTraceKey key, uint32_t stamp)
+        {
+            int index = TimeTraceKey2Index(key);
+            if (index >= 0)
+            {
+                m_frameStamps[index] = stamp;
+                m_frameMask |= 1 << index;
+            }
+        }
+
+        // fold every stage of src under id, src may itself be a mixed frame
+        void merge(uint64_t id, uint32_t timestamp, const TimeTrace &src)
+        {
+            TimeTraceRecord *record = find(id);
+            src.forEach([record](const TimeTraceRecord &in)
+            {
+                for (size_t i = 0; i < kTimeTraceKeyNum; ++i)
+                {
+                    if (in.has(i))
+                    {
+                        record->m_stamps[i] = in.m_stamps[i];
+                        record->m_mask |= 1 << i;
+                    }
+                }
+            });
+            record->setTimestamp(timestamp);
+        }
+
+        // records ordered as added, frame level stamps applied
+        template <class F>
+        void forEach(F f) const
+        {
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                f(apply(m_records[i]));
+            }
+            if (m_spill)
+            {
+                for (const auto &record : *m_spill)
+                {
+                    f(apply(record));
+                }
+            }
+        }
+
+        size_t size() const
+        {
+            return m_size + (m_spill ? m_spill->size() : 0);
+        }
+
+        // copies already sharing the spilled list keep it
+        void clear()
+        {
+            m_size = 0;
+            m_spill.reset();
+            m_frameMask = 0;
+        }
+
+    private:
+        TimeTraceRecord apply(const TimeTraceRecord &record) const
+        {
+            if (m_frameMask == 0)
+            {
+                return record;
+            }
+
+            TimeTraceRecord out = record;
+            for (size_t i = 0; i < kTimeTraceKeyNum; ++i)
+            {
+                if (m_frameMask & (1 << i))
+                {
+                    out.m_stamps[i] = m_frameStamps[i];
+                    out.m_mask |= 1 << i;
+                }
+            }
+            return out;
+        }
+
+        const TimeTraceRecord *lookup(uint64_t id) const
+        {
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                if (m_records[i].m_id == id)
+                {
+                    return &m_records[i];
+                }
+            }
+            if (m_spill)
+            {
+                for (const auto &record : *m_spill)
+                {
+                    if (record.m_id == id)
+                    {
+                        return &record;
+                    }
+                }
+            }
+            return nullptr;
+        }
+
+        TimeTraceRecord *find(uint64_t id)
+        {
+            for (size_t i = 0; i < m_size; ++i)
+            {
+                if (m_records[i].m_id == id)
+                {
+                    return &m_records[i];
+                }
+            }
+
+            if (!m_spill && m_size < kTimeTraceInline)
+            {
+                TimeTraceRecord &record = m_records[m_size++];
+                record = TimeTraceRecord();
+                record.m_id = id;
+                return &record;
+            }
+
+            // other copies may be reading a shared list, only a sole holder writes it
+            if (!m_spill)
+            {
+                m_spill = std::make_shared<TimeTraceRecords>();
+                m_spill->reserve(kTimeTraceSpillReserve);
+            }
+            else if (m_spill.use_count() > 1)
+            {
+                std::shared_ptr<TimeTraceRecords> spill = std::make_shared<TimeTraceRecords>();
+                spill->reserve(std::max(kTimeTraceSpillReserve, m_spill->size() + 1));
+                spill->assign(m_spill->begin(), m_spill->end());
+                m_spill = spill;
+            }
+            for (auto &record : *m_spill)
+            {
+                if (record.m_id == id)
+                {
+                    return &record;
+                }
+            }
+            m_spill->push_back(TimeTraceRecord());
+            m_spill->back().m_id = id;
+            return &m_spill->back();
+        }
+
+    private:
+        size_t m_size;
+        TimeTraceRecord m_records[kTimeTraceInline];
+        std::shared_ptr<TimeTraceRecords> m_spill;
+        uint8_t m_frameMask;
+        uint32_t m_frameStamps[kTimeTraceKeyNum];
+    };
+
     class MediaBase
     {
     public:
@@ -163,6 +421,7 @@ namespace hercules
                       m_globalId(m_globalIncrId.fetch_add(1)),
                       m_frameId(0),
                       m_streamId(0),
+                      m_streamIndex(kInvalidStreamIndex),
                       m_audioSampleRate(0),
                       m_audioChannels(0)
         {
@@ -226,8 +485,13 @@ namespace hercules
         uint64_t getStreamId() const { return m_streamId; }
         void setStreamId(uint64_t id) { m_streamId = id; }
 
-        void setStreamName(const std::string &streamName) { m_streamName = streamName; }
-        std::string getStreamName() const { return m_streamName; }
+        void setStreamName(const std::string &streamName)
+        {
+            m_streamIndex = StreamRegistry::getInstance()->intern(streamName);
+        }
+        std::string getStreamName() const { return StreamRegistry::getInstance()->getName(m_streamIndex); }
+        void setStreamIndex(StreamIndex index) { m_streamIndex = index; }
+        StreamIndex getStreamIndex() const { return m_streamIndex; }
 
         uint32_t getAudioSampleRate() const { return m_audioSampleRate; }
         void setAudioSampleRate(uint32_t rate) { m_audioSampleRate = rate; }
@@ -237,38 +501,48 @@ namespace hercules
 
         void addIdTimestamp(uint64_t id, uint32_t timestamp)
         {
-            m_idTimestamp[id] = timestamp;
+            m_timeTrace.setTimestamp(id, timestamp);
         }
         void setIdTimestamp(const std::map<uint64_t, uint32_t> &idTimestamp)
         {
-            m_idTimestamp = idTimestamp;
+            for (const auto &kv : idTimestamp)
+            {
+                m_timeTrace.setTimestamp(kv.first, kv.second);
+            }
         }
-        std::map<uint64_t, uint32_t> getIdTimestamp() const { return m_idTimestamp; }
-        uint32_t getInIdTimestamp(uint64_t id) const
+        std::map<uint64_t, uint32_t> getIdTimestamp() const
         {
-            auto iter = m_idTimestamp.find(id);
-            if (iter == m_idTimestamp.end())
+            std::map<uint64_t, uint32_t> idTimestamp;
+            m_timeTrace.forEach([&idTimestamp](const TimeTraceRecord &record)
             {
-                return 0;
-            }
-
-            return iter->second;
+                if (record.hasTimestamp())
+                {
+                    idTimestamp[record.m_id] = record.m_timestamp;
+                }
+            });
+            return idTimestamp;
+        }
+        uint32_t getInIdTimestamp(uint64_t id) const
+        {
+            return m_timeTrace.getTimestamp(id);
         }
 
         std::string getIdTimestampStr() const
         {
             std::ostringstream os;
             size_t count = 0;
-            for (const auto &kv : m_idTimestamp)
+            m_timeTrace.forEach([&os, &count](const TimeTraceRecord &record)
             {
-                os << kv.first << ":" << kv.second;
-
-                ++count;
-                if (count != m_idTimestamp.size())
+                if (!record.hasTimestamp())
+                {
+                    return;
+                }
+                if (count++ != 0)
                 {
                     os << "|";
                 }
-            }
+                os << record.m_id << ":" << record.m_timestamp;
+            });
 
             return os.str();
         }
@@ -278,65 +552,89 @@ namespace hercules
 
         void addIdTimeTrace(uint64_t id, const TimeTraceKey &key, uint32_t timestamp)
         {
-            m_idTimeTrace[id][key] = timestamp;
+            m_timeTrace.add(id, key, timestamp);
         }
         void addAllIdTimeTrace(const TimeTraceKey &key, uint32_t timestamp)
         {
-            for (auto &kv : m_idTimeTrace)
-            {
-                kv.second[key] = timestamp;
-            }
+            m_timeTrace.addAll(key, timestamp);
+        }
+        void mergeIdTimeTrace(uint64_t id, uint32_t timestamp, const MediaBase &src)
+        {
+            m_timeTrace.merge(id, timestamp, src.m_timeTrace);
         }
 
+        const TimeTrace &getTimeTrace() const { return m_timeTrace; }
+        void setTimeTrace(const TimeTrace &trace) { m_timeTrace = trace; }
+        void clearTimeTrace() { m_timeTrace.clear(); }
+
         void setIdTimeTrace(const std::map<uint64_t, std::map<TimeTraceKey, uint32_t>> &trace)
         {
-            m_idTimeTrace = trace;
+            for (const auto &kv : trace)
+            {
+                for (const auto &key_time : kv.second)
+                {
+                    m_timeTrace.add(kv.first, key_time.first, key_time.second);
+                }
+            }
         }
         std::map<uint64_t, std::map<TimeTraceKey, uint32_t>> getIdTimeTrace() const
         {
-            return m_idTimeTrace;
+            std::map<uint64_t, std::map<TimeTraceKey, uint32_t>> trace;
+            m_timeTrace.forEach([&trace](const TimeTraceRecord &record)
+            {
+                for (size_t i = 0; i < kTimeTraceKeyNum; ++i)
+                {
+                    if (record.has(i))
+                    {
+                        trace[record.m_id][kTimeTraceKeys[i]] = record.m_stamps[i];
+                    }
+                }
+            });
+            return trace;
         }
 
         std::string getIdTimeTraceStr() const
         {
             std::ostringstream os;
             size_t count = 0;
-            for (const auto &kv : m_idTimeTrace)
+            m_timeTrace.forEach([&os, &count](const TimeTraceRecord &record)
             {
-                os << kv.first << ":(";
+                if (count++ != 0)
+                {
+                    os << "|";
+                }
+                os << record.m_id << ":(";
 
-                size_t subSount = 0;
+                bool first = true;
                 int timeElapse = 0;
                 uint32_t preTime = 0;
-                for (const auto &key_time : kv.second)
+                for (size_t i = 0; i < kTimeTraceKeyNum; ++i)
                 {
-                    os << TimeTraceKey2Str(key_time.first) << "->" << key_time.second;
+                    if (!record.has(i))
+                    {
+                        continue;
+                    }
+
+                    if (!first)
+                    {
+                        os << ",";
+                    }
+                    first = false;
 
-                    ++subSount;
+                    os << TimeTraceKey2Str(kTimeTraceKeys[i]) << "->" << record.m_stamps[i];
 
                     if (preTime != 0)
                     {
-                        int diff = (key_time.second - preTime);
+                        int diff = (record.m_stamps[i] - preTime);
                         timeElapse += diff;
                         os << "(" << diff << ")";
                     }
 
-                    preTime = key_time.second;
-
-                    if (subSount != kv.second.size())
-                    {
-                        os << ",";
-                    }
+                    preTime = record.m_stamps[i];
                 }
 
                 os << "), elapse:" << timeElapse;
-
-                ++count;
-                if (count != m_idTimeTrace.size())
-                {
-                    os << "|";
-                }
-            }
+            });
 
             return os.str();
         }
@@ -370,12 +668,11 @@ namespace hercules
             m_globalId = rhs.m_globalId;
             m_frameId = rhs.m_frameId;
             m_streamId = rhs.m_streamId;
-            m_streamName = rhs.m_streamName;
+            m_streamIndex = rhs.m_streamIndex;
 
             m_audioSampleRate = rhs.m_audioSampleRate;
             m_audioChannels = rhs.m_audioChannels;
-            m_idTimestamp = rhs.m_idTimestamp;
-            m_idTimeTrace = rhs.m_idTimeTrace;
+            m_timeTrace = rhs.m_timeTrace;
             m_idVolume = rhs.m_idVolume;
         }
 
@@ -393,7 +690,7 @@ namespace hercules
                << ", pts: " << m_pts
                << ", frameId: " << m_frameId
                << ", streamId: " << m_streamId
-               << ", streamName: " << m_streamName
+               << ", streamName: " << getStreamName()
                << ", idTimestamp: " << getIdTimestampStr()
                << ", idTimeTrace: " << getIdTimeTraceStr()
                << ", idVolume: " << getIdVolumeStr();
@@ -411,14 +708,13 @@ namespace hercules
         uint64_t m_globalId;
         uint64_t m_frameId;
         uint64_t m_streamId;
-        std::string m_streamName;
+        StreamIndex m_streamIndex;
 
         uint32_t m_audioSampleRate;
         uint8_t m_audioChannels;
         std::map<uint64_t, uint32_t> m_idVolume;
 
-        std::map<uint64_t, uint32_t> m_idTimestamp;
-        std::map<uint64_t, std::map<TimeTraceKey, uint32_t>> m_idTimeTrace;
+        TimeTrace m_timeTrace;
 
         static std::atomic<uint64_t> m_globalIncrId;
     };
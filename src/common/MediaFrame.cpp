@@ -120,6 +120,43 @@ namespace hercules
         }
     }
 
+    bool MediaFrame::makeWritable()
+    {
+        if (m_frame == nullptr || m_frameBuffer != nullptr)
+        {
+            return false;
+        }
+        if (m_ref == nullptr || m_ref->load() <= 1)
+        {
+            return true;
+        }
+
+        AVFrame *frame = av_frame_alloc();
+        frame->format = m_frame->format;
+        frame->width = m_frame->width;
+        frame->height = m_frame->height;
+        frame->nb_samples = m_frame->nb_samples;
+        frame->channels = m_frame->channels;
+        frame->channel_layout = m_frame->channel_layout;
+        frame->sample_rate = m_frame->sample_rate;
+        if (av_frame_get_buffer(frame, 0) < 0 || av_frame_copy(frame, m_frame) < 0)
+        {
+            logErr(MIXLOG << "copy shared frame fail");
+            av_frame_free(&frame);
+            return false;
+        }
+        av_frame_copy_props(frame, m_frame);
+
+        // the other holders keep the old frame and its count
+        unref();
+        m_ref = nullptr;
+        ref();
+        m_frame = frame;
+        m_avframeSize.fetch_add(m_size);
+        m_avframeRefCount.fetch_add(1);
+        return true;
+    }
+
     MediaFrame::MediaFrame(const MediaFrame &rhs)
     {
         if (this == &rhs)
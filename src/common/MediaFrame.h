@@ -45,6 +45,9 @@ namespace hercules
         MediaFrame &operator=(const MediaFrame &rhs);
 
         AVFrame *getAVFrame() { return m_frame; }
+        // copies the avframe when other MediaFrames hold it too, frames fanned out
+        // to several jobs must not be written in place
+        bool makeWritable();
 
         void setAVFrame(AVFrame *frame, uint8_t *frameBuffer = nullptr, uint64_t size = 0)
         {
@@ -16,6 +16,8 @@
 #include "Common.h"
 #include "FlvFile.h"
 
+#include <string.h>
+
 #include <string>
 #include <algorithm>
 
@@ -31,6 +33,17 @@ namespace hercules
 #define FLV_AVC_KEY_FRAME 0x17
 #define FLV_AVC_INTER_FRAME 0x27
 #define AAC_44100_S16_STEREO 0XAF
+// enhanced rtmp: sound format 9 carries a packet type and a fourcc instead
+#define FLV_SOUND_FORMAT_EX_HEADER 9
+#define FLV_AUDIO_PACKET_TYPE_SEQUENCE_START 0
+#define FLV_AUDIO_PACKET_TYPE_CODED_FRAMES 1
+#define FLV_AUDIO_OPUS_HEADER_LEN 5
+#define FLV_AUDIO_AAC_HEADER_LEN 2
+
+    static size_t audioTagHeaderLen(const MediaPacket &packet)
+    {
+        return packet.isOGG_OPUS() ? FLV_AUDIO_OPUS_HEADER_LEN : FLV_AUDIO_AAC_HEADER_LEN;
+    }
 
     std::atomic<uint64_t> MediaPacket::m_avpacketRefCount(0);
 
@@ -335,9 +348,25 @@ namespace hercules
 
             return 0;
         }
+        else if (packet.isAudio() && packet.isOGG_OPUS())
+        {
+            uint8_t audioTagHeader[FLV_AUDIO_OPUS_HEADER_LEN] = {0};
+
+            audioTagHeader[0] = (FLV_SOUND_FORMAT_EX_HEADER << 4)
+                | (packet.isHeaderFrame() ? FLV_AUDIO_PACKET_TYPE_SEQUENCE_START
+                                          : FLV_AUDIO_PACKET_TYPE_CODED_FRAMES);
+            memcpy(audioTagHeader + 1, "Opus", 4);
+
+            flvWithoutHeader.append((const char *)audioTagHeader, sizeof(audioTagHeader));
+
+            // the sequence start carries the OpusHead from the encoder extradata
+            flvWithoutHeader.append((const char *)packet.data(), packet.size());
+
+            return 0;
+        }
         else if (packet.isAudio())
         {
-            uint8_t audioTagHeader[2] = {0};
+            uint8_t audioTagHeader[FLV_AUDIO_AAC_HEADER_LEN] = {0};
 
             audioTagHeader[0] = AAC_44100_S16_STEREO;
 
@@ -390,7 +419,7 @@ namespace hercules
             flvHeader[0] = TagType::TAG_TYPE_AUDIO;
 
             // size
-            uint32_t size = packet.size() + 2;
+            uint32_t size = packet.size() + audioTagHeaderLen(packet);
             flvHeader[1] = (size & 0x00FF0000) >> 16;
             flvHeader[2] = (size & 0x0000FF00) >> 8;
             flvHeader[3] = size & 0xFF;
@@ -19,10 +19,10 @@
 #include "Util.h"
 #include "Log.h"
 
-#include <sys/prctl.h>
 #include <atomic>
 #include <thread>
 #include <string>
+#include <vector>
 
 namespace hercules
 {
@@ -56,17 +56,16 @@ namespace hercules
 
             m_stop = false;
             m_name = name;
-#if 0
-        if (!name.empty())
-        {
-            prctl(PR_SET_NAME, (uint64_t)(name.c_str()), 0, 0);
-        }
-#endif
+            m_group = ThreadManager::currentGroup();
+            m_cpus = ThreadManager::getInstance()->acquireGroup(m_group);
 
             logInfo(MIXLOG << "start thread: " << name);
-            m_thread = new std::thread(&OneCycleThread::threadEntry, this);
+            {
+                std::unique_lock<std::mutex> spawnGuard(ThreadManager::spawnMutex());
+                m_thread = new std::thread(&OneCycleThread::run, this);
+            }
             m_id = m_thread->get_id();
-            ThreadManager::getInstance()->registerThread(m_id, name, m_thread);
+            ThreadManager::getInstance()->registerThread(m_id, name, m_thread, m_group);
         }
 
         virtual void stopThread()
@@ -95,6 +94,16 @@ namespace hercules
         bool isStop() { return m_stop; }
 
         virtual void threadEntry() = 0;
+
+        void run()
+        {
+            ThreadManager::currentGroup() = m_group;
+            ThreadManager::placeCurrentThread(m_name, m_cpus);
+            ThreadManager::getInstance()->attachCurrentThread(m_name, m_group);
+            threadEntry();
+            ThreadManager::getInstance()->retireCurrentThread();
+        }
+
         void checkTimer()
         {
             uint64_t nowMs = getNowMs();
@@ -114,6 +123,8 @@ namespace hercules
     protected:
         std::atomic<bool> m_stop;
         std::string m_name;
+        std::string m_group;
+        std::vector<int> m_cpus;
         std::thread *m_thread;
         std::thread::id m_id;
 
@@ -0,0 +1,194 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "Util.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace hercules
+{
+
+    constexpr uint32_t kPaceDefaultMaxBurstMs = 100;
+    constexpr double kPaceDefaultCatchUpRate = 1.5;
+    // a head this far from the cursor is a timestamp jump, not a backlog
+    constexpr int64_t kPaceResetMs = 5000;
+
+    struct PacerStats
+    {
+        PacerStats()
+            : m_released(0)
+            , m_held(0)
+            , m_totalDelayMs(0)
+            , m_maxDelayMs(0)
+            , m_lagMs(0)
+            , m_resets(0)
+        {
+        }
+
+        uint64_t m_released;
+        uint64_t m_held;
+        uint64_t m_totalDelayMs;
+        uint32_t m_maxDelayMs;
+        uint32_t m_lagMs;
+        uint64_t m_resets;
+    };
+
+    // releases packets by dts against the monotonic clock. The cursor never runs ahead
+    // of the newest queued dts, so a stalled encoder does not earn credit for a burst;
+    // packets up to maxBurstMs past the cursor go out at once, anything further behind
+    // drains at catchUpRate times real time.
+    class Pacer
+    {
+    public:
+        Pacer()
+            : m_enabled(true)
+            , m_maxBurstMs(kPaceDefaultMaxBurstMs)
+            , m_catchUpRate(kPaceDefaultCatchUpRate)
+            , m_started(false)
+            , m_cursorDts(0)
+            , m_newestDts(0)
+            , m_lastMs(0)
+            , m_holding(false)
+            , m_holdSinceMs(0)
+        {
+        }
+
+        void configure(bool enabled, uint32_t maxBurstMs, double catchUpRate)
+        {
+            m_enabled = enabled;
+            m_maxBurstMs = maxBurstMs;
+            m_catchUpRate = std::max(catchUpRate, 1.0);
+        }
+
+        bool enabled() const { return m_enabled; }
+
+        void advance(uint64_t nowMs, bool hasQueued, uint32_t newestQueuedDts)
+        {
+            uint64_t elapsedMs = m_lastMs == 0 ? 0 : nowMs - m_lastMs;
+            m_lastMs = nowMs;
+
+            if (!m_started)
+            {
+                return;
+            }
+
+            if (hasQueued && newestQueuedDts > m_newestDts)
+            {
+                m_newestDts = newestQueuedDts;
+            }
+
+            double rate = m_newestDts > m_cursorDts + m_maxBurstMs ? m_catchUpRate : 1.0;
+            m_cursorDts = std::min(m_cursorDts + elapsedMs * rate, static_cast<double>(m_newestDts));
+        }
+
+        bool ready(uint32_t headDts, uint32_t newestQueuedDts, uint64_t nowMs)
+        {
+            if (!m_enabled)
+            {
+                return true;
+            }
+
+            int64_t gap = static_cast<int64_t>(headDts) - static_cast<int64_t>(m_cursorDts);
+            if (!m_started || gap > kPaceResetMs || gap < -kPaceResetMs)
+            {
+                if (m_started)
+                {
+                    std::lock_guard<std::mutex> lock(m_statsMutex);
+                    ++m_stats.m_resets;
+                }
+                m_started = true;
+                m_cursorDts = headDts;
+                m_newestDts = newestQueuedDts;
+            }
+
+            if (headDts <= m_cursorDts + m_maxBurstMs)
+            {
+                return true;
+            }
+
+            if (!m_holding)
+            {
+                m_holding = true;
+                m_holdSinceMs = nowMs;
+            }
+            return false;
+        }
+
+        // ms until headDts becomes ready at the current rate, 0 when it already is
+        uint32_t releaseInMs(uint32_t headDts) const
+        {
+            double dueDts = static_cast<double>(headDts) - m_maxBurstMs;
+            if (!m_enabled || !m_started || dueDts <= m_cursorDts)
+            {
+                return 0;
+            }
+            double rate = m_newestDts > m_cursorDts + m_maxBurstMs ? m_catchUpRate : 1.0;
+            return static_cast<uint32_t>(std::ceil((dueDts - m_cursorDts) / rate));
+        }
+
+        void onRelease(uint64_t nowMs)
+        {
+            uint32_t delayMs = m_holding ? static_cast<uint32_t>(nowMs - m_holdSinceMs) : 0;
+
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            ++m_stats.m_released;
+            if (m_holding)
+            {
+                ++m_stats.m_held;
+                m_stats.m_totalDelayMs += delayMs;
+                m_stats.m_maxDelayMs = std::max(m_stats.m_maxDelayMs, delayMs);
+            }
+            m_stats.m_lagMs = m_newestDts > m_cursorDts ? static_cast<uint32_t>(m_newestDts - m_cursorDts) : 0;
+            m_holding = false;
+        }
+
+        PacerStats stats()
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            return m_stats;
+        }
+
+        // m_maxDelayMs covers the interval since the previous call
+        PacerStats takeStats()
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            PacerStats stats = m_stats;
+            m_stats.m_maxDelayMs = 0;
+            return stats;
+        }
+
+    private:
+        bool m_enabled;
+        uint32_t m_maxBurstMs;
+        double m_catchUpRate;
+
+        bool m_started;
+        double m_cursorDts;
+        uint32_t m_newestDts;
+        uint64_t m_lastMs;
+
+        bool m_holding;
+        uint64_t m_holdSinceMs;
+
+        std::mutex m_statsMutex;
+        PacerStats m_stats;
+    };
+
+} // namespace hercules
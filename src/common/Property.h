@@ -14,8 +14,11 @@
 
 #pragma once
 
+#include "StreamRegistry.h"
+
 #include <stdint.h>
 
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <set>
@@ -64,6 +67,7 @@ namespace hercules
             : m_uid(UINT64_MAX)
             , m_appid(UINT32_MAX)
             , m_streamName("")
+            , m_streamIndex(kInvalidStreamIndex)
             , m_propertyMutex()
         {
         }
@@ -73,6 +77,7 @@ namespace hercules
             m_uid = rhs.m_uid;
             m_appid = rhs.m_appid;
             m_streamName = rhs.m_streamName;
+            m_streamIndex = rhs.m_streamIndex.load();
             m_traceInfos = rhs.m_traceInfos;
         }
 
@@ -113,6 +118,7 @@ namespace hercules
         {
             std::unique_lock<std::mutex> lockGuard(m_propertyMutex);
             m_streamName = streamName;
+            m_streamIndex = StreamRegistry::getInstance()->intern(streamName);
         }
 
         std::string getStreamName()
@@ -121,6 +127,9 @@ namespace hercules
             return m_streamName;
         }
 
+        // lock free, for the per frame path
+        StreamIndex getStreamIndex() const { return m_streamIndex; }
+
         void addTraceInfo(const TraceInfo &traceInfo)
         {
             std::unique_lock<std::mutex> lockGuard(m_propertyMutex);
@@ -180,6 +189,7 @@ namespace hercules
         uint64_t m_uid;
         uint32_t m_appid;
         std::string m_streamName;
+        std::atomic<StreamIndex> m_streamIndex;
 
         std::mutex m_propertyMutex;
         std::set<TraceInfo> m_traceInfos;
@@ -16,6 +16,7 @@
 
 #include "RtmpPublisher.h"
 #include "LocalPublisher.h"
+#include "FanoutPublisher.h"
 #include "Log.h"
 
 #include <memory>
@@ -38,6 +39,14 @@ namespace hercules
             {
                 m_publisher = std::shared_ptr<Streamer>(new LocalPublisher(taskId));
             }
+            else if (type == "fanout")
+            {
+                m_publisher = std::shared_ptr<Streamer>(new FanoutPublisher(taskId));
+            }
+            if (m_publisher)
+            {
+                m_publisher->setLatencyKey(taskId);
+            }
         }
 
         ~PublisherWrapper()
@@ -55,6 +64,17 @@ namespace hercules
             m_publisher->setParam(name, url, uid);
         }
 
+        int addDestination(const std::string &type, const std::string &url)
+        {
+            FanoutPublisher *fanout = dynamic_cast<FanoutPublisher *>(m_publisher.get());
+            if (fanout == nullptr)
+            {
+                logErr(MIXLOG << "error, publisher is not fanout, can not add destination: " << type);
+                return -1;
+            }
+            return fanout->addDestination(type, url);
+        }
+
         void setOpt(const StreamOpt &opt)
         {
             m_publisher->setOpt(opt);
@@ -41,6 +41,41 @@ namespace hercules
     constexpr size_t kMaxRollbackCount = 60 * 1;
     constexpr int DEFAULT_QUEUE_TIMEOUT_MS = 5;
 
+    // lets one consumer sleep on several queues: read seq() before looking at
+    // them, then waitFor(seq) returns once anything was pushed since
+    class QueueSignal
+    {
+    public:
+        QueueSignal() : m_seq(0) {}
+
+        void notify()
+        {
+            {
+                std::unique_lock<std::mutex> lockGuard(m_mutex);
+                ++m_seq;
+            }
+            m_cond.notify_all();
+        }
+
+        uint64_t seq()
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            return m_seq;
+        }
+
+        bool waitFor(uint64_t seq, uint32_t timeoutMs)
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            return m_cond.wait_for(lockGuard, std::chrono::milliseconds(timeoutMs),
+                                   [this, seq]() { return m_seq != seq; });
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        uint64_t m_seq;
+    };
+
     template <typename VAL>
     class Queue : public Property
     {
@@ -53,6 +88,8 @@ namespace hercules
             , m_preTimeRef(0)
             , m_maxSize(kDefaultMaxSize)
             , m_pushRollBackCount(0)
+            , m_signal(nullptr)
+            , m_popSignal(nullptr)
         {
         }
 
@@ -86,6 +123,18 @@ namespace hercules
             m_maxSize = max;
         }
 
+        // also notified on every successful push
+        void setSignal(QueueSignal *signal)
+        {
+            m_signal = signal;
+        }
+
+        // notified whenever entries leave the queue
+        void setPopSignal(QueueSignal *signal)
+        {
+            m_popSignal = signal;
+        }
+
         size_t size()
         {
             std::unique_lock<std::mutex> lockGuard(m_mutex);
@@ -98,6 +147,40 @@ namespace hercules
             return m_queue.empty();
         }
 
+        // distance between the newest and the oldest key, ms for dts keyed queues
+        uint32_t span()
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            if (m_queue.empty())
+            {
+                return 0;
+            }
+            return m_queue.rbegin()->first - m_queue.begin()->first;
+        }
+
+        // drops queued entries, keys pushed afterwards must still not roll back
+        size_t clear()
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            size_t dropped = m_queue.size();
+            m_queue.clear();
+            notifyPop();
+            return dropped;
+        }
+
+        // copies the oldest entry and reports the newest key without popping
+        bool peek(VAL &val, uint32_t &newestKey)
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            if (m_queue.empty())
+            {
+                return false;
+            }
+            val = m_queue.begin()->second;
+            newestKey = m_queue.rbegin()->first;
+            return true;
+        }
+
         bool push(uint32_t key, const VAL &val)
         {
             std::unique_lock<std::mutex> lockGuard(m_mutex);
@@ -159,6 +242,10 @@ namespace hercules
             }
 
             m_cond.notify_one();
+            if (m_signal != nullptr)
+            {
+                m_signal->notify();
+            }
 
             return true;
         }
@@ -192,12 +279,13 @@ namespace hercules
                 return false;
             }
 
-            m_prePopTimeMs = getNowMs();
+            m_prePopTimeMs = getClockMs();
             val = m_queue.begin()->second;
 
             assert(!m_queue.empty());
 
             m_queue.erase(m_queue.begin());
+            notifyPop();
 
             return true;
         }
@@ -216,7 +304,7 @@ namespace hercules
                 return false;
             }
 
-            m_prePopTimeMs = getNowMs();
+            m_prePopTimeMs = getClockMs();
 
             int index = n;
             if (index >= m_queue.size())
@@ -239,13 +327,14 @@ namespace hercules
             assert(!m_queue.empty());
 
             m_queue.erase(--iter.base(), m_queue.end());
+            notifyPop();
 
             return true;
         }
 
         bool pop_by_given_time_ref(uint32_t timeRef, VAL &val)
         {
-            uint32_t now_ms = getNowMs();
+            uint32_t now_ms = getClockMs();
 
             std::unique_lock<std::mutex> lockGuard(m_mutex);
 
@@ -271,6 +360,7 @@ namespace hercules
             }
 
             chooseFrame(fixedTime, val);
+            notifyPop();
 
             m_prePopTimeMs = now_ms;
             m_preTimeRef = timeRef;
@@ -319,6 +409,14 @@ namespace hercules
         }
 
     private:
+        void notifyPop()
+        {
+            if (m_popSignal != nullptr)
+            {
+                m_popSignal->notify();
+            }
+        }
+
         void incrPushAll();
         void incrPushFailed();
         void incrPushSuccess();
@@ -342,6 +440,8 @@ namespace hercules
         size_t m_maxSize;
 
         uint32_t m_pushRollBackCount;
+        QueueSignal *m_signal;
+        QueueSignal *m_popSignal;
 
         uint32_t m_maxKey;
 
@@ -18,7 +18,9 @@
 #include "MediaPacket.h"
 #include "MediaFrame.h"
 #include "Log.h"
+#include "Util.h"
 
+#include <algorithm>
 #include <string>
 
 namespace hercules
@@ -29,15 +31,11 @@ namespace hercules
 
     constexpr int FLV_AUDIO_TYPE = 8;
     constexpr int FLV_VIDEO_TYPE = 9;
-    constexpr int QUEUE_TIMEOUT_MS = 5;
+    constexpr int RECONNECT_POLL_MS = 10;
 
     int RtmpPublisher::connect()
     {
-        if (m_srsRtmpContext)
-        {
-            srs_rtmp_destroy(m_srsRtmpContext);
-            m_srsRtmpContext = nullptr;
-        }
+        disconnect();
 
         logInfo(MIXLOG << "rtmp url: " << m_url);
 
@@ -90,51 +88,85 @@ namespace hercules
         logInfo(MIXLOG << "~RtmpPublisher");
     }
 
+    void RtmpPublisher::disconnect()
+    {
+        if (m_srsRtmpContext)
+        {
+            srs_rtmp_destroy(m_srsRtmpContext);
+            m_srsRtmpContext = nullptr;
+        }
+    }
+
+    void RtmpPublisher::waitReconnect(int delayMs)
+    {
+        for (int waited = 0; waited < delayMs && !m_stop; waited += RECONNECT_POLL_MS)
+        {
+            sleepms(RECONNECT_POLL_MS);
+        }
+    }
+
     void RtmpPublisher::threadEntry()
     {
         logInfo(MIXLOG << "RtmpPublisher thread start, streamName: " << getStreamName());
+        int retryMs = kRtmpReconnectMinMs;
         while (!m_stop)
         {
-            while (m_srsRtmpContext == nullptr)
+            if (m_srsRtmpContext == nullptr)
             {
-                connect();
-                continue;
+                if (connect() != 0)
+                {
+                    logWarn(MIXLOG << "rtmp reconnect in " << retryMs << "ms, url: " << m_url);
+                    waitReconnect(retryMs);
+                    retryMs = std::min(retryMs * 2, kRtmpReconnectMaxMs);
+                    continue;
+                }
+                retryMs = kRtmpReconnectMinMs;
+
+                m_waitKeyFrame = true;
+                if ((m_hasVideoHeader && writePacket(FLV_VIDEO_TYPE, m_videoHeader) != 0)
+                    || (m_hasAudioHeader && writePacket(FLV_AUDIO_TYPE, m_audioHeader) != 0))
+                {
+                    disconnect();
+                    continue;
+                }
             }
 
-            int ret = sendVideo();
-
-            if (ret != 0)
+            MediaPacket packet;
+            bool isVideo = false;
+            if (!popPaced(packet, isVideo))
             {
-                connect();
+                continue;
             }
 
-            ret = sendAudio();
+            if ((isVideo ? sendVideo(packet) : sendAudio(packet)) != 0)
+            {
+                disconnect();
+            }
+        }
 
-            if (ret != 0)
+        // what is still queued at stop is the tail of the stream, an offline render needs it
+        MediaPacket packet;
+        bool isVideo = false;
+        while (m_srsRtmpContext != nullptr && popNext(packet, isVideo))
+        {
+            if ((isVideo ? sendVideo(packet) : sendAudio(packet)) != 0)
             {
-                connect();
+                break;
             }
         }
 
         logInfo(MIXLOG << "RtmpPublisher thread exit, streamName: " << getStreamName());
     }
 
-    int RtmpPublisher::sendAudio()
+    int RtmpPublisher::writePacket(char type, const MediaPacket &packet)
     {
-        MediaPacket packet;
-
-        if (!getAudioPacket(packet))
-        {
-            return 0;
-        }
-
         string flv;
         MediaPacket::mediaPacketToFlvWithoutHeader(packet, flv);
 
         char *rtmpPacket = reinterpret_cast<char *>(malloc(flv.size()));
         memcpy(rtmpPacket, flv.data(), flv.size());
         int ret = srs_rtmp_write_packet(
-            m_srsRtmpContext, FLV_AUDIO_TYPE, packet.getDts(), rtmpPacket, flv.size());
+            m_srsRtmpContext, type, packet.getDts(), rtmpPacket, flv.size());
 
         if (ret != 0)
         {
@@ -142,44 +174,41 @@ namespace hercules
         }
         else
         {
-            logDebug(MIXLOG << "send audio success, " << packet.print());
+            logDebug(MIXLOG << "send success, " << packet.print());
+            recordLatency(packet);
         }
 
         return ret;
     }
 
-    int RtmpPublisher::sendVideo()
+    int RtmpPublisher::sendAudio(const MediaPacket &packet)
     {
-        MediaPacket packet;
-
-        if (!getVideoPacket(packet))
+        if (packet.isHeaderFrame())
         {
-            return 0;
+            m_audioHeader = packet;
+            m_hasAudioHeader = true;
         }
 
-        string flv;
-        MediaPacket::mediaPacketToFlvWithoutHeader(packet, flv);
-
-        char *rtmpPacket = reinterpret_cast<char *>(malloc(flv.size()));
-        memcpy(rtmpPacket, flv.data(), flv.size());
-        int ret = srs_rtmp_write_packet(
-            m_srsRtmpContext, FLV_VIDEO_TYPE, packet.getDts(), rtmpPacket, flv.size());
+        return writePacket(FLV_AUDIO_TYPE, packet);
+    }
 
-        if (ret != 0)
+    int RtmpPublisher::sendVideo(const MediaPacket &packet)
+    {
+        if (packet.isHeaderFrame())
         {
-            logErr(MIXLOG << "error, send rtmp packet failed");
+            m_videoHeader = packet;
+            m_hasVideoHeader = true;
         }
-        else
+        else if (m_waitKeyFrame)
         {
-            logDebug(MIXLOG << "send video success, " << packet.print());
+            if (!packet.isIFrame())
+            {
+                return 0;
+            }
+            m_waitKeyFrame = false;
         }
 
-        return ret;
-    }
-
-    bool RtmpPublisher::getVideoPacket(MediaPacket &tMediaPacket)
-    {
-        return getVideoQueue() ? getVideoQueue()->pop(tMediaPacket, QUEUE_TIMEOUT_MS) : false;
+        return writePacket(FLV_VIDEO_TYPE, packet);
     }
 
     void RtmpPublisher::pushAudioPacket(const MediaPacket &packet)
@@ -190,9 +219,4 @@ namespace hercules
         }
     }
 
-    bool RtmpPublisher::getAudioPacket(MediaPacket &tMediaPacket)
-    {
-        return getAudioQueue() ? getAudioQueue()->pop(tMediaPacket, QUEUE_TIMEOUT_MS) : false;
-    }
-
 } // namespace hercules
@@ -34,23 +34,30 @@ namespace hercules
     class MediaPacket;
     class MediaFrame;
 
+    // a failed connect is retried after this, doubling up to the max
+    constexpr int kRtmpReconnectMinMs = 500;
+    constexpr int kRtmpReconnectMaxMs = 8000;
+
     class RtmpPublisher : public OneCycleThread, public Streamer
     {
     public:
-        RtmpPublisher() : OneCycleThread(), m_srsRtmpContext(nullptr)
+        RtmpPublisher()
+            : OneCycleThread()
+            , m_srsRtmpContext(nullptr)
+            , m_hasVideoHeader(false)
+            , m_hasAudioHeader(false)
+            , m_waitKeyFrame(false)
         {
         }
 
         ~RtmpPublisher();
 
-        bool getVideoPacket(MediaPacket &);
-        bool getAudioPacket(MediaPacket &);
         void pushAudioPacket(const MediaPacket &packet);
 
+        // connects on the publish thread, so a dead url does not block the caller
         void start()
         {
-            connect();
-            OneCycleThread::startThread();
+            OneCycleThread::startThread("publish");
         }
 
         void stop()
@@ -67,11 +74,21 @@ namespace hercules
         void threadEntry();
 
         int connect();
-        int sendVideo();
-        int sendAudio();
+        void disconnect();
+        void waitReconnect(int delayMs);
+        int sendVideo(const MediaPacket &packet);
+        int sendAudio(const MediaPacket &packet);
+        int writePacket(char type, const MediaPacket &packet);
 
     private:
         srs_rtmp_t m_srsRtmpContext;
+
+        // sent again after a reconnect, the new session starts from a keyframe
+        MediaPacket m_videoHeader;
+        MediaPacket m_audioHeader;
+        bool m_hasVideoHeader;
+        bool m_hasAudioHeader;
+        bool m_waitKeyFrame;
     };
 
 } // namespace hercules
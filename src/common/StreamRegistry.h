@@ -0,0 +1,208 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "Singleton.h"
+#include "Util.h"
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hercules
+{
+
+    typedef uint32_t StreamIndex;
+    constexpr StreamIndex kInvalidStreamIndex = UINT32_MAX;
+
+    // a released index is handed out again only after this, so packets still queued
+    // under the old name have drained
+    constexpr uint64_t kStreamIndexReuseMs = 60 * 1000;
+
+    // process wide stream name -> dense index, packet and frame paths carry only
+    // the index. lookups read an immutable snapshot without locking, a new name
+    // copies it under the writer lock. names a job acquires are released with the
+    // job and reclaimed once no job holds them; names only ever interned stay
+    class StreamRegistry : public Singleton<StreamRegistry>
+    {
+        friend class Singleton<StreamRegistry>;
+
+    private:
+        struct Names
+        {
+            std::unordered_map<std::string, StreamIndex> m_indexes;
+            std::vector<std::string> m_names;
+        };
+
+        StreamRegistry() : m_names(std::make_shared<Names>()) {}
+        ~StreamRegistry() {}
+
+    public:
+        StreamIndex intern(const std::string &name)
+        {
+            StreamIndex index = lookup(name);
+            if (index != kInvalidStreamIndex)
+            {
+                return index;
+            }
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            return add(name);
+        }
+
+        // interns name and holds it until the matching release
+        StreamIndex acquire(const std::string &name)
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            StreamIndex index = add(name);
+            ++m_refs[index];
+            return index;
+        }
+
+        void release(StreamIndex index)
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            if (index >= m_refs.size() || m_refs[index] == 0 || --m_refs[index] > 0)
+            {
+                return;
+            }
+
+            std::shared_ptr<Names> names = std::make_shared<Names>(*snapshot());
+            names->m_indexes.erase(names->m_names[index]);
+            names->m_names[index].clear();
+            std::atomic_store(&m_names, std::shared_ptr<const Names>(names));
+            m_free.push_back(std::make_pair(index, getNowMs()));
+        }
+
+        // for logs and json only, never per packet
+        std::string getName(StreamIndex index)
+        {
+            std::shared_ptr<const Names> names = snapshot();
+            return index < names->m_names.size() ? names->m_names[index] : "";
+        }
+
+        size_t size()
+        {
+            return snapshot()->m_indexes.size();
+        }
+
+    private:
+        std::shared_ptr<const Names> snapshot() const { return std::atomic_load(&m_names); }
+
+        StreamIndex lookup(const std::string &name) const
+        {
+            std::shared_ptr<const Names> names = snapshot();
+            auto iter = names->m_indexes.find(name);
+            return iter != names->m_indexes.end() ? iter->second : kInvalidStreamIndex;
+        }
+
+        // under m_mutex
+        StreamIndex add(const std::string &name)
+        {
+            StreamIndex index = lookup(name);
+            if (index != kInvalidStreamIndex)
+            {
+                return index;
+            }
+
+            std::shared_ptr<Names> names = std::make_shared<Names>(*snapshot());
+            if (!m_free.empty() && m_free.front().second + kStreamIndexReuseMs <= getNowMs())
+            {
+                index = m_free.front().first;
+                m_free.pop_front();
+                names->m_names[index] = name;
+            }
+            else
+            {
+                index = static_cast<StreamIndex>(names->m_names.size());
+                names->m_names.push_back(name);
+                m_refs.push_back(0);
+            }
+            names->m_indexes[name] = index;
+            std::atomic_store(&m_names, std::shared_ptr<const Names>(names));
+            return index;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::shared_ptr<const Names> m_names;
+        // under m_mutex
+        std::vector<uint32_t> m_refs;
+        std::deque<std::pair<StreamIndex, uint64_t>> m_free;
+    };
+
+    // a job only has a handful of inputs, a flat array beats a tree here
+    template <class T>
+    class FlatStreamMap
+    {
+    public:
+        typedef std::vector<std::pair<StreamIndex, T>> container_type;
+        typedef typename container_type::iterator iterator;
+        typedef typename container_type::const_iterator const_iterator;
+
+        T *find(StreamIndex index)
+        {
+            for (auto &kv : m_items)
+            {
+                if (kv.first == index)
+                {
+                    return &kv.second;
+                }
+            }
+            return nullptr;
+        }
+
+        T &operator[](StreamIndex index)
+        {
+            T *item = find(index);
+            if (item != nullptr)
+            {
+                return *item;
+            }
+            m_items.push_back(std::make_pair(index, T()));
+            return m_items.back().second;
+        }
+
+        void erase(StreamIndex index)
+        {
+            for (auto iter = m_items.begin(); iter != m_items.end(); ++iter)
+            {
+                if (iter->first == index)
+                {
+                    m_items.erase(iter);
+                    return;
+                }
+            }
+        }
+
+        iterator begin() { return m_items.begin(); }
+        iterator end() { return m_items.end(); }
+        const_iterator begin() const { return m_items.begin(); }
+        const_iterator end() const { return m_items.end(); }
+
+        size_t size() const { return m_items.size(); }
+        bool empty() const { return m_items.empty(); }
+        void clear() { m_items.clear(); }
+
+    private:
+        container_type m_items;
+    };
+
+} // namespace hercules
@@ -22,15 +22,22 @@
 #include "CycleCounterStat.h"
 #include "SubscribeContext.h"
 #include "Log.h"
+#include "Pacer.h"
+#include "LatencyStats.h"
 
+#include <algorithm>
 #include <utility>
 #include <map>
+#include <memory>
 #include <string>
 
 namespace hercules
 {
 
     constexpr int SIZE_8K = 8 * 1024;
+    // upper bound of one wait, how long a stop may go unnoticed
+    constexpr uint32_t kPublishWaitMs = 100;
+    constexpr uint64_t kPaceReportMs = 10000;
 
     struct StreamOpt
     {
@@ -40,7 +47,9 @@ namespace hercules
             , m_publishDataStream(false)
             , m_fixUid(true)
             , m_phonyUid(0)
-            , m_smooth(true)
+            , m_smooth(false)
+            , m_maxBurstMs(kPaceDefaultMaxBurstMs)
+            , m_catchUpRate(kPaceDefaultCatchUpRate)
         {
         }
 
@@ -50,19 +59,24 @@ namespace hercules
         bool m_fixUid;
         uint64_t m_phonyUid;
         bool m_smooth;
+        // only used when m_smooth is set
+        uint32_t m_maxBurstMs;
+        double m_catchUpRate;
 
         std::string toString() const
         {
             char buf[SIZE_8K];
             int ret = snprintf(buf, sizeof(buf),
                                "publish_video=%d, publish_audio=%d, publish_data_stream=%d,"
-                               " fixUid=%d, phonyUid=%lu, smooth=%d",
+                               " fixUid=%d, phonyUid=%lu, smooth=%d, max_burst_ms=%u, catch_up_rate=%.2f",
                                m_publishVideo,
                                m_publishAudio,
                                m_publishDataStream,
                                m_fixUid,
                                m_phonyUid,
-                               m_smooth);
+                               m_smooth,
+                               m_maxBurstMs,
+                               m_catchUpRate);
 
             return std::string(buf, ret);
         }
@@ -87,7 +101,10 @@ namespace hercules
                 , CodecType::AAC)
             , m_audioFpsStat()
             , m_videoFpsStat()
+            , m_pacerReportMs(0)
         {
+            m_videoQueue.setSignal(&m_queueSignal);
+            m_audioQueue.setSignal(&m_queueSignal);
         }
 
         virtual ~Streamer()
@@ -101,7 +118,11 @@ namespace hercules
             /* m_audioQueue = &audioQueue; */
         }
 
-        void setOpt(const StreamOpt &opt) { m_opt = opt; }
+        void setOpt(const StreamOpt &opt)
+        {
+            m_opt = opt;
+            m_pacer.configure(opt.m_smooth, opt.m_maxBurstMs, opt.m_catchUpRate);
+        }
         StreamOpt getOpt() const { return m_opt; }
 
         virtual void setParam(const std::string &streamname,
@@ -127,6 +148,12 @@ namespace hercules
             m_audioCodec = getAudioCodec(channels, sampleRate, kbps, codec);
         }
 
+        // packets sent from here on feed the latency histograms of jobKey
+        virtual void setLatencyKey(const std::string &jobKey)
+        {
+            m_latency = LatencyStats::getInstance()->get(jobKey);
+        }
+
         virtual void start() = 0;
         virtual void stop() = 0;
         virtual void join() = 0;
@@ -181,9 +208,74 @@ namespace hercules
 
         virtual void checkStatus(uint64_t counter) {}
 
+        // oldest packet of either queue in dts order, the pacer is not consulted
+        bool popNext(MediaPacket &packet, bool &isVideo)
+        {
+            MediaPacket video;
+            MediaPacket audio;
+            uint32_t newest = 0;
+            bool hasVideo = m_videoQueue.peek(video, newest);
+            bool hasAudio = m_audioQueue.peek(audio, newest);
+            if (!hasVideo && !hasAudio)
+            {
+                return false;
+            }
+            isVideo = hasVideo && (!hasAudio || video.getDts() <= audio.getDts());
+            return (isVideo ? m_videoQueue : m_audioQueue).pop(packet, 0);
+        }
+
+        // next packet of either queue in dts order, held back by the pacer when smooth
+        // is on; blocks until a push or the pacer's release time and returns false
+        // when nothing may be sent yet
+        bool popPaced(MediaPacket &packet, bool &isVideo)
+        {
+            uint64_t seq = m_queueSignal.seq();
+            MediaPacket video;
+            MediaPacket audio;
+            uint32_t videoNewest = 0;
+            uint32_t audioNewest = 0;
+            bool hasVideo = m_videoQueue.peek(video, videoNewest);
+            bool hasAudio = m_audioQueue.peek(audio, audioNewest);
+
+            uint64_t nowMs = clockGetNowMs();
+            uint32_t newest = std::max(hasVideo ? videoNewest : 0, hasAudio ? audioNewest : 0);
+            m_pacer.advance(nowMs, hasVideo || hasAudio, newest);
+            reportPacer(nowMs);
+
+            if (!hasVideo && !hasAudio)
+            {
+                m_queueSignal.waitFor(seq, kPublishWaitMs);
+                return false;
+            }
+
+            isVideo = hasVideo && (!hasAudio || video.getDts() <= audio.getDts());
+            const MediaPacket &head = isVideo ? video : audio;
+            if (!head.isHeaderFrame() && !m_pacer.ready(head.getDts(), newest, nowMs))
+            {
+                uint32_t waitMs = std::min(m_pacer.releaseInMs(head.getDts()), kPublishWaitMs);
+                m_queueSignal.waitFor(seq, std::max<uint32_t>(waitMs, 1));
+                return false;
+            }
+
+            Queue<MediaPacket> &queue = isVideo ? m_videoQueue : m_audioQueue;
+            if (!queue.pop(packet, 0))
+            {
+                return false;
+            }
+            m_pacer.onRelease(nowMs);
+            return true;
+        }
+
+        PacerStats getPacerStats() { return m_pacer.stats(); }
+
     protected:
+        // for consumers that pop the queues themselves instead of popPaced
+        uint64_t queueSeq() { return m_queueSignal.seq(); }
+        void waitQueued(uint64_t seq, uint32_t timeoutMs) { m_queueSignal.waitFor(seq, timeoutMs); }
+
         std::string m_url;
 
+        QueueSignal m_queueSignal;
         Queue<MediaPacket> m_videoQueue;
         Queue<MediaPacket> m_audioQueue;
 
@@ -202,6 +294,36 @@ namespace hercules
 
         StreamOpt m_opt;
         uint32_t m_maxSeiSize;
+
+        // called once a packet is on the wire
+        void recordLatency(const MediaPacket &packet)
+        {
+            if (m_latency)
+            {
+                m_latency->record(packet, getNowMs32());
+            }
+        }
+
+    private:
+        void reportPacer(uint64_t nowMs)
+        {
+            if (!m_pacer.enabled() || nowMs - m_pacerReportMs < kPaceReportMs)
+            {
+                return;
+            }
+            m_pacerReportMs = nowMs;
+
+            PacerStats stats = m_pacer.takeStats();
+            logInfo(MIXLOG << "pacer, stream name: " << getStreamName()
+                << ", released: " << stats.m_released << ", held: " << stats.m_held
+                << ", avg delay ms: " << (stats.m_held == 0 ? 0 : stats.m_totalDelayMs / stats.m_held)
+                << ", max delay ms: " << stats.m_maxDelayMs << ", lag ms: " << stats.m_lagMs
+                << ", resets: " << stats.m_resets);
+        }
+
+        Pacer m_pacer;
+        uint64_t m_pacerReportMs;
+        std::shared_ptr<JobLatency> m_latency;
     };
 
 } // namespace hercules
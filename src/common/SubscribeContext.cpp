@@ -39,6 +39,11 @@ namespace hercules
     {
         if (m_videoFrameQueue)
         {
+            if (m_jitterBuffer && !m_jitterBuffer->onArrival(MediaType::VIDEO, frame.getDts(), getNowMs()))
+            {
+                return;
+            }
+
             m_videoFrameQueue->push(frame.getDts(), frame);
         }
     }
@@ -56,10 +61,65 @@ namespace hercules
         if (m_audioFrameQueue)
         {
             logDebug(MIXLOG);
+            if (m_jitterBuffer && !m_jitterBuffer->onArrival(MediaType::AUDIO, frame.getDts(), getNowMs()))
+            {
+                return;
+            }
             m_audioFrameQueue->push(frame.getDts(), frame);
         }
     }
 
+    void SubscribeContext::setJitterBuffer(bool enable)
+    {
+        if (!enable)
+        {
+            m_jitterBuffer.reset();
+        }
+        else if (!m_jitterBuffer)
+        {
+            m_jitterBuffer = make_shared<JitterBuffer>();
+        }
+    }
+
+    void SubscribeContext::setJitterTarget(double underrunRatio)
+    {
+        if (m_jitterBuffer)
+        {
+            m_jitterBuffer->setUnderrunTarget(underrunRatio);
+        }
+    }
+
+    JitterStats SubscribeContext::getJitterStats() const
+    {
+        return m_jitterBuffer ? m_jitterBuffer->getStats() : JitterStats();
+    }
+
+    bool SubscribeContext::popAudioFrame(MediaFrame &frame)
+    {
+        if (!m_audioFrameQueue)
+        {
+            return false;
+        }
+        if (m_jitterBuffer)
+        {
+            return m_jitterBuffer->popAudio(*m_audioFrameQueue, frame, getNowMs());
+        }
+        return m_audioFrameQueue->pop(frame, 0);
+    }
+
+    bool SubscribeContext::popVideoFrame(MediaFrame &frame, uint32_t timeRef)
+    {
+        if (!m_videoFrameQueue)
+        {
+            return false;
+        }
+        if (m_jitterBuffer)
+        {
+            return m_jitterBuffer->popVideo(*m_videoFrameQueue, frame, getNowMs());
+        }
+        return m_videoFrameQueue->pop_by_given_time_ref(timeRef, frame);
+    }
+
     void SubscribeContext::subscribeVideoPacket()
     {
         if (m_videoPacketQueue)
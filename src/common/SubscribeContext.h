@@ -17,6 +17,7 @@
 #include "MediaPacket.h"
 #include "MediaFrame.h"
 #include "Queue.h"
+#include "JitterBuffer.h"
 
 #include <memory>
 #include <string>
@@ -56,6 +57,7 @@ namespace hercules
             m_audioPacketQueue = rhs.m_audioPacketQueue;
             m_videoFrameQueue = rhs.m_videoFrameQueue;
             m_audioFrameQueue = rhs.m_audioFrameQueue;
+            m_jitterBuffer = rhs.m_jitterBuffer;
             m_streamName = rhs.m_streamName;
             m_audioCnt = rhs.m_audioCnt;
             m_videoCnt = rhs.m_videoCnt;
@@ -90,6 +92,17 @@ namespace hercules
             return m_audioFrameQueue.get();
         }
 
+        // playout through an adaptive jitter buffer instead of plain queue pops,
+        // set up before any frame is pushed
+        void setJitterBuffer(bool enable);
+        void setJitterTarget(double underrunRatio);
+        JitterStats getJitterStats() const;
+
+        // the audio frame due for playout
+        bool popAudioFrame(MediaFrame &frame);
+        // the newest video frame due for playout, timeRef is only used without a jitter buffer
+        bool popVideoFrame(MediaFrame &frame, uint32_t timeRef);
+
         void pushVideoPacket(MediaPacket &packet);
         void pushVideoFrame(MediaFrame &frame);
         void pushAudioPacket(MediaPacket &packet);
@@ -100,6 +113,7 @@ namespace hercules
         packetQueuePtr m_audioPacketQueue;
         frameQueuePtr m_videoFrameQueue;
         frameQueuePtr m_audioFrameQueue;
+        std::shared_ptr<JitterBuffer> m_jitterBuffer;
 
         std::string m_streamName;
         uint32_t m_audioCnt;
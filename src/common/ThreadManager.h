@@ -18,36 +18,319 @@
 #include "Common.h"
 #include "Log.h"
 
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iterator>
 #include <map>
+#include <set>
+#include <sstream>
 #include <thread>
 #include <mutex>
 #include <utility>
 #include <string>
+#include <vector>
 
 namespace hercules
 {
 
+    // cores given to each job when placement is on
+    constexpr int kThreadPlacementCores = 4;
+    // groups of threads serving several jobs, followed by what they serve; never pinned
+    constexpr const char *kSharedGroupPrefix = "shared:";
+    constexpr int kCpuSampleIntervalMs = 1000;
+
+    struct ThreadInfo
+    {
+        ThreadInfo() : m_thread(nullptr)
+        {
+        }
+        ThreadInfo(const std::string &name, std::thread *t, const std::string &group)
+            : m_name(name), m_thread(t), m_group(group)
+        {
+        }
+        std::string m_name;
+        std::thread *m_thread;
+        std::string m_group;
+    };
+
+    struct NumaNode
+    {
+        NumaNode() : m_id(0), m_groups(0), m_nextCpu(0)
+        {
+        }
+        int m_id;
+        std::vector<int> m_cpus;
+        int m_groups;
+        size_t m_nextCpu;
+    };
+
+    // threads of one job share a core set on one numa node
+    struct ThreadGroup
+    {
+        ThreadGroup() : m_node(-1), m_threads(0)
+        {
+        }
+        int m_node;
+        std::vector<int> m_cpus;
+        int m_threads;
+    };
+
+    // one kernel task of this process, its cpu counts towards m_group/m_stage
+    // from m_baseNs on, earlier cpu went to whatever it was attributed to before
+    struct CpuThread
+    {
+        CpuThread() : m_stage("other"), m_startTime(0), m_addedNs(0), m_lastNs(0), m_baseNs(0), m_retired(false)
+        {
+        }
+        std::string m_group;
+        std::string m_stage;
+        uint64_t m_startTime;   // field 22 of stat, tells a reused tid apart
+        uint64_t m_addedNs;     // monotonic time the entry was made
+        uint64_t m_lastNs;
+        uint64_t m_baseNs;
+        bool m_retired;
+    };
+
+    // one task as read from /proc by the sampler
+    struct TaskSample
+    {
+        pid_t m_tid;
+        uint64_t m_cpuNs;
+        uint64_t m_startTime;
+    };
+
+    struct CpuStat
+    {
+        CpuStat() : m_retiredNs(0), m_prevNs(0), m_percent(0)
+        {
+        }
+        uint64_t m_retiredNs;   // cpu of exited threads
+        uint64_t m_prevNs;      // total at the previous sample
+        double m_percent;
+    };
+
+    // job -> stage -> cpu percent of one core
+    typedef std::map<std::string, std::map<std::string, double>> CpuUsage;
+
     class ThreadManager : public Singleton<ThreadManager>
     {
         friend class Singleton<ThreadManager>;
 
     private:
-        ThreadManager()
+        ThreadManager() : m_placement(false), m_coresPerGroup(kThreadPlacementCores),
+                          m_lastSampleNs(0), m_samples(0), m_samplerStop(false)
         {
+            loadTopology();
+            m_sampler = std::thread(&ThreadManager::samplerEntry, this);
         }
 
         ~ThreadManager()
         {
+            {
+                std::unique_lock<std::mutex> lockGuard(m_cpuMutex);
+                m_samplerStop = true;
+            }
+            m_samplerCond.notify_all();
+            m_sampler.join();
         }
 
     public:
-        void registerThread(std::thread::id id, const std::string &name, std::thread *t)
+        // group of the calling thread, inherited by the threads it starts
+        static std::string &currentGroup()
+        {
+            static thread_local std::string group;
+            return group;
+        }
+
+        void setPlacement(bool enable, int coresPerGroup = kThreadPlacementCores)
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            m_placement = enable;
+            m_coresPerGroup = coresPerGroup > 0 ? coresPerGroup : kThreadPlacementCores;
+            logInfo(MIXLOG << "thread placement: " << enable << ", cores per group: " << m_coresPerGroup);
+        }
+
+        // returns the cpus a new thread of group runs on, empty for no pinning
+        std::vector<int> acquireGroup(const std::string &group)
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            if (group.empty() || group.compare(0, strlen(kSharedGroupPrefix), kSharedGroupPrefix) == 0)
+            {
+                return std::vector<int>();
+            }
+
+            ThreadGroup &threadGroup = m_groups[group];
+            if (threadGroup.m_threads++ == 0 && m_placement)
+            {
+                assignGroup(group, threadGroup);
+            }
+            return threadGroup.m_cpus;
+        }
+
+        // runs on the new thread itself
+        static void placeCurrentThread(const std::string &name, const std::vector<int> &cpus)
+        {
+            if (!name.empty())
+            {
+                // kernel keeps 15 chars
+                prctl(PR_SET_NAME, name.substr(0, 15).c_str(), 0, 0, 0);
+            }
+
+            if (!cpus.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (int cpu : cpus)
+                {
+                    CPU_SET(cpu, &set);
+                }
+                if (sched_setaffinity(0, sizeof(set), &set) != 0)
+                {
+                    logWarn(MIXLOG << "set affinity failed, thread: " << name);
+                }
+            }
+        }
+
+        void registerThread(std::thread::id id, const std::string &name, std::thread *t,
+                            const std::string &group = "")
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+
+            m_threads[id] = ThreadInfo(name, t, group);
+
+            logInfo(MIXLOG << "register thread: " << name << ", group: " << group);
+        }
+
+        // held by every path of this process that starts threads, so the threads
+        // appearing while a ThreadSpawnScope holds it were started by that scope
+        static std::mutex &spawnMutex()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        static pid_t currentTid()
+        {
+            return static_cast<pid_t>(syscall(SYS_gettid));
+        }
+
+        // tids of every thread of this process
+        static std::vector<pid_t> listTasks()
+        {
+            std::vector<pid_t> tids;
+            DIR *dir = opendir("/proc/self/task");
+            if (dir == nullptr)
+            {
+                return tids;
+            }
+            struct dirent *entry = nullptr;
+            while ((entry = readdir(dir)) != nullptr)
+            {
+                if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9')
+                {
+                    tids.push_back(static_cast<pid_t>(atoi(entry->d_name)));
+                }
+            }
+            closedir(dir);
+            return tids;
+        }
+
+        // runs on the new thread itself before it does any work
+        void attachCurrentThread(const std::string &name, const std::string &group)
+        {
+            std::unique_lock<std::mutex> lockGuard(m_cpuMutex);
+            assignThread(currentTid(), group, threadStage(name));
+        }
+
+        // called by a thread right before it exits, settles its cpu at ns precision
+        void retireCurrentThread()
+        {
+            std::unique_lock<std::mutex> lockGuard(m_cpuMutex);
+            auto iter = m_cpuThreads.find(currentTid());
+            if (iter == m_cpuThreads.end())
+            {
+                return;
+            }
+            CpuThread &thread = iter->second;
+            struct timespec ts;
+            if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+            {
+                thread.m_lastNs = std::max<uint64_t>(thread.m_lastNs, ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+            }
+            settleThread(thread);
+            // kept until the tid is gone from /proc, so the tail is not counted again
+            thread.m_retired = true;
+        }
+
+        // threads a library started for owner (codec workers), moved with it by moveOwner
+        void adoptThreads(const void *owner, const std::vector<pid_t> &tids,
+                          const std::string &group, const std::string &stage)
+        {
+            std::unique_lock<std::mutex> lockGuard(m_cpuMutex);
+            std::vector<pid_t> &owned = m_owners[owner];
+            for (pid_t tid : tids)
+            {
+                assignThread(tid, group, stage);
+                owned.push_back(tid);
+            }
+        }
+
+        void moveOwner(const void *owner, const std::string &group)
+        {
+            std::unique_lock<std::mutex> lockGuard(m_cpuMutex);
+            auto iter = m_owners.find(owner);
+            if (iter == m_owners.end())
+            {
+                return;
+            }
+            for (pid_t tid : iter->second)
+            {
+                auto found = m_cpuThreads.find(tid);
+                if (found != m_cpuThreads.end() && !found->second.m_retired)
+                {
+                    assignThread(tid, group, found->second.m_stage);
+                }
+            }
+        }
+
+        // as of the last sample, threads outside any job are under ""
+        // cpus threads may be placed on, from the affinity mask at startup
+        int getCpuCount()
         {
             std::unique_lock<std::mutex> lockGuard(m_mutex);
+            size_t count = 0;
+            for (const auto &node : m_nodes)
+            {
+                count += node.m_cpus.size();
+            }
+            return count > 0 ? count : 1;
+        }
 
-            m_threads[id] = make_pair(name, t);
+        // samples taken so far, getCpuUsage changes only when this does
+        uint64_t getSampleCount() const { return m_samples; }
 
-            logInfo(MIXLOG << "register thread: " << name);
+        CpuUsage getCpuUsage()
+        {
+            std::unique_lock<std::mutex> lockGuard(m_cpuMutex);
+            CpuUsage usage;
+            for (const auto &kv : m_cpuStats)
+            {
+                usage[kv.first.first][kv.first.second] = kv.second.m_percent;
+            }
+            return usage;
         }
 
         void unregisterThread(std::thread::id id)
@@ -58,7 +341,8 @@ namespace hercules
             auto iter = m_threads.find(id);
             if (iter != m_threads.end())
             {
-                name = iter->second.first;
+                name = iter->second.m_name;
+                releaseGroup(iter->second.m_group);
             }
 
             logInfo(MIXLOG << "unregister thread: " << name << ", id: " << id);
@@ -70,19 +354,33 @@ namespace hercules
         {
             std::unique_lock<std::mutex> lockGuard(m_mutex);
 
-            logInfo(MIXLOG << "thread num: " << m_threads.size());
+            logInfo(MIXLOG << "thread num: " << m_threads.size()
+                << ", placement: " << m_placement << ", numa nodes: " << m_nodes.size());
 
             std::map<std::string, int> threadStatistic;
 
             for (const auto &kv : m_threads)
             {
-                threadStatistic[kv.second.first]++;
+                threadStatistic[kv.second.m_name]++;
             }
 
             for (const auto &kv : threadStatistic)
             {
                 logInfo(MIXLOG << "thread: " << kv.first << ", count: " << kv.second);
             }
+
+            for (const auto &kv : m_groups)
+            {
+                logInfo(MIXLOG << "group: " << kv.first << ", threads: " << kv.second.m_threads
+                    << ", node: " << kv.second.m_node << ", cpus: " << cpusToString(kv.second.m_cpus));
+            }
+
+            std::unique_lock<std::mutex> cpuGuard(m_cpuMutex);
+            for (const auto &kv : m_cpuStats)
+            {
+                logInfo(MIXLOG << "group: " << kv.first.first << ", stage: " << kv.first.second
+                    << ", cpu: " << kv.second.m_percent << "%");
+            }
         }
 
         void joinAllThread()
@@ -94,7 +392,7 @@ namespace hercules
             auto iter = m_threads.begin();
             while (!m_threads.empty())
             {
-                std::thread *t = iter->second.second;
+                std::thread *t = iter->second.m_thread;
 
                 if (t != nullptr)
                 {
@@ -105,9 +403,462 @@ namespace hercules
             }
         }
 
+    private:
+        static std::string threadStage(const std::string &name)
+        {
+            if (name == "decode" || name == "audio decode")
+            {
+                return "decode";
+            }
+            if (name == "AudioResampler")
+            {
+                return "resample";
+            }
+            if (name.compare(0, 7, "luaJob:") == 0)
+            {
+                return "mix";
+            }
+            if (name == "encoder")
+            {
+                return "encode";
+            }
+            if (name == "publish" || name == "fanout")
+            {
+                return "publish";
+            }
+            return "other";
+        }
+
+        static uint64_t monotonicNs()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+
+        void samplerEntry()
+        {
+            std::unique_lock<std::mutex> lockGuard(m_cpuMutex);
+            while (!m_samplerStop)
+            {
+                m_samplerCond.wait_for(lockGuard, std::chrono::milliseconds(kCpuSampleIntervalMs));
+                if (m_samplerStop)
+                {
+                    break;
+                }
+                // /proc is read without the lock, threads attach and retire meanwhile
+                lockGuard.unlock();
+                uint64_t nowNs = monotonicNs();
+                std::vector<TaskSample> samples = sampleTasks();
+                lockGuard.lock();
+                sampleCpu(nowNs, samples);
+            }
+        }
+
+        static std::vector<TaskSample> sampleTasks()
+        {
+            std::vector<TaskSample> samples;
+            for (pid_t tid : listTasks())
+            {
+                TaskSample sample;
+                sample.m_tid = tid;
+                if (readTaskStat(tid, sample.m_cpuNs, sample.m_startTime))
+                {
+                    samples.push_back(sample);
+                }
+            }
+            return samples;
+        }
+
+        // m_cpuMutex held
+        void settleThread(CpuThread &thread)
+        {
+            if (!thread.m_retired && thread.m_lastNs > thread.m_baseNs)
+            {
+                m_cpuStats[std::make_pair(thread.m_group, thread.m_stage)].m_retiredNs +=
+                    thread.m_lastNs - thread.m_baseNs;
+            }
+            thread.m_baseNs = thread.m_lastNs;
+        }
+
+        // m_cpuMutex held, cpu used so far stays with the previous owner
+        void assignThread(pid_t tid, const std::string &group, const std::string &stage)
+        {
+            auto iter = m_cpuThreads.find(tid);
+            if (iter == m_cpuThreads.end())
+            {
+                iter = m_cpuThreads.insert(std::make_pair(tid, CpuThread())).first;
+                iter->second.m_addedNs = monotonicNs();
+            }
+            CpuThread &thread = iter->second;
+            settleThread(thread);
+            thread.m_group = group;
+            thread.m_stage = stage;
+            thread.m_retired = false;
+        }
+
+        // utime + stime and start time of one task from /proc/self/task/<tid>/stat
+        static bool readTaskStat(pid_t tid, uint64_t &cpuNs, uint64_t &startTime)
+        {
+            static const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+
+            std::ifstream fs("/proc/self/task/" + std::to_string(tid) + "/stat");
+            std::string line;
+            if (!std::getline(fs, line))
+            {
+                return false;
+            }
+            // comm may hold spaces and parentheses, fields restart after the last ')'
+            size_t close = line.rfind(')');
+            if (close == std::string::npos)
+            {
+                return false;
+            }
+            std::istringstream ss(line.substr(close + 1));
+            std::vector<std::string> fields;
+            std::string field;
+            while (ss >> field && fields.size() < 20)
+            {
+                fields.push_back(field);
+            }
+            // fields[0] is stat field 3 (state)
+            if (fields.size() < 20 || ticksPerSecond <= 0)
+            {
+                return false;
+            }
+            uint64_t ticks = strtoull(fields[11].c_str(), nullptr, 10) + strtoull(fields[12].c_str(), nullptr, 10);
+            cpuNs = ticks * 1000000000ULL / ticksPerSecond;
+            startTime = strtoull(fields[19].c_str(), nullptr, 10);
+            return true;
+        }
+
+        // m_cpuMutex held, samples were read from nowNs on. Every task of the
+        // process is counted, threads nobody registered or adopted go under ""/other
+        void sampleCpu(uint64_t nowNs, const std::vector<TaskSample> &samples)
+        {
+            std::set<pid_t> seen;
+            for (const TaskSample &sample : samples)
+            {
+                pid_t tid = sample.m_tid;
+                uint64_t cpuNs = sample.m_cpuNs;
+                uint64_t startTime = sample.m_startTime;
+                seen.insert(tid);
+
+                auto iter = m_cpuThreads.find(tid);
+                if (iter != m_cpuThreads.end() && iter->second.m_startTime != 0
+                    && iter->second.m_startTime != startTime)
+                {
+                    // the tid was reused, the old thread is settled and forgotten
+                    settleThread(iter->second);
+                    m_cpuThreads.erase(iter);
+                    iter = m_cpuThreads.end();
+                }
+                if (iter == m_cpuThreads.end())
+                {
+                    iter = m_cpuThreads.insert(std::make_pair(tid, CpuThread())).first;
+                    iter->second.m_addedNs = nowNs;
+                }
+
+                CpuThread &thread = iter->second;
+                thread.m_startTime = startTime;
+                if (thread.m_retired)
+                {
+                    continue;
+                }
+                thread.m_lastNs = std::max(thread.m_lastNs, cpuNs);
+            }
+
+            std::map<std::pair<std::string, std::string>, uint64_t> totals;
+            std::set<std::pair<std::string, std::string>> live;
+            for (const auto &kv : m_cpuStats)
+            {
+                totals[kv.first] = kv.second.m_retiredNs;
+            }
+            for (auto iter = m_cpuThreads.begin(); iter != m_cpuThreads.end();)
+            {
+                CpuThread &thread = iter->second;
+                auto key = std::make_pair(thread.m_group, thread.m_stage);
+                if (seen.count(iter->first) == 0 && thread.m_addedNs >= nowNs)
+                {
+                    // attached while /proc was being read
+                    ++iter;
+                    continue;
+                }
+                if (seen.count(iter->first) == 0)
+                {
+                    // exited between samples, its cpu up to the previous sample is kept
+                    if (!thread.m_retired)
+                    {
+                        totals[key] += thread.m_lastNs - thread.m_baseNs;
+                    }
+                    settleThread(thread);
+                    iter = m_cpuThreads.erase(iter);
+                    continue;
+                }
+                if (!thread.m_retired)
+                {
+                    live.insert(key);
+                    totals[key] += thread.m_lastNs - thread.m_baseNs;
+                }
+                ++iter;
+            }
+
+            for (auto iter = m_owners.begin(); iter != m_owners.end();)
+            {
+                std::vector<pid_t> &tids = iter->second;
+                tids.erase(std::remove_if(tids.begin(), tids.end(),
+                    [this](pid_t tid) { return m_cpuThreads.count(tid) == 0; }), tids.end());
+                iter = tids.empty() ? m_owners.erase(iter) : std::next(iter);
+            }
+
+            double elapsedNs = static_cast<double>(nowNs - m_lastSampleNs);
+            for (const auto &kv : totals)
+            {
+                CpuStat &stat = m_cpuStats[kv.first];
+                stat.m_percent = (m_lastSampleNs == 0 || kv.second < stat.m_prevNs)
+                    ? 0 : (kv.second - stat.m_prevNs) * 100.0 / elapsedNs;
+                stat.m_prevNs = kv.second;
+            }
+            m_lastSampleNs = nowNs;
+            ++m_samples;
+
+            // stages of finished jobs go once their last interval is reported
+            for (auto iter = m_cpuStats.begin(); iter != m_cpuStats.end();)
+            {
+                if (live.count(iter->first) == 0 && iter->second.m_percent == 0)
+                {
+                    iter = m_cpuStats.erase(iter);
+                }
+                else
+                {
+                    ++iter;
+                }
+            }
+        }
+
+        void releaseGroup(const std::string &group)
+        {
+            auto iter = m_groups.find(group);
+            if (iter == m_groups.end())
+            {
+                return;
+            }
+            if (--iter->second.m_threads > 0)
+            {
+                return;
+            }
+            if (iter->second.m_node >= 0)
+            {
+                --m_nodes[iter->second.m_node].m_groups;
+            }
+            m_groups.erase(iter);
+        }
+
+        // least loaded node, next slice of its cpus
+        void assignGroup(const std::string &group, ThreadGroup &threadGroup)
+        {
+            if (m_nodes.empty())
+            {
+                return;
+            }
+
+            size_t best = 0;
+            for (size_t i = 1; i < m_nodes.size(); ++i)
+            {
+                if (m_nodes[i].m_groups < m_nodes[best].m_groups)
+                {
+                    best = i;
+                }
+            }
+
+            NumaNode &node = m_nodes[best];
+            ++node.m_groups;
+            threadGroup.m_node = best;
+            threadGroup.m_cpus.clear();
+            size_t count = std::min(node.m_cpus.size(), static_cast<size_t>(m_coresPerGroup));
+            for (size_t i = 0; i < count; ++i)
+            {
+                threadGroup.m_cpus.push_back(node.m_cpus[(node.m_nextCpu + i) % node.m_cpus.size()]);
+            }
+            node.m_nextCpu = (node.m_nextCpu + count) % node.m_cpus.size();
+
+            logInfo(MIXLOG << "place group: " << group << " on node: " << node.m_id
+                << ", cpus: " << cpusToString(threadGroup.m_cpus));
+        }
+
+        // "0-3,8,10-11"
+        static std::vector<int> parseCpuList(const std::string &list)
+        {
+            std::vector<int> cpus;
+            std::stringstream ss(list);
+            std::string range;
+            while (std::getline(ss, range, ','))
+            {
+                if (range.empty())
+                {
+                    continue;
+                }
+                size_t dash = range.find('-');
+                int first = atoi(range.c_str());
+                int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+                for (int cpu = first; cpu <= last; ++cpu)
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        static std::string cpusToString(const std::vector<int> &cpus)
+        {
+            std::ostringstream os;
+            for (size_t i = 0; i < cpus.size(); ++i)
+            {
+                os << (i == 0 ? "" : ",") << cpus[i];
+            }
+            return os.str();
+        }
+
+        // nodes from sysfs limited to the cpus this process may use,
+        // a single node of all allowed cpus when sysfs has none
+        void loadTopology()
+        {
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            bool hasAllowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+            DIR *dir = opendir("/sys/devices/system/node");
+            if (dir != nullptr)
+            {
+                struct dirent *entry = nullptr;
+                while ((entry = readdir(dir)) != nullptr)
+                {
+                    std::string name = entry->d_name;
+                    if (name.compare(0, 4, "node") != 0 || name.size() == 4
+                        || name.find_first_not_of("0123456789", 4) != std::string::npos)
+                    {
+                        continue;
+                    }
+
+                    std::ifstream fs("/sys/devices/system/node/" + name + "/cpulist");
+                    std::string list;
+                    std::getline(fs, list);
+
+                    NumaNode node;
+                    node.m_id = atoi(name.c_str() + 4);
+                    for (int cpu : parseCpuList(list))
+                    {
+                        if (!hasAllowed || CPU_ISSET(cpu, &allowed))
+                        {
+                            node.m_cpus.push_back(cpu);
+                        }
+                    }
+                    if (!node.m_cpus.empty())
+                    {
+                        m_nodes.push_back(node);
+                    }
+                }
+                closedir(dir);
+            }
+
+            if (m_nodes.empty())
+            {
+                NumaNode node;
+                long count = sysconf(_SC_NPROCESSORS_ONLN);
+                for (int cpu = 0; cpu < count; ++cpu)
+                {
+                    if (!hasAllowed || CPU_ISSET(cpu, &allowed))
+                    {
+                        node.m_cpus.push_back(cpu);
+                    }
+                }
+                if (!node.m_cpus.empty())
+                {
+                    m_nodes.push_back(node);
+                }
+            }
+
+            std::sort(m_nodes.begin(), m_nodes.end(),
+                [](const NumaNode &lhs, const NumaNode &rhs) { return lhs.m_id < rhs.m_id; });
+            for (const auto &node : m_nodes)
+            {
+                logInfo(MIXLOG << "numa node: " << node.m_id << ", cpus: " << cpusToString(node.m_cpus));
+            }
+        }
+
     private:
         std::mutex m_mutex;
-        std::map<std::thread::id, std::pair<std::string, std::thread *>> m_threads;
+        std::map<std::thread::id, ThreadInfo> m_threads;
+
+        bool m_placement;
+        int m_coresPerGroup;
+        std::vector<NumaNode> m_nodes;
+        std::map<std::string, ThreadGroup> m_groups;
+
+        // lock order: m_mutex then m_cpuMutex
+        std::mutex m_cpuMutex;
+        std::map<pid_t, CpuThread> m_cpuThreads;
+        std::map<const void *, std::vector<pid_t>> m_owners;
+        std::map<std::pair<std::string, std::string>, CpuStat> m_cpuStats;
+        uint64_t m_lastSampleNs;
+        std::atomic<uint64_t> m_samples;
+        bool m_samplerStop;
+        std::condition_variable m_samplerCond;
+        std::thread m_sampler;
+    };
+
+    // threads a library starts in this scope, codec workers that never pass through
+    // OneCycleThread, are adopted for owner under the calling thread's group. No
+    // other thread of the sdk can start meanwhile, the new tids are the library's
+    class ThreadSpawnScope
+    {
+    public:
+        explicit ThreadSpawnScope(const std::string &stage)
+            : m_stage(stage), m_lock(ThreadManager::spawnMutex())
+        {
+            std::vector<pid_t> tids = ThreadManager::listTasks();
+            m_before.insert(tids.begin(), tids.end());
+        }
+
+        void adopt(const void *owner)
+        {
+            std::vector<pid_t> tids;
+            for (pid_t tid : ThreadManager::listTasks())
+            {
+                if (m_before.count(tid) == 0)
+                {
+                    tids.push_back(tid);
+                }
+            }
+
+            if (!tids.empty())
+            {
+                ThreadManager::getInstance()->adoptThreads(owner, tids, ThreadManager::currentGroup(), m_stage);
+            }
+        }
+
+    private:
+        std::string m_stage;
+        std::unique_lock<std::mutex> m_lock;
+        std::set<pid_t> m_before;
+    };
+
+    // threads started in this scope belong to group
+    class ThreadGroupGuard
+    {
+    public:
+        explicit ThreadGroupGuard(const std::string &group) : m_prev(ThreadManager::currentGroup())
+        {
+            ThreadManager::currentGroup() = group;
+        }
+
+        ~ThreadGroupGuard()
+        {
+            ThreadManager::currentGroup() = m_prev;
+        }
+
+    private:
+        std::string m_prev;
     };
 
 } // namespace hercules
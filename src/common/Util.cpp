@@ -20,6 +20,7 @@ namespace hercules
 {
 
     uint32_t TimestampAdjuster::m_serverStartTimeMs = getNowMs();
+    thread_local VirtualClock *VirtualClock::m_current = nullptr;
 
     static char c_b2s[256][4] = {
         "00", "01", "02", "03", "04", "05", "06", "07", "08", "09", "0a", "0b", "0c", "0d", "0e", "0f",
@@ -16,6 +16,7 @@
 
 #include "Log.h"
 
+#include <atomic>
 #include <string>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -162,6 +163,39 @@ namespace hercules
         return (uint32_t)getNowMs();
     }
 
+    // per-thread clock override, offline jobs install one on their lua thread
+    // so mixing runs on media time instead of wall time
+    class VirtualClock
+    {
+    public:
+        explicit VirtualClock(uint32_t startMs = 0) : m_nowMs(startMs)
+        {
+        }
+
+        uint32_t nowMs() const { return m_nowMs.load(); }
+        void advance(uint32_t ms) { m_nowMs.fetch_add(ms); }
+
+        static VirtualClock *current() { return m_current; }
+        static void setCurrent(VirtualClock *clock) { m_current = clock; }
+
+    private:
+        std::atomic<uint32_t> m_nowMs;
+
+        static thread_local VirtualClock *m_current;
+    };
+
+    // wall time, or virtual time when the calling thread has a clock installed
+    inline uint64_t getClockMs()
+    {
+        VirtualClock *clock = VirtualClock::current();
+        if (clock != nullptr)
+        {
+            return clock->nowMs();
+        }
+
+        return getNowMs();
+    }
+
     class TimestampAdjuster
     {
     public:
@@ -214,6 +248,12 @@ namespace hercules
 
         static uint32_t getElapseFromServerStart()
         {
+            VirtualClock *clock = VirtualClock::current();
+            if (clock != nullptr)
+            {
+                return clock->nowMs();
+            }
+
             return getNowMs() - m_serverStartTimeMs;
         }
 
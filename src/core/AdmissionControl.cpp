@@ -0,0 +1,294 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "AdmissionControl.h"
+#include "InputRegistry.h"
+#include "ThreadManager.h"
+#include "Util.h"
+#include "Log.h"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <string>
+
+namespace hercules
+{
+
+    static double jsonNumber(const Json::Value &value, double defaultValue)
+    {
+        return value.isNumeric() && value.asDouble() > 0 ? value.asDouble() : defaultValue;
+    }
+
+    static bool isHevc(const Json::Value &codec)
+    {
+        std::string name = codec.isString() ? codec.asString() : "";
+        return name == "h265" || name == "hevc" || name == "H265" || name == "HEVC";
+    }
+
+    static double allowedCores()
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            return CPU_COUNT(&set);
+        }
+        return std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    }
+
+    AdmissionControl::AdmissionControl()
+        : m_capacity(allowedCores() * kAdmissionTargetUtil)
+        , m_enforced(false)
+        , m_queueWhenFull(false)
+        , m_scale(1.0)
+        , m_calibratedSample(0)
+    {
+    }
+
+    void AdmissionControl::setCoefficients(const CostCoefficients &coefficients)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        m_coefficients = coefficients;
+    }
+
+    void AdmissionControl::setCapacity(double cores)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        m_capacity = cores > 0 ? cores : allowedCores() * kAdmissionTargetUtil;
+        m_enforced = true;
+        logInfo(MIXLOG << "admission capacity: " << m_capacity);
+    }
+
+    void AdmissionControl::setQueueWhenFull(bool queue)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        m_queueWhenFull = queue;
+    }
+
+    double AdmissionControl::estimate(const Json::Value &job) const
+    {
+        const CostCoefficients &c = m_coefficients;
+        const Json::Value &codec = job["out_stream"]["codec"];
+        const Json::Value &video = codec["video"];
+        double outFps = jsonNumber(video["fps"], 30);
+        double cost = c.m_base;
+
+        if (!video.isNull())
+        {
+            double outMpix = jsonNumber(video["width"], 1920) * jsonNumber(video["height"], 1080) / 1e6;
+            cost += c.m_encodePerMpixFrame * outMpix * outFps * (isHevc(video["codec"]) ? c.m_hevcFactor : 1.0);
+        }
+        if (!codec["audio"].isNull())
+        {
+            cost += c.m_audioPerOutput;
+        }
+
+        std::set<std::string> inputs;
+        const Json::Value &list = job["input_stream_list"];
+        for (Json::ArrayIndex i = 0; list.isArray() && i < list.size(); ++i)
+        {
+            const Json::Value &item = list[i];
+            std::string type = item["type"].isString() ? item["type"].asString() : "";
+            if (type == "av_stream")
+            {
+                const Json::Value &put = item["put_rect"];
+                double putMpix = (jsonNumber(put["right"], 1920) - jsonNumber(put["left"], 0))
+                    * (jsonNumber(put["bottom"], 1080) - jsonNumber(put["top"], 0)) / 1e6;
+                cost += c.m_blendPerMpixFrame * std::max(putMpix, 0.0) * outFps;
+
+                std::string name = item["stream_name"].isString() ? item["stream_name"].asString() : "";
+                if (inputs.insert(name).second)
+                {
+                    // crop_rect is in source pixels, its far corner bounds the source size
+                    const Json::Value &crop = item["crop_rect"];
+                    double inMpix = jsonNumber(crop["right"], 1920) * jsonNumber(crop["bottom"], 1080) / 1e6;
+                    double inFps = jsonNumber(item["fps"], 30);
+                    cost += c.m_decodePerMpixFrame * inMpix * inFps * (isHevc(item["codec"]) ? c.m_hevcFactor : 1.0);
+                    cost += c.m_audioPerInput;
+                }
+            }
+            else if (type == "pk_bar" || type == "group_container")
+            {
+                cost += c.m_containerLayer;
+            }
+            else if (type != "out_stream")
+            {
+                cost += c.m_staticLayer;
+            }
+        }
+
+        return cost;
+    }
+
+    AdmissionResult AdmissionControl::admit(const std::string &key, const Json::Value &job)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        calibrate();
+
+        double cost = estimate(job);
+        AdmissionResult result;
+        result.m_capacity = m_capacity;
+        result.m_cost = cost * m_scale;
+
+        double headroom = m_capacity - committed() * m_scale;
+        // an idle host always takes one job, however big
+        if (!m_enforced || result.m_cost <= headroom || m_commits.empty())
+        {
+            Commit commit;
+            commit.m_cost = cost;
+            commit.m_startMs = getNowMs();
+            m_commits[key] = commit;
+            result.m_decision = AdmissionDecision::ADMIT;
+            headroom -= result.m_cost;
+        }
+        else if (m_queueWhenFull)
+        {
+            m_queue.push_back(std::make_pair(key, cost));
+            result.m_decision = AdmissionDecision::QUEUE;
+        }
+        else
+        {
+            result.m_decision = AdmissionDecision::REJECT;
+        }
+        result.m_headroom = headroom;
+
+        logInfo(MIXLOG << "admission key: " << key << ", decision: " << static_cast<int>(result.m_decision)
+            << ", cost: " << result.m_cost << ", headroom: " << result.m_headroom
+            << ", capacity: " << m_capacity << ", scale: " << m_scale << ", queued: " << m_queue.size());
+        return result;
+    }
+
+    void AdmissionControl::update(const std::string &key, const Json::Value &job)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        auto iter = m_commits.find(key);
+        if (iter != m_commits.end())
+        {
+            iter->second.m_cost = estimate(job);
+            return;
+        }
+        for (auto &queued : m_queue)
+        {
+            if (queued.first == key)
+            {
+                queued.second = estimate(job);
+            }
+        }
+    }
+
+    void AdmissionControl::release(const std::string &key)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        m_commits.erase(key);
+        for (auto iter = m_queue.begin(); iter != m_queue.end(); ++iter)
+        {
+            if (iter->first == key)
+            {
+                m_queue.erase(iter);
+                break;
+            }
+        }
+    }
+
+    std::string AdmissionControl::popAdmissible()
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        double headroom = m_capacity - committed() * m_scale;
+        for (auto iter = m_queue.begin(); iter != m_queue.end(); ++iter)
+        {
+            // an idle host always takes the oldest job, however big
+            if (iter->second * m_scale > headroom && !m_commits.empty())
+            {
+                continue;
+            }
+
+            std::string key = iter->first;
+            Commit commit;
+            commit.m_cost = iter->second;
+            commit.m_startMs = getNowMs();
+            m_commits[key] = commit;
+            m_queue.erase(iter);
+            logInfo(MIXLOG << "admission dequeue key: " << key << ", headroom: " << headroom - commit.m_cost * m_scale);
+            return key;
+        }
+        return "";
+    }
+
+    double AdmissionControl::getHeadroom()
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        calibrate();
+        return m_capacity - committed() * m_scale;
+    }
+
+    double AdmissionControl::committed() const
+    {
+        double sum = 0;
+        for (const auto &kv : m_commits)
+        {
+            sum += kv.second.m_cost;
+        }
+        return sum;
+    }
+
+    // scale the model towards what settled jobs really use, once per cpu sample
+    // however often it is asked
+    void AdmissionControl::calibrate()
+    {
+        uint64_t sample = ThreadManager::getInstance()->getSampleCount();
+        if (sample == m_calibratedSample)
+        {
+            return;
+        }
+        uint64_t samples = sample - m_calibratedSample;
+        m_calibratedSample = sample;
+
+        CpuUsage usage = ThreadManager::getInstance()->getCpuUsage();
+        InputRegistry::getInstance()->apportion(usage);
+        uint64_t nowMs = getNowMs();
+        double estimated = 0;
+        double measured = 0;
+        for (const auto &kv : m_commits)
+        {
+            auto iter = usage.find(kv.first);
+            if (iter == usage.end() || nowMs < kv.second.m_startMs + kAdmissionCalibrateAfterMs)
+            {
+                continue;
+            }
+            // codec workers are adopted when the codec opens, before that the
+            // job reads far below its model
+            if (iter->second.find("encode") == iter->second.end())
+            {
+                continue;
+            }
+            estimated += kv.second.m_cost;
+            for (const auto &stage : iter->second)
+            {
+                measured += stage.second / 100.0;
+            }
+        }
+
+        if (estimated > 0 && measured > 0)
+        {
+            double ratio = std::min(std::max(measured / estimated, kAdmissionMinScale), 4.0);
+            // as if every sample since the last call had moved it by 0.2
+            double keep = std::pow(0.8, static_cast<double>(std::min<uint64_t>(samples, 64)));
+            m_scale = m_scale * keep + ratio * (1 - keep);
+        }
+    }
+
+} // namespace hercules
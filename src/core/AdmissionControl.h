@@ -0,0 +1,131 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "json/json.h"
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace hercules
+{
+
+    // share of the allowed cpus jobs may commit, the rest absorbs bursts
+    constexpr double kAdmissionTargetUtil = 0.8;
+    // jobs younger than this are not used to calibrate, warmup skews cpu
+    constexpr uint64_t kAdmissionCalibrateAfterMs = 10000;
+    // lowest scale calibration may reach, a quiet sample must not open the host wide
+    constexpr double kAdmissionMinScale = 0.75;
+
+    enum class AdmissionDecision
+    {
+        ADMIT = 0,
+        QUEUE = 1,
+        REJECT = 2,
+    };
+
+    struct AdmissionResult
+    {
+        AdmissionResult() : m_decision(AdmissionDecision::ADMIT), m_cost(0), m_headroom(0), m_capacity(0)
+        {
+        }
+        AdmissionDecision m_decision;
+        double m_cost;        // estimated cores of the task
+        double m_headroom;    // cores left after the decision
+        double m_capacity;    // cores jobs may commit on this host
+    };
+
+    // cores spent per unit of work, defaults measured on a 1080p30 x264 veryfast job
+    struct CostCoefficients
+    {
+        CostCoefficients()
+            : m_decodePerMpixFrame(0.0048)
+            , m_blendPerMpixFrame(0.0024)
+            , m_encodePerMpixFrame(0.024)
+            , m_hevcFactor(2.0)
+            , m_staticLayer(0.02)
+            , m_containerLayer(0.1)
+            , m_audioPerInput(0.01)
+            , m_audioPerOutput(0.03)
+            , m_base(0.05)
+        {
+        }
+        double m_decodePerMpixFrame;
+        double m_blendPerMpixFrame;
+        double m_encodePerMpixFrame;
+        double m_hevcFactor;
+        double m_staticLayer;     // text, image
+        double m_containerLayer;  // pk_bar, group_container
+        double m_audioPerInput;
+        double m_audioPerOutput;
+        double m_base;            // lua tick and bookkeeping
+    };
+
+    // estimates a job's cost from its json and tracks what running jobs
+    // committed against the host budget, the model is scaled by the ratio of
+    // measured to estimated cpu of running jobs
+    class AdmissionControl
+    {
+    public:
+        AdmissionControl();
+
+        void setCoefficients(const CostCoefficients &coefficients);
+        // cores jobs may commit, <= 0 derives it from the allowed cpus;
+        // until it is called every job is admitted and only accounted
+        void setCapacity(double cores);
+        void setQueueWhenFull(bool queue);
+
+        double estimate(const Json::Value &job) const;
+
+        // admit commits the cost under key, queue remembers key in order
+        AdmissionResult admit(const std::string &key, const Json::Value &job);
+        // re-estimate a running job after an update, never refused
+        void update(const std::string &key, const Json::Value &job);
+        void release(const std::string &key);
+        // oldest queued key that fits now, smaller ones may pass a big one
+        // that does not, it is committed, "" if none
+        std::string popAdmissible();
+
+        double getHeadroom();
+
+    private:
+        void calibrate();
+        double committed() const;
+
+    private:
+        struct Commit
+        {
+            double m_cost;        // model cost, before m_scale
+            uint64_t m_startMs;
+        };
+
+        std::mutex m_mutex;
+        CostCoefficients m_coefficients;
+        double m_capacity;
+        bool m_enforced;
+        bool m_queueWhenFull;
+        double m_scale;
+        // cpu sample the scale was last moved towards
+        uint64_t m_calibratedSample;
+        std::map<std::string, Commit> m_commits;
+        std::deque<std::pair<std::string, double>> m_queue;
+    };
+
+} // namespace hercules
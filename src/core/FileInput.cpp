@@ -0,0 +1,93 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FileInput.h"
+#include "Job.h"
+#include "Log.h"
+
+#include <string>
+
+namespace hercules
+{
+
+    FileInput::FileInput(Job *job, const std::string &streamName, const std::string &fileName,
+                         bool loop, bool realtime)
+        : m_job(job)
+        , m_streamName(streamName)
+        , m_fileName(fileName)
+        , m_loop(loop)
+        , m_realtime(realtime)
+    {
+    }
+
+    FileInput::~FileInput()
+    {
+        stopThread();
+        joinThread();
+    }
+
+    void FileInput::threadEntry()
+    {
+        // keyframe index is only needed for looping
+        if (m_reader.init(m_fileName, m_loop) != 0)
+        {
+            logErr(MIXLOG << "open flv file failed: " << m_fileName << ", stream: " << m_streamName);
+            m_job->endInput(m_streamName);
+            return;
+        }
+        m_reader.setLoop(m_loop);
+        m_reader.setRealtime(m_realtime);
+        logInfo(MIXLOG << "file input start: " << m_fileName << ", stream: " << m_streamName
+            << ", loop: " << m_loop << ", realtime: " << m_realtime);
+
+        // a queued job drops data until admission starts it
+        while (!isStop() && !m_job->waitStarted(kFileInputStartWaitMs))
+        {
+        }
+
+        AVData data;
+        data.m_streamName = m_streamName;
+        flv::TagView tag;
+        uint64_t tags = 0;
+        while (!isStop() && m_reader.next(tag))
+        {
+            if (tag.m_tagType != flvhelper::TAG_TYPE_VIDEO &&
+                tag.m_tagType != flvhelper::TAG_TYPE_SCRIPT &&
+                tag.m_tagType != flvhelper::TAG_TYPE_AUDIO)
+            {
+                continue;
+            }
+
+            data.m_dataType = static_cast<DataType>(tag.m_tagType);
+            data.m_data.assign(reinterpret_cast<const char *>(tag.m_data), tag.m_size);
+            // timestamp is shifted when looping, rewrite it in the copied header
+            data.m_data[4] = static_cast<char>((tag.m_timestamp >> 16) & 0xFF);
+            data.m_data[5] = static_cast<char>((tag.m_timestamp >> 8) & 0xFF);
+            data.m_data[6] = static_cast<char>(tag.m_timestamp & 0xFF);
+            data.m_data[7] = static_cast<char>((tag.m_timestamp >> 24) & 0xFF);
+            data.m_dts = tag.m_timestamp;
+            data.m_pts = tag.m_timestamp;
+            m_job->addAVData(data);
+            ++tags;
+        }
+
+        logInfo(MIXLOG << "file input stop: " << m_fileName << ", stream: " << m_streamName
+            << ", tags: " << tags << ", eof: " << m_reader.isEof());
+        if (!isStop())
+        {
+            m_job->endInput(m_streamName);
+        }
+    }
+
+} // namespace hercules
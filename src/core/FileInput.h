@@ -0,0 +1,54 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "OneCycleThread.h"
+#include "FlvMmapReader.h"
+#include "StreamRegistry.h"
+
+#include <string>
+
+namespace hercules
+{
+
+    class Job;
+
+    // a file input waiting for its job to start checks for a stop this often
+    constexpr uint32_t kFileInputStartWaitMs = 100;
+
+    // feeds one flv file to a job as the input streamName through addAVData,
+    // an offline job is told the input ended once the file is read
+    class FileInput : public OneCycleThread
+    {
+    public:
+        FileInput(Job *job, const std::string &streamName, const std::string &fileName,
+                  bool loop, bool realtime);
+        ~FileInput();
+
+        void start() { OneCycleThread::startThread("fileInput"); }
+        void stop() { OneCycleThread::stopThread(); }
+
+        virtual void threadEntry();
+
+    private:
+        Job *m_job;
+        std::string m_streamName;
+        std::string m_fileName;
+        bool m_loop;
+        bool m_realtime;
+        flv::FlvMmapReader m_reader;
+    };
+
+} // namespace hercules
@@ -0,0 +1,94 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FrameBus.h"
+#include "MediaFrame.h"
+#include "Log.h"
+
+#include <iterator>
+
+namespace hercules
+{
+
+    void FrameBus::subscribe(StreamIndex index, const std::string &jobKey, SubscribeContext *ctx)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_subscribers[index][jobKey] = ctx;
+    }
+
+    void FrameBus::leave(const std::string &jobKey)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // empty entries go too, an index is reused once its name is released
+        for (auto iter = m_subscribers.begin(); iter != m_subscribers.end();)
+        {
+            iter->second.erase(jobKey);
+            iter = iter->second.empty() ? m_subscribers.erase(iter) : std::next(iter);
+        }
+        for (auto iter = m_publishers.begin(); iter != m_publishers.end();)
+        {
+            if (iter->second != jobKey)
+            {
+                ++iter;
+                continue;
+            }
+            logInfo(MIXLOG << "frame bus unpublish: "
+                << StreamRegistry::getInstance()->getName(iter->first) << ", job: " << jobKey);
+            iter = m_publishers.erase(iter);
+        }
+    }
+
+    int FrameBus::publish(StreamIndex index, const std::string &jobKey, MediaFrame &frame, MediaType type)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::string &owner = m_publishers[index];
+        if (owner.empty())
+        {
+            logInfo(MIXLOG << "frame bus publish: " << StreamRegistry::getInstance()->getName(index)
+                << ", job: " << jobKey);
+            owner = jobKey;
+        }
+        else if (owner != jobKey)
+        {
+            return -1;
+        }
+
+        auto subscribers = m_subscribers.find(index);
+        if (subscribers == m_subscribers.end())
+        {
+            return 0;
+        }
+
+        int reached = 0;
+        for (auto &subscriber : subscribers->second)
+        {
+            // a job pulling its own output would feed back into itself
+            if (subscriber.first == jobKey)
+            {
+                continue;
+            }
+            if (type == MediaType::VIDEO)
+            {
+                subscriber.second->pushVideoFrame(frame);
+            }
+            else
+            {
+                subscriber.second->pushAudioFrame(frame);
+            }
+            ++reached;
+        }
+        return reached;
+    }
+
+} // namespace hercules
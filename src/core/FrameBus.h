@@ -0,0 +1,56 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "Singleton.h"
+#include "StreamRegistry.h"
+#include "SubscribeContext.h"
+#include "MediaBase.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace hercules
+{
+
+    // composited canvases and mixed audio of a job, handed to the jobs that pull
+    // the same stream name without encoding, frames are shared and read-only
+    class FrameBus : public Singleton<FrameBus>
+    {
+        friend class Singleton<FrameBus>;
+
+    public:
+        // a name may be subscribed before any job publishes it
+        void subscribe(StreamIndex index, const std::string &jobKey, SubscribeContext *ctx);
+        // drops the subscriptions and publications of jobKey
+        void leave(const std::string &jobKey);
+
+        // returns the number of jobs the frame reached, -1 when another job owns the name
+        int publish(StreamIndex index, const std::string &jobKey, MediaFrame &frame, MediaType type);
+
+    private:
+        FrameBus() {}
+        ~FrameBus() {}
+
+    private:
+        std::mutex m_mutex;
+        // every stream on the bus, too many for a flat map
+        std::unordered_map<StreamIndex, std::map<std::string, SubscribeContext *>> m_subscribers;
+        std::unordered_map<StreamIndex, std::string> m_publishers;
+    };
+
+} // namespace hercules
@@ -0,0 +1,337 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "InputRegistry.h"
+#include "ThreadManager.h"
+#include "Log.h"
+
+#include <algorithm>
+
+namespace hercules
+{
+
+    InputRegistry::~InputRegistry()
+    {
+        for (auto &input : m_inputs)
+        {
+            destroy(*input.second);
+        }
+        m_inputs.clear();
+    }
+
+    std::shared_ptr<SharedInput> InputRegistry::join(StreamIndex index, const std::string &streamName,
+                                                     const std::string &jobKey, SubscribeContext *ctx,
+                                                     const InputHint &hint)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::shared_ptr<SharedInput> &input = m_inputs[index];
+        if (input == nullptr)
+        {
+            logInfo(MIXLOG << "new shared input: " << streamName);
+            input = std::make_shared<SharedInput>();
+            input->m_streamName = streamName;
+        }
+
+        std::unique_lock<std::mutex> inputLock(input->m_mutex);
+        Subscriber &subscriber = input->m_subscribers[jobKey];
+        subscriber.m_hint = hint;
+        if (ctx != nullptr && subscriber.m_ctx != ctx)
+        {
+            logInfo(MIXLOG << "shared input: " << streamName << ", add subscriber: " << jobKey
+                << ", subscribers: " << input->m_subscribers.size());
+            subscriber.m_ctx = ctx;
+            if (input->m_video != nullptr)
+            {
+                input->m_video->m_decoder.addSubscriber(jobKey, ctx);
+            }
+            if (input->m_audio != nullptr)
+            {
+                input->m_audio->m_resampler.addSubscriber(jobKey, ctx);
+            }
+        }
+        applyHint(*input);
+        return input;
+    }
+
+    void InputRegistry::setHint(StreamIndex index, const std::string &jobKey, const InputHint &hint)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto found = m_inputs.find(index);
+        if (found == m_inputs.end())
+        {
+            return;
+        }
+        SharedInput &input = *found->second;
+        std::unique_lock<std::mutex> inputLock(input.m_mutex);
+        auto iter = input.m_subscribers.find(jobKey);
+        if (iter == input.m_subscribers.end())
+        {
+            return;
+        }
+        iter->second.m_hint = hint;
+        applyHint(input);
+    }
+
+    void InputRegistry::leave(StreamIndex index, const std::string &jobKey)
+    {
+        std::shared_ptr<SharedInput> removed;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto found = m_inputs.find(index);
+            if (found == m_inputs.end())
+            {
+                return;
+            }
+            std::shared_ptr<SharedInput> input = found->second;
+            std::unique_lock<std::mutex> inputLock(input->m_mutex);
+            if (input->m_subscribers.erase(jobKey) == 0)
+            {
+                return;
+            }
+
+            // the decoder threads must not touch the context once the job is gone
+            if (input->m_video != nullptr)
+            {
+                input->m_video->m_decoder.delSubscriber(jobKey);
+            }
+            if (input->m_audio != nullptr)
+            {
+                input->m_audio->m_resampler.delSubscriber(jobKey);
+            }
+            if (input->m_feed.m_jobKey == jobKey)
+            {
+                input->m_feed.m_jobKey.clear();
+            }
+
+            logInfo(MIXLOG << "shared input: " << input->m_streamName << ", del subscriber: " << jobKey
+                << ", subscribers: " << input->m_subscribers.size());
+            if (!input->m_subscribers.empty())
+            {
+                applyHint(*input);
+                return;
+            }
+            m_inputs.erase(index);
+            input->m_released = true;
+            removed = input;
+        }
+
+        logInfo(MIXLOG << "release shared input: " << removed->m_streamName
+            << ", duplicates: " << removed->m_duplicates);
+        destroy(*removed);
+    }
+
+    // input.m_mutex held
+    bool InputRegistry::accept(SharedInput &input, const std::string &jobKey, MediaPacket &packet)
+    {
+        Feed &feed = input.m_feed;
+        uint64_t nowMs = getNowMs();
+        if (feed.m_jobKey != jobKey)
+        {
+            if (!feed.m_jobKey.empty() && nowMs <= feed.m_lastMs + kSharedFeedFailoverMs)
+            {
+                return false;
+            }
+            // both tracks move over together, the stall is kept as a gap in dts
+            feed.m_offset = feed.m_hasDts
+                ? static_cast<TIMESTAMP>(feed.m_lastDts + (nowMs - feed.m_lastMs) - packet.getDts()) : 0;
+            logInfo(MIXLOG << "shared input: " << input.m_streamName << ", feed from: " << jobKey
+                << ", was: " << feed.m_jobKey << ", dts offset: " << feed.m_offset);
+            feed.m_jobKey = jobKey;
+        }
+        feed.m_lastMs = nowMs;
+        packet.setDts(packet.getDts() + feed.m_offset);
+        packet.setPts(packet.getPts() + feed.m_offset);
+        if (!feed.m_hasDts || packet.getDts() > feed.m_lastDts)
+        {
+            feed.m_lastDts = packet.getDts();
+            feed.m_hasDts = true;
+        }
+        return true;
+    }
+
+    int InputRegistry::pushVideo(SharedInput &input, const std::string &jobKey, MediaPacket &packet)
+    {
+        std::unique_lock<std::mutex> lock(input.m_mutex);
+        if (input.m_released)
+        {
+            return EC_ERROR;
+        }
+        if (!accept(input, jobKey, packet))
+        {
+            ++input.m_duplicates;
+            return EC_SUCCESS;
+        }
+
+        if (input.m_video == nullptr)
+        {
+            DecoderCtx *decoderCtx = new DecoderCtx();
+            decoderCtx->m_decoder.init(input.m_streamName, &(decoderCtx->m_packetQueue));
+            for (const auto &subscriber : input.m_subscribers)
+            {
+                if (subscriber.second.m_ctx != nullptr)
+                {
+                    decoderCtx->m_decoder.addSubscriber(subscriber.first, subscriber.second.m_ctx);
+                }
+            }
+            input.m_video = decoderCtx;
+            applyHint(input);
+            // serves several jobs, its cpu is split over them by apportion
+            ThreadGroupGuard guard(kSharedGroupPrefix + input.m_streamName);
+            decoderCtx->m_decoder.start();
+        }
+
+        packet.setFrameId((input.m_video->m_frameId)++);
+        if (!input.m_video->m_packetQueue.push(packet.getDts(), packet))
+        {
+            logErr(MIXLOG << "push error, shared input: " << input.m_streamName);
+        }
+        return EC_SUCCESS;
+    }
+
+    int InputRegistry::pushAudio(SharedInput &input, const std::string &jobKey, MediaPacket &packet)
+    {
+        std::unique_lock<std::mutex> lock(input.m_mutex);
+        if (input.m_released)
+        {
+            return EC_ERROR;
+        }
+        if (!accept(input, jobKey, packet))
+        {
+            ++input.m_duplicates;
+            return EC_SUCCESS;
+        }
+
+        if (input.m_audio == nullptr)
+        {
+            AudioDecoderCtx *decoderCtx = new AudioDecoderCtx();
+            decoderCtx->m_decoder.init(input.m_streamName, &(decoderCtx->m_packetQueue));
+            decoderCtx->m_resampler.subscribeAudioFrame();
+            decoderCtx->m_decoder.addSubscriber(input.m_streamName, &(decoderCtx->m_resampler));
+            for (const auto &subscriber : input.m_subscribers)
+            {
+                if (subscriber.second.m_ctx != nullptr)
+                {
+                    decoderCtx->m_resampler.addSubscriber(subscriber.first, subscriber.second.m_ctx);
+                }
+            }
+            decoderCtx->m_decoder.setStreamName(input.m_streamName);
+            decoderCtx->m_resampler.setStreamName(input.m_streamName);
+            input.m_audio = decoderCtx;
+            ThreadGroupGuard guard(kSharedGroupPrefix + input.m_streamName);
+            decoderCtx->m_decoder.start();
+            decoderCtx->m_resampler.start();
+        }
+
+        packet.setFrameId((input.m_audio->m_frameId)++);
+        if (!input.m_audio->m_packetQueue.push(packet.getDts(), packet))
+        {
+            logErr(MIXLOG << "push error, shared input: " << input.m_streamName);
+        }
+        return EC_SUCCESS;
+    }
+
+    // the decoder has to satisfy the most demanding subscriber
+    void InputRegistry::applyHint(SharedInput &input)
+    {
+        if (input.m_video == nullptr || input.m_subscribers.empty())
+        {
+            return;
+        }
+
+        InputHint merged;
+        merged.m_visible = false;
+        merged.m_overloaded = true;
+        merged.m_quality = DecodeQuality::FAST;
+        bool unknownSize = false;
+        bool unknownFps = false;
+        for (const auto &subscriber : input.m_subscribers)
+        {
+            const InputHint &hint = subscriber.second.m_hint;
+            merged.m_visible = merged.m_visible || hint.m_visible;
+            merged.m_overloaded = merged.m_overloaded && hint.m_overloaded;
+            merged.m_quality = std::min(merged.m_quality, hint.m_quality);
+            unknownSize = unknownSize || hint.m_width <= 0 || hint.m_height <= 0;
+            merged.m_width = std::max(merged.m_width, hint.m_width);
+            merged.m_height = std::max(merged.m_height, hint.m_height);
+            unknownFps = unknownFps || hint.m_outputFps <= 0;
+            merged.m_outputFps = std::max(merged.m_outputFps, hint.m_outputFps);
+        }
+
+        Decoder &decoder = input.m_video->m_decoder;
+        decoder.setVisible(merged.m_visible);
+        decoder.setDisplaySize(unknownSize ? 0 : merged.m_width, unknownSize ? 0 : merged.m_height);
+        decoder.setOutputFps(unknownFps ? 0 : merged.m_outputFps);
+        decoder.setOverloaded(merged.m_overloaded);
+        decoder.setDecodeQuality(merged.m_quality);
+    }
+
+    // input is released, no push touches the decoders any more
+    void InputRegistry::destroy(SharedInput &input)
+    {
+        if (input.m_video != nullptr)
+        {
+            input.m_video->m_decoder.stop();
+            input.m_video->m_decoder.join();
+            delete input.m_video;
+            input.m_video = nullptr;
+        }
+        if (input.m_audio != nullptr)
+        {
+            input.m_audio->m_decoder.stop();
+            input.m_audio->m_resampler.stop();
+            input.m_audio->m_decoder.join();
+            input.m_audio->m_resampler.join();
+            delete input.m_audio;
+            input.m_audio = nullptr;
+        }
+    }
+
+    std::map<std::string, int> InputRegistry::getSubscriberCounts()
+    {
+        std::map<std::string, int> counts;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const auto &input : m_inputs)
+        {
+            std::unique_lock<std::mutex> inputLock(input.second->m_mutex);
+            counts[input.second->m_streamName] = static_cast<int>(input.second->m_subscribers.size());
+        }
+        return counts;
+    }
+
+    void InputRegistry::apportion(CpuUsage &usage)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const auto &input : m_inputs)
+        {
+            std::unique_lock<std::mutex> inputLock(input.second->m_mutex);
+            const std::map<std::string, Subscriber> &subscribers = input.second->m_subscribers;
+            auto shared = usage.find(kSharedGroupPrefix + input.second->m_streamName);
+            if (shared == usage.end() || subscribers.empty())
+            {
+                continue;
+            }
+            double share = 1.0 / subscribers.size();
+            for (const auto &subscriber : subscribers)
+            {
+                std::map<std::string, double> &stages = usage[subscriber.first];
+                for (const auto &stage : shared->second)
+                {
+                    stages[stage.first] += stage.second * share;
+                }
+            }
+            usage.erase(shared);
+        }
+    }
+
+} // namespace hercules
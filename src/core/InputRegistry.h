@@ -0,0 +1,142 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "Singleton.h"
+#include "StreamRegistry.h"
+#include "ThreadManager.h"
+#include "Job.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace hercules
+{
+
+    // another job's feed is taken once the followed one stalls this long
+    constexpr uint64_t kSharedFeedFailoverMs = 500;
+
+    // what one job wants from a shared input, merged over all its subscribers
+    struct InputHint
+    {
+        InputHint()
+            : m_visible(true)
+            , m_width(0)
+            , m_height(0)
+            , m_outputFps(0)
+            , m_overloaded(false)
+            , m_quality(DecodeQuality::FULL)
+        {
+        }
+        bool m_visible;
+        int m_width;
+        int m_height;
+        int m_outputFps;
+        bool m_overloaded;
+        DecodeQuality m_quality;
+    };
+
+    struct Subscriber
+    {
+        Subscriber() : m_ctx(nullptr)
+        {
+        }
+        SubscribeContext *m_ctx;
+        InputHint m_hint;
+    };
+
+    // every job pulling the stream feeds it, one job is followed for both tracks
+    // and the others are dropped until it stalls. Pullers may not share a dts
+    // base, the new feed is shifted to continue from where the old one stopped
+    struct Feed
+    {
+        Feed() : m_lastMs(0), m_offset(0), m_lastDts(0), m_hasDts(false)
+        {
+        }
+        std::string m_jobKey;
+        uint64_t m_lastMs;
+        TIMESTAMP m_offset;
+        TIMESTAMP m_lastDts;
+        bool m_hasDts;
+    };
+
+    // a decoded input stream shared by its subscribers, guarded by m_mutex; jobs
+    // keep a reference and push to it without going through the registry
+    struct SharedInput
+    {
+        SharedInput() : m_video(nullptr), m_audio(nullptr), m_duplicates(0), m_released(false)
+        {
+        }
+        std::mutex m_mutex;
+        std::string m_streamName;
+        DecoderCtx *m_video;
+        AudioDecoderCtx *m_audio;
+        Feed m_feed;
+        // packets also fed by another job, dropped
+        uint64_t m_duplicates;
+        // the last subscriber left, the decoders are gone
+        bool m_released;
+        std::map<std::string, Subscriber> m_subscribers;
+    };
+
+    // one decoder per input stream name for all live jobs pulling it, decoded
+    // frames fan out through the SubscribeContext of each job. Tasks naming
+    // different sources alike would mix each other's media, so it is opt-in
+    class InputRegistry : public Singleton<InputRegistry>
+    {
+        friend class Singleton<InputRegistry>;
+
+    public:
+        void setEnabled(bool enable) { m_enabled = enable; }
+        bool isEnabled() const { return m_enabled; }
+
+        // creates the input on the first join, a later join with a context replaces it
+        std::shared_ptr<SharedInput> join(StreamIndex index, const std::string &streamName,
+                                          const std::string &jobKey, SubscribeContext *ctx,
+                                          const InputHint &hint);
+        void setHint(StreamIndex index, const std::string &jobKey, const InputHint &hint);
+        // tears the decoders down when jobKey was the last subscriber
+        void leave(StreamIndex index, const std::string &jobKey);
+
+        int pushVideo(SharedInput &input, const std::string &jobKey, MediaPacket &packet);
+        int pushAudio(SharedInput &input, const std::string &jobKey, MediaPacket &packet);
+
+        // jobs per shared stream name
+        std::map<std::string, int> getSubscriberCounts();
+        // splits the cpu of each shared input evenly over the jobs subscribed to it
+        void apportion(CpuUsage &usage);
+
+    private:
+        InputRegistry() : m_enabled(false) {}
+        ~InputRegistry();
+
+        static bool accept(SharedInput &input, const std::string &jobKey, MediaPacket &packet);
+        static void applyHint(SharedInput &input);
+        static void destroy(SharedInput &input);
+
+    private:
+        std::atomic<bool> m_enabled;
+        // guards the map only, lock order: m_mutex then SharedInput::m_mutex
+        std::mutex m_mutex;
+        std::unordered_map<StreamIndex, std::shared_ptr<SharedInput>> m_inputs;
+    };
+
+} // namespace hercules
@@ -14,6 +14,7 @@
 
 #include "Job.h"
 #include "Lua.h"
+#include "LuaPool.h"
 #include "Util.h"
 #include "Log.h"
 #include "Decoder.h"
@@ -21,7 +22,11 @@
 #include "AVFrameUtils.h"
 #include "Common.h"
 #include "AudioDecoder.h"
+#include "InputRegistry.h"
+#include "FrameBus.h"
+#include "FileInput.h"
 
+#include <algorithm>
 #include <string>
 #include <set>
 
@@ -33,17 +38,50 @@ namespace hercules
 
     Job::Job()
         : m_preUpdateTimeMs(getNowMs())
+        , m_createTimeMs(getNowMs())
+        , m_startTimeMs(getNowMs())
+        , m_firstFrameCostMs(-1)
+        , m_started(false)
+        , m_decodeQuality(DecodeQuality::FULL)
+        , m_outputFps(0)
+        , m_overloadLevel(OverloadLevel::NORMAL)
+        , m_sharedInput(InputRegistry::getInstance()->isEnabled())
+        , m_audioSampleRate(DEFAULT_SAMPLE_RATE)
+        , m_audioChannels(DEFAULT_CHANNEL_NUM)
+        , m_audioFrameSamples(DEFAULT_AUDIO_FRAME_SAMPLES)
+        , m_offline(false)
+        , m_offlineDone(false)
+        , m_clock(kOfflineClockStartMs)
+        , m_nextTickMs(0)
     {
+        m_streamIndexes = std::make_shared<std::unordered_map<std::string, StreamIndex>>();
     }
 
     Job::~Job()
     {
+        stopFileInputs();
+        {
+            std::unique_lock<std::mutex> lock(m_fileInputMutex);
+            for (auto input : m_fileInputs)
+            {
+                delete input;
+            }
+            m_fileInputs.clear();
+        }
         JobManager::getInstance()->removeJob(m_key);
+        FrameBus::getInstance()->leave(m_key);
+        leaveSharedInputs();
         for (auto decoder : m_decoders)
         {
             delete decoder.second;
         }
         m_decoders.clear();
+
+        // nothing of this job carries its indexes any more
+        for (const auto &kv : *m_streamIndexes)
+        {
+            StreamRegistry::getInstance()->release(kv.second);
+        }
     }
 
     int Job::init(const string &key, const string &name, const string &scriptName,
@@ -53,6 +91,7 @@ namespace hercules
         m_name = name;
         m_script = scriptName;
         m_dataCb = cb;
+        m_overload.setName(key);
         logInfo(MIXLOG << "script name: " + scriptName);
         return 0;
     }
@@ -65,21 +104,23 @@ namespace hercules
 
     int Job::addAVData(AVData &data)
     {
-        if (isStop())
+        if (isStop() || !m_started)
         {
             return EC_ERROR;
         }
+        // the caller may reuse one AVData for several streams, the name decides
+        StreamIndex index = streamIndex(data.m_streamName);
         int ret = EC_SUCCESS;
         switch (data.m_dataType)
         {
         case DATA_TYPE_FLV_AUDIO:
         {
-            ret = addAudioData(data);
+            ret = addAudioData(data, index);
         }
         break;
         case DATA_TYPE_FLV_VIDEO:
         {
-            ret = addVideoData(data);
+            ret = addVideoData(data, index);
         }
         break;
         default:
@@ -89,34 +130,79 @@ namespace hercules
         return ret;
     }
 
-    int Job::addAudioData(AVData &data)
+    StreamIndex Job::streamIndex(const std::string &streamName)
+    {
+        std::shared_ptr<const std::unordered_map<std::string, StreamIndex>> indexes = std::atomic_load(&m_streamIndexes);
+        auto iter = indexes->find(streamName);
+        if (iter != indexes->end())
+        {
+            return iter->second;
+        }
+
+        std::unique_lock<std::mutex> lockGuard(m_streamIndexMutex);
+        indexes = std::atomic_load(&m_streamIndexes);
+        iter = indexes->find(streamName);
+        if (iter != indexes->end())
+        {
+            return iter->second;
+        }
+        auto added = std::make_shared<std::unordered_map<std::string, StreamIndex>>(*indexes);
+        StreamIndex index = StreamRegistry::getInstance()->acquire(streamName);
+        (*added)[streamName] = index;
+        std::atomic_store(&m_streamIndexes, std::shared_ptr<const std::unordered_map<std::string, StreamIndex>>(added));
+        return index;
+    }
+
+    int Job::addAudioData(AVData &data, StreamIndex index)
     {
         logDebug(MIXLOG << data.m_streamName);
         int ret = EC_SUCCESS;
         AudioDecoderCtx *decoderCtx = nullptr;
-        auto it = m_audioDecoders.find(data.m_streamName);
-        if (it == m_audioDecoders.end())
+        bool shared = isSharedInput();
+        std::shared_ptr<SharedInput> sharedInput;
+        if (shared)
+        {
+            sharedInput = joinSharedInput(index, data.m_streamName, nullptr);
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(m_decoderMutex);
+            AudioDecoderCtx **found = m_audioDecoders.find(index);
+            if (found != nullptr)
+            {
+                decoderCtx = *found;
+            }
+        }
+        if (!shared && decoderCtx == nullptr)
         {
             logInfo(MIXLOG << "new decoder ctx");
             decoderCtx = new AudioDecoderCtx();
-            m_audioDecoders[data.m_streamName] = decoderCtx;
+            {
+                std::unique_lock<std::mutex> lock(m_decoderMutex);
+                m_audioDecoders[index] = decoderCtx;
+            }
             decoderCtx->m_decoder.init(m_key, &(decoderCtx->m_packetQueue));
             decoderCtx->m_resampler.subscribeAudioFrame();
             decoderCtx->m_decoder.addSubscriber(m_key, &(decoderCtx->m_resampler));
 
-            if (m_subCtxMap.find(data.m_streamName) != m_subCtxMap.end())
+            SubscribeContext *subCtx = findSubscribeContext(index);
+            if (subCtx != nullptr)
             {
                 logInfo(MIXLOG << "decoder ctx add subscriber" << data.m_streamName);
-                decoderCtx->m_resampler.addSubscriber(m_key, m_subCtxMap[data.m_streamName]);
+                decoderCtx->m_resampler.addSubscriber(m_key, subCtx);
             }
             decoderCtx->m_decoder.setStreamName(data.m_streamName);
             decoderCtx->m_resampler.setStreamName(data.m_streamName);
+            decoderCtx->m_resampler.setOutputFormat(m_audioSampleRate, m_audioChannels, m_audioFrameSamples);
+            watchOfflineQueue(&(decoderCtx->m_packetQueue));
+            watchOfflineQueue(decoderCtx->m_resampler.getAudioFrameQueue());
+            ThreadGroupGuard guard(m_key);
             decoderCtx->m_decoder.start();
             decoderCtx->m_resampler.start();
         }
-        else
+        if (m_offline)
         {
-            decoderCtx = m_audioDecoders[data.m_streamName];
+            waitOfflineBuffer(index, MediaType::AUDIO, data.m_dts);
         }
         MediaPacket packet;
         ret = MediaPacket::genMediaPacketFromFlvWithHeader(
@@ -126,6 +212,12 @@ namespace hercules
             ret = EC_ERROR;
             return ret;
         }
+        packet.setStreamIndex(index);
+        packet.addIdTimeTrace(index, TimeTraceKey::RECV, getNowMs32());
+        if (shared)
+        {
+            return InputRegistry::getInstance()->pushAudio(*sharedInput, m_key, packet);
+        }
         packet.setFrameId((decoderCtx->m_frameId)++);
         if (decoderCtx->m_packetQueue.push(packet.getDts(), packet))
         {
@@ -141,28 +233,57 @@ namespace hercules
         return ret;
     }
 
-    int Job::addVideoData(AVData &data)
+    int Job::addVideoData(AVData &data, StreamIndex index)
     {
         int ret = EC_SUCCESS;
         DecoderCtx *decoderCtx = nullptr;
-        auto it = m_decoders.find(data.m_streamName);
-        if (it == m_decoders.end())
+        bool shared = isSharedInput();
+        std::shared_ptr<SharedInput> sharedInput;
+        if (shared)
+        {
+            sharedInput = joinSharedInput(index, data.m_streamName, nullptr);
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(m_decoderMutex);
+            DecoderCtx **found = m_decoders.find(index);
+            if (found != nullptr)
+            {
+                decoderCtx = *found;
+            }
+        }
+        if (!shared && decoderCtx == nullptr)
         {
             logInfo(MIXLOG << "new decoderCtx");
             decoderCtx = new DecoderCtx();
-            m_decoders[data.m_streamName] = decoderCtx;
+            {
+                std::unique_lock<std::mutex> lock(m_decoderMutex);
+                m_decoders[index] = decoderCtx;
+                StreamHint *hint = m_streamHints.find(index);
+                if (hint != nullptr)
+                {
+                    decoderCtx->m_decoder.setVisible(hint->m_visible);
+                    decoderCtx->m_decoder.setDisplaySize(hint->m_width, hint->m_height);
+                }
+                decoderCtx->m_decoder.setOutputFps(m_outputFps);
+                decoderCtx->m_decoder.setOverloaded(m_overloadLevel >= OverloadLevel::LOW_DECODE);
+            }
+            decoderCtx->m_decoder.setDecodeQuality(m_decodeQuality);
             decoderCtx->m_decoder.init(m_key, &(decoderCtx->m_packetQueue));
-            if (m_subCtxMap.find(data.m_streamName) != m_subCtxMap.end())
+            SubscribeContext *subCtx = findSubscribeContext(index);
+            if (subCtx != nullptr)
             {
                 logInfo(MIXLOG << "decoderCtx addSubscriber");
-                decoderCtx->m_decoder.addSubscriber(m_key, m_subCtxMap[data.m_streamName]);
+                decoderCtx->m_decoder.addSubscriber(m_key, subCtx);
             }
             decoderCtx->m_decoder.setStreamName(data.m_streamName);
+            watchOfflineQueue(&(decoderCtx->m_packetQueue));
+            ThreadGroupGuard guard(m_key);
             decoderCtx->m_decoder.start();
         }
-        else
+        if (m_offline)
         {
-            decoderCtx = m_decoders[data.m_streamName];
+            waitOfflineBuffer(index, MediaType::VIDEO, data.m_dts);
         }
         MediaPacket packet;
         ret = MediaPacket::genMediaPacketFromFlvWithHeader(
@@ -172,7 +293,12 @@ namespace hercules
             ret = EC_ERROR;
             return ret;
         }
-        packet.setFrameId((decoderCtx->m_frameId)++);
+        if (!shared)
+        {
+            packet.setFrameId((decoderCtx->m_frameId)++);
+        }
+        packet.setStreamIndex(index);
+        packet.addIdTimeTrace(index, TimeTraceKey::RECV, getNowMs32());
         logDebug(MIXLOG << "frametype:" << static_cast<int>(packet.getFrameType()) 
             << ", frameid:" << packet.getFrameId() << ", ret" << ret);
         if (packet.isIFrame() && !packet.isHeaderFrame())
@@ -188,6 +314,10 @@ namespace hercules
                 logWarn(MIXLOG << "parse avcconfig fail");
             }
         }
+        if (shared)
+        {
+            return InputRegistry::getInstance()->pushVideo(*sharedInput, m_key, packet);
+        }
         if (decoderCtx->m_packetQueue.push(packet.getDts(), packet))
         {
             logDebug(MIXLOG << "push success"
@@ -202,6 +332,56 @@ namespace hercules
         return ret;
     }
 
+    // offline updates wait for their media time, so a render does not depend on
+    // how fast it ran when they arrived
+    bool Job::isJsonDue(const Json::Value &value) const
+    {
+        if (!m_offline || !value.isObject() || !value.isMember(kOfflineMediaTimeKey))
+        {
+            return true;
+        }
+        return value[kOfflineMediaTimeKey].asUInt() + kOfflineClockStartMs <= m_clock.nowMs();
+    }
+
+    // a layout update is a full snapshot, so queued ones behind it are superseded,
+    // commands in between keep their order
+    bool Job::popJson(Json::Value &value, size_t timeoutMs)
+    {
+        if (!getJsonQueue().pop_front(value, timeoutMs))
+        {
+            return false;
+        }
+        if (!isJsonDue(value))
+        {
+            getJsonQueue().push_front(value, false);
+            return false;
+        }
+
+        uint32_t merged = 0;
+        Json::Value next;
+        while (LayoutModel::isLayout(value) && getJsonQueue().pop_front(next, 0))
+        {
+            if (!LayoutModel::isLayout(next) || !isJsonDue(next))
+            {
+                getJsonQueue().push_front(next, false);
+                break;
+            }
+            value.swap(next);
+            ++merged;
+        }
+        if (value.isObject())
+        {
+            value.removeMember(kOfflineMediaTimeKey);
+        }
+
+        if (merged > 0)
+        {
+            logInfo(MIXLOG << "key: " << m_key << ", merge superseded layout: " << merged);
+        }
+
+        return true;
+    }
+
     void Job::threadEntry()
     {
         luaJob();
@@ -213,28 +393,39 @@ namespace hercules
         string name = m_name;
         string key = m_key;
 
-        logInfo(MIXLOG << "thread start: " << key << ", name: " << name);
+        logInfo(MIXLOG << "thread start: " << key << ", name: " << name
+            << ", offline: " << m_offline);
+
+        if (m_offline)
+        {
+            VirtualClock::setCurrent(&m_clock);
+        }
 
         try
         {
-            lua = new Lua;
-            lua->initScript(m_script);
+            lua = LuaPool::getInstance()->acquire(m_script);
+            logInfo(MIXLOG << "key: " << key << ", vm ready cost: " << getNowMs() - m_startTimeMs);
 
-            string sJson;
+            Json::Value value;
             while (!isStop())
             {
-                if (getJsonQueue().pop_front(sJson, 100))
+                if (getJsonQueue().pop_front(value, 100))
                 {
                     break;
                 }
             }
 
+            if (value.isObject())
+            {
+                value.removeMember(kOfflineMediaTimeKey);
+            }
             logInfo(MIXLOG << name << " is stop:" << isStop());
-            logInfo(MIXLOG << name << " init first json: " << sJson);
+            logInfo(MIXLOG << name << " init first json: " << Json::FastWriter().write(value));
 
             if (!isStop())
             {
-                if (0 != lua->start(key, name, sJson))
+                m_layout.reset(value);
+                if (0 != lua->start(key, name, value))
                 {
                     logErr(MIXLOG << "error" 
                         << ", key: " << key << ", name: " << name << ", start fail");
@@ -244,9 +435,26 @@ namespace hercules
 
             while (!isStop())
             {
-                if (getJsonQueue().pop_front(sJson, 10))
+                if (popJson(value, m_offline ? 0 : 10))
                 {
-                    if (lua->update(key, name, sJson) != 0)
+                    int ret = 0;
+                    if (LayoutModel::isLayout(value))
+                    {
+                        Json::Value diff;
+                        int changes = m_layout.update(value, diff);
+                        logInfo(MIXLOG << "key: " << key << ", layout changes: " << changes
+                            << ", entries: " << m_layout.size());
+                        if (changes > 0)
+                        {
+                            ret = lua->updateLayout(key, name, diff);
+                        }
+                    }
+                    else
+                    {
+                        ret = lua->update(key, name, value);
+                    }
+
+                    if (ret != 0)
                     {
                         logErr(MIXLOG << "error"
                             << ", key: " << key << ", name: " << name << ", update fail");
@@ -255,6 +463,14 @@ namespace hercules
                     }
                 }
 
+                if (m_offline && !waitOfflineInput())
+                {
+                    drainOfflineOutput();
+                    logInfo(MIXLOG << "offline render done, key: " << key
+                        << ", media time: " << m_clock.nowMs() - kOfflineClockStartMs);
+                    break;
+                }
+
                 if (lua->process() != 0)
                 {
                     logErr(MIXLOG << "error"
@@ -262,10 +478,20 @@ namespace hercules
 
                     break;
                 }
+
+                if (m_offline)
+                {
+                    // inputs are taken on mix ticks, nothing happens in between
+                    uint32_t nowMs = m_clock.nowMs();
+                    uint32_t nextMs = m_nextTickMs.exchange(0);
+                    m_clock.advance(nextMs > nowMs ? nextMs - nowMs : kOfflineClockStepMs);
+                }
             }
 
             stopDecoder();
             lua->stop();
+            // the queues belong to the script and go away with it
+            m_outputQueues.clear();
         }
         catch (exception &ex)
         {
@@ -281,11 +507,20 @@ namespace hercules
         if (lua)
         {
             delete lua;
+            LuaPool::getInstance()->release(m_script);
+        }
+
+        if (m_offline)
+        {
+            VirtualClock::setCurrent(nullptr);
+            m_offlineDone = true;
         }
     }
 
     void Job::stopDecoder()
     {
+        FrameBus::getInstance()->leave(m_key);
+
         std::set<DecoderCtx *> deleteDecoders;
         std::set<AudioDecoderCtx *> deleteAudioDecoders;
 
@@ -315,12 +550,77 @@ namespace hercules
             decoder->m_decoder.join();
             delete decoder;
         }
+
+        leaveSharedInputs();
+    }
+
+    std::shared_ptr<SharedInput> Job::joinSharedInput(StreamIndex index, const std::string &streamName,
+                                                      SubscribeContext *ctx)
+    {
+        InputHint hint;
+        {
+            std::unique_lock<std::mutex> lock(m_decoderMutex);
+            std::shared_ptr<SharedInput> *joined = m_sharedInputs.find(index);
+            if (joined != nullptr && ctx == nullptr)
+            {
+                return *joined;
+            }
+            hint = inputHint(index);
+        }
+        std::shared_ptr<SharedInput> input = InputRegistry::getInstance()->join(index, streamName, m_key, ctx, hint);
+        std::unique_lock<std::mutex> lock(m_decoderMutex);
+        m_sharedInputs[index] = input;
+        return input;
+    }
+
+    void Job::leaveSharedInputs()
+    {
+        FlatStreamMap<std::shared_ptr<SharedInput>> joined;
+        {
+            std::unique_lock<std::mutex> lock(m_decoderMutex);
+            joined = m_sharedInputs;
+            m_sharedInputs.clear();
+        }
+        for (const auto &input : joined)
+        {
+            InputRegistry::getInstance()->leave(input.first, m_key);
+        }
+    }
+
+    InputHint Job::inputHint(StreamIndex index)
+    {
+        InputHint hint;
+        StreamHint *stream = m_streamHints.find(index);
+        if (stream != nullptr)
+        {
+            hint.m_visible = stream->m_visible;
+            hint.m_width = stream->m_width;
+            hint.m_height = stream->m_height;
+        }
+        hint.m_outputFps = m_outputFps;
+        hint.m_overloaded = m_overloadLevel >= OverloadLevel::LOW_DECODE;
+        hint.m_quality = m_decodeQuality;
+        return hint;
+    }
+
+    void Job::syncSharedInputs()
+    {
+        for (const auto &input : m_sharedInputs)
+        {
+            InputRegistry::getInstance()->setHint(input.first, m_key, inputHint(input.first));
+        }
     }
 
     void Job::sendData(const AVData &data)
     {
         if (!isStop())
         {
+            if (data.m_dataType == DATA_TYPE_FLV_VIDEO && m_firstFrameCostMs < 0)
+            {
+                m_firstFrameCostMs = getNowMs() - m_startTimeMs;
+                logInfo(MIXLOG << "key: " << m_key << ", start to first frame cost: " << m_firstFrameCostMs);
+            }
+
             if (m_dataCb)
             {
                 m_dataCb(data);
@@ -331,21 +631,422 @@ namespace hercules
     void Job::subscribeJobFrame(const std::string &streamName, SubscribeContext *ctx)
     {
         logInfo(MIXLOG << "job subscribe job frame task id: " + m_key);
+        // offline jobs mix on media time and wait for their inputs instead
+        ctx->setJitterBuffer(!m_offline);
+        StreamIndex index = streamIndex(streamName);
+        FrameBus::getInstance()->subscribe(index, m_key, ctx);
+        if (isSharedInput())
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_subMutex);
+                m_subCtxMap[index] = ctx;
+            }
+            joinSharedInput(index, streamName, ctx);
+            return;
+        }
+
         std::unique_lock<std::mutex> lock(m_subMutex);
-        m_subCtxMap[streamName] = ctx;
+        m_subCtxMap[index] = ctx;
+        watchOfflineQueue(ctx->getVideoFrameQueue());
+        watchOfflineQueue(ctx->getAudioFrameQueue());
+        m_offlineSignal.notify();
 
-        auto videoDecoder = m_decoders.find(streamName);
-        if (videoDecoder != m_decoders.end())
+        std::unique_lock<std::mutex> decoderLock(m_decoderMutex);
+        DecoderCtx **videoDecoder = m_decoders.find(index);
+        if (videoDecoder != nullptr)
         {
             logInfo(MIXLOG << "decoder add subscriber: " << ctx->m_streamName);
-            m_decoders[streamName]->m_decoder.addSubscriber(m_key, ctx);
+            (*videoDecoder)->m_decoder.addSubscriber(m_key, ctx);
         }
 
-        auto audioDecoder = m_audioDecoders.find(streamName);
-        if (audioDecoder != m_audioDecoders.end())
+        AudioDecoderCtx **audioDecoder = m_audioDecoders.find(index);
+        if (audioDecoder != nullptr)
         {
             logInfo(MIXLOG << "audio decoder add subscriber: " << ctx->m_streamName);
-            m_audioDecoders[streamName]->m_decoder.addSubscriber(m_key, ctx);
+            (*audioDecoder)->m_decoder.addSubscriber(m_key, ctx);
+        }
+    }
+
+    int Job::publishFrame(const std::string &streamName, MediaFrame &frame, MediaType type)
+    {
+        StreamIndex index = streamIndex(streamName);
+        return FrameBus::getInstance()->publish(index, m_key, frame, type);
+    }
+
+    void Job::setStreamVisible(const std::string &streamName, bool visible)
+    {
+        // offline pacing waits on every input queue, a suspended decoder would stall it
+        if (m_offline)
+        {
+            return;
+        }
+        StreamIndex index = streamIndex(streamName);
+        std::unique_lock<std::mutex> lock(m_decoderMutex);
+        m_streamHints[index].m_visible = visible;
+        syncSharedInputs();
+        DecoderCtx **decoder = m_decoders.find(index);
+        if (decoder != nullptr)
+        {
+            (*decoder)->m_decoder.setVisible(visible);
+        }
+    }
+
+    void Job::setStreamDisplaySize(const std::string &streamName, int width, int height)
+    {
+        StreamIndex index = streamIndex(streamName);
+        std::unique_lock<std::mutex> lock(m_decoderMutex);
+        StreamHint &hint = m_streamHints[index];
+        hint.m_width = width;
+        hint.m_height = height;
+        syncSharedInputs();
+        DecoderCtx **decoder = m_decoders.find(index);
+        if (decoder != nullptr)
+        {
+            (*decoder)->m_decoder.setDisplaySize(width, height);
+        }
+    }
+
+    int Job::reportMixTick(int lateMs, int frameMs, int queueDepth)
+    {
+        // offline ticks run as fast as inputs allow, they are never late
+        if (m_offline)
+        {
+            return static_cast<int>(OverloadLevel::NORMAL);
+        }
+
+        uint64_t nowMs = getNowMs();
+        m_overload.onTick(lateMs * 2 > frameMs, queueDepth, nowMs);
+        OverloadLevel level = std::max(m_overload.getLevel(), ProcessOverload::getInstance()->getLevel(nowMs));
+
+        std::unique_lock<std::mutex> lock(m_decoderMutex);
+        if (level != m_overloadLevel)
+        {
+            logInfo(MIXLOG << "key: " << m_key << ", mix level: " << static_cast<int>(m_overloadLevel)
+                << " -> " << static_cast<int>(level));
+            bool overloaded = level >= OverloadLevel::LOW_DECODE;
+            bool changed = overloaded != (m_overloadLevel >= OverloadLevel::LOW_DECODE);
+            m_overloadLevel = level;
+            if (changed)
+            {
+                for (auto &decoder : m_decoders)
+                {
+                    decoder.second->m_decoder.setOverloaded(overloaded);
+                }
+                syncSharedInputs();
+            }
+        }
+        return static_cast<int>(level);
+    }
+
+    OverloadStats Job::getOverloadStats() const
+    {
+        return m_overload.getStats();
+    }
+
+    std::map<std::string, JitterStats> Job::getJitterStats()
+    {
+        std::map<std::string, JitterStats> stats;
+        std::unique_lock<std::mutex> lock(m_subMutex);
+        for (const auto &kv : m_subCtxMap)
+        {
+            if (kv.second != nullptr)
+            {
+                stats[StreamRegistry::getInstance()->getName(kv.first)] = kv.second->getJitterStats();
+            }
+        }
+        return stats;
+    }
+
+    std::map<std::string, DecodeStats> Job::getDecodeStats()
+    {
+        std::map<std::string, DecodeStats> stats;
+        FlatStreamMap<std::shared_ptr<SharedInput>> shared;
+        {
+            std::unique_lock<std::mutex> lock(m_decoderMutex);
+            for (const auto &kv : m_decoders)
+            {
+                stats[StreamRegistry::getInstance()->getName(kv.first)] = kv.second->m_decoder.getDecodeStats();
+            }
+            shared = m_sharedInputs;
+        }
+        for (const auto &kv : shared)
+        {
+            std::unique_lock<std::mutex> lock(kv.second->m_mutex);
+            if (kv.second->m_video != nullptr)
+            {
+                stats[kv.second->m_streamName] = kv.second->m_video->m_decoder.getDecodeStats();
+            }
+        }
+        return stats;
+    }
+
+    void Job::setOutputFps(int fps)
+    {
+        logInfo(MIXLOG << "key: " << m_key << ", output fps: " << fps);
+        std::unique_lock<std::mutex> lock(m_decoderMutex);
+        m_outputFps = fps;
+        for (auto &decoder : m_decoders)
+        {
+            decoder.second->m_decoder.setOutputFps(fps);
+        }
+        syncSharedInputs();
+    }
+
+    void Job::setAudioOutput(int sampleRate, int channels, int frameSamples)
+    {
+        logInfo(MIXLOG << "key: " << m_key << ", audio output sample rate: " << sampleRate
+            << ", channels: " << channels << ", frame samples: " << frameSamples);
+        {
+            std::unique_lock<std::mutex> lock(m_decoderMutex);
+            m_audioSampleRate = sampleRate;
+            m_audioChannels = channels;
+            m_audioFrameSamples = frameSamples;
+            for (const auto &decoder : m_audioDecoders)
+            {
+                decoder.second->m_resampler.setOutputFormat(sampleRate, channels, frameSamples);
+            }
+        }
+
+        bool custom = sampleRate != DEFAULT_SAMPLE_RATE || channels != DEFAULT_CHANNEL_NUM
+            || frameSamples != DEFAULT_AUDIO_FRAME_SAMPLES;
+        if (custom && m_sharedInput.exchange(false))
+        {
+            // the shared resamplers produce the default format only
+            leaveSharedInputs();
+        }
+    }
+
+    SubscribeContext *Job::findSubscribeContext(StreamIndex index)
+    {
+        std::unique_lock<std::mutex> lock(m_subMutex);
+        SubscribeContext **ctx = m_subCtxMap.find(index);
+        return ctx != nullptr ? *ctx : nullptr;
+    }
+
+    void Job::registerOutput(Queue<MediaFrame> *queue)
+    {
+        // only offline renders hold the mixer back on busy outputs
+        if (!m_offline || std::find(m_outputQueues.begin(), m_outputQueues.end(), queue) != m_outputQueues.end())
+        {
+            return;
+        }
+        logInfo(MIXLOG << "job register output, task id: " << m_key);
+        m_outputQueues.push_back(queue);
+        watchOfflineQueue(queue);
+    }
+
+    void Job::endInput(const std::string &streamName)
+    {
+        if (!m_offline)
+        {
+            return;
+        }
+        logInfo(MIXLOG << "offline input end, task id: " << m_key << ", stream: " << streamName);
+        {
+            std::unique_lock<std::mutex> lock(m_offlineMutex);
+            m_offlineInputs[streamIndex(streamName)].m_ended = true;
+        }
+        m_offlineSignal.notify();
+    }
+
+    int Job::addFileInput(const std::string &streamName, const std::string &fileName,
+                          bool loop, bool realtime)
+    {
+        if (isStop())
+        {
+            return EC_ERROR;
+        }
+        logInfo(MIXLOG << "add file input, task id: " << m_key << ", stream: " << streamName
+            << ", file: " << fileName);
+        FileInput *input = new FileInput(this, streamName, fileName, loop, realtime);
+        {
+            std::unique_lock<std::mutex> lock(m_fileInputMutex);
+            m_fileInputs.push_back(input);
+        }
+        ThreadGroupGuard guard(m_key);
+        input->start();
+        return EC_SUCCESS;
+    }
+
+    void Job::stopFileInputs()
+    {
+        std::unique_lock<std::mutex> lock(m_fileInputMutex);
+        for (auto input : m_fileInputs)
+        {
+            input->stop();
+        }
+    }
+
+    void Job::markOfflineInput(StreamIndex index, MediaType type, uint32_t dts)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_offlineMutex);
+            OfflineInput &input = m_offlineInputs[index];
+            if (type == MediaType::VIDEO)
+            {
+                input.m_hasVideo = true;
+                input.m_videoDts = dts;
+            }
+            else if (type == MediaType::AUDIO)
+            {
+                input.m_hasAudio = true;
+                input.m_audioDts = dts;
+            }
+        }
+        m_offlineSignal.notify();
+    }
+
+    Queue<MediaFrame> *Job::findSubscribedQueue(StreamIndex index, MediaType type)
+    {
+        SubscribeContext *ctx = findSubscribeContext(index);
+        if (ctx == nullptr)
+        {
+            return nullptr;
+        }
+        if (type == MediaType::VIDEO)
+        {
+            return ctx->getVideoFrameQueue();
+        }
+        return ctx->getAudioFrameQueue();
+    }
+
+    size_t Job::offlineBuffered(StreamIndex index, MediaType type)
+    {
+        size_t buffered = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_decoderMutex);
+            if (type == MediaType::VIDEO)
+            {
+                DecoderCtx **decoder = m_decoders.find(index);
+                if (decoder != nullptr)
+                {
+                    buffered += (*decoder)->m_packetQueue.size();
+                }
+            }
+            else
+            {
+                AudioDecoderCtx **decoder = m_audioDecoders.find(index);
+                if (decoder != nullptr)
+                {
+                    buffered += (*decoder)->m_packetQueue.size();
+                    Queue<MediaFrame> *resampleQueue = (*decoder)->m_resampler.getAudioFrameQueue();
+                    if (resampleQueue != nullptr)
+                    {
+                        buffered += resampleQueue->size();
+                    }
+                }
+            }
+        }
+
+        Queue<MediaFrame> *frameQueue = findSubscribedQueue(index, type);
+        if (frameQueue != nullptr)
+        {
+            buffered += frameQueue->size();
+        }
+
+        return buffered;
+    }
+
+    void Job::waitOfflineBuffer(StreamIndex index, MediaType type, uint32_t dts)
+    {
+        // waits for the script to subscribe so no early frame is dropped
+        markOfflineInput(index, type, dts);
+        while (!isStop())
+        {
+            uint64_t seq = m_offlineSignal.seq();
+            if (offlineBuffered(index, type) < kOfflineMaxBufferedFrames
+                && (findSubscribedQueue(index, type) != nullptr
+                    || getNowMs() >= m_createTimeMs + kOfflineSubscribeWaitMs))
+            {
+                return;
+            }
+            m_offlineSignal.waitFor(seq, kOfflineWaitMs);
+        }
+    }
+
+    bool Job::isOfflineOutputBusy(size_t limit)
+    {
+        for (const auto &queue : m_outputQueues)
+        {
+            if (queue->size() >= limit)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Job::waitOfflineInput()
+    {
+        while (!isStop())
+        {
+            uint64_t seq = m_offlineSignal.seq();
+            bool ready = true;
+            bool ended = true;
+            {
+                std::unique_lock<std::mutex> lock(m_offlineMutex);
+                ready = !m_offlineInputs.empty();
+                ended = !m_offlineInputs.empty();
+                for (const auto &kv : m_offlineInputs)
+                {
+                    StreamIndex index = kv.first;
+                    const OfflineInput &input = kv.second;
+                    // a track the feeder left behind in media time will not catch up
+                    bool videoDone = input.m_ended
+                        || (input.m_hasAudio && input.m_audioDts > input.m_videoDts + kOfflineTrackGapMs);
+                    bool audioDone = input.m_ended
+                        || (input.m_hasVideo && input.m_videoDts > input.m_audioDts + kOfflineTrackGapMs);
+
+                    Queue<MediaFrame> *videoQueue = findSubscribedQueue(index, MediaType::VIDEO);
+                    Queue<MediaFrame> *audioQueue = findSubscribedQueue(index, MediaType::AUDIO);
+                    bool videoStarving = input.m_hasVideo && videoQueue != nullptr && videoQueue->empty();
+                    bool audioStarving = input.m_hasAudio && audioQueue != nullptr && audioQueue->empty();
+                    if ((videoStarving && !videoDone) || (audioStarving && !audioDone))
+                    {
+                        ready = false;
+                    }
+
+                    if (!input.m_ended || offlineBuffered(index, MediaType::VIDEO) != 0
+                        || offlineBuffered(index, MediaType::AUDIO) != 0)
+                    {
+                        ended = false;
+                    }
+                }
+            }
+
+            if (ended)
+            {
+                logInfo(MIXLOG << "all offline inputs ended, task id: " << m_key);
+                return false;
+            }
+
+            if (ready && !isOfflineOutputBusy(kOfflineMaxOutputFrames))
+            {
+                return true;
+            }
+
+            m_offlineSignal.waitFor(seq, kOfflineWaitMs);
+        }
+
+        return false;
+    }
+
+    void Job::drainOfflineOutput()
+    {
+        uint64_t startMs = getNowMs();
+        while (!isStop())
+        {
+            uint64_t seq = m_offlineSignal.seq();
+            if (!isOfflineOutputBusy(1))
+            {
+                break;
+            }
+            if (getNowMs() > startMs + kOfflineDrainTimeoutMs)
+            {
+                logWarn(MIXLOG << "drain offline output timeout, task id: " << m_key);
+                break;
+            }
+            m_offlineSignal.waitFor(seq, kOfflineWaitMs);
         }
     }
 
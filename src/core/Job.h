@@ -24,18 +24,48 @@
 #include "Decoder.h"
 #include "AudioDecoder.h"
 #include "AudioResampler.h"
+#include "LayoutModel.h"
+#include "OverloadControl.h"
 
+#include "json/json.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <vector>
 #include <queue>
 #include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 
 namespace hercules
 {
 
     constexpr int kJobTimeoutMs = 10000;
 
+    // offline render: virtual clock starts here and jumps to the next mix tick the
+    // script reports after each process(), one step when it reports none
+    constexpr uint32_t kOfflineClockStartMs = 1000;
+    constexpr uint32_t kOfflineClockStepMs = 1;
+    // offline updates carry the media time they apply at, stamped on arrival if missing
+    constexpr const char *kOfflineMediaTimeKey = "media_time_ms";
+    // offline waits wake on queue changes, this bounds how late they see a stop
+    constexpr uint32_t kOfflineWaitMs = 100;
+    // feeders wait this long (wall time) for the script to subscribe their input
+    constexpr uint64_t kOfflineSubscribeWaitMs = 3000;
+    // a track this far behind the other track of its input in media time has
+    // ended, flv files often stop audio before video
+    constexpr uint32_t kOfflineTrackGapMs = 2000;
+    // backpressure watermarks, feeders block in addAVData above these
+    constexpr size_t kOfflineMaxBufferedFrames = 100;
+    constexpr size_t kOfflineMaxOutputFrames = 30;
+    constexpr uint64_t kOfflineDrainTimeoutMs = 10000;
+
     class Lua;
+    class FileInput;
+    struct SharedInput;
+    struct InputHint;
 
     struct DecoderCtx
     {
@@ -58,6 +88,29 @@ namespace hercules
         AudioResampler m_resampler;
     };
 
+    struct OfflineInput
+    {
+        OfflineInput() : m_hasVideo(false), m_hasAudio(false), m_ended(false), m_videoDts(0), m_audioDts(0)
+        {
+        }
+        bool m_hasVideo;
+        bool m_hasAudio;
+        bool m_ended;       // set by endInput
+        uint32_t m_videoDts; // last dts fed
+        uint32_t m_audioDts;
+    };
+
+    // what the layout last said about an input, kept for decoders created later
+    struct StreamHint
+    {
+        StreamHint() : m_visible(true), m_width(0), m_height(0)
+        {
+        }
+        bool m_visible;
+        int m_width;
+        int m_height;
+    };
+
     class Job : public MixTask
     {
     public:
@@ -71,7 +124,25 @@ namespace hercules
 
         void destroy() {}
 
-        bool isTimeout() const { return m_preUpdateTimeMs + kJobTimeoutMs < getNowMs(); }
+        bool isTimeout() const
+        {
+            // a queued job lives on its updates even when offline, so an abandoned one goes
+            if (m_offline && m_started)
+            {
+                return m_offlineDone;
+            }
+            return m_preUpdateTimeMs + kJobTimeoutMs < getNowMs();
+        }
+
+        void setOffline(bool offline) { m_offline = offline; }
+        bool isOffline() const { return m_offline; }
+        // live jobs decode their inputs through InputRegistry
+        bool isSharedInput() const { return m_sharedInput && !m_offline; }
+        void setDecodeQuality(DecodeQuality quality) { m_decodeQuality = quality; }
+        void registerOutput(Queue<MediaFrame> *queue);
+
+        // -1 until the first video tag is sent
+        int64_t getFirstFrameCostMs() const { return m_firstFrameCostMs; }
 
         void updateJson(const std::string &sJson) { pushJson(sJson); }
 
@@ -79,16 +150,55 @@ namespace hercules
 
         void pushJson(const std::string &sJson)
         {
-            getJsonQueue().push_back(sJson);
+            Json::Reader tReader;
+            Json::Value tValue;
+            if (!tReader.parse(sJson, tValue))
+            {
+                logErr(MIXLOG << "error invalid json, key: " << m_key);
+                return;
+            }
+            pushJson(tValue);
+        }
+
+        void pushJson(const Json::Value &value)
+        {
+            if (m_offline && value.isObject() && !value.isMember(kOfflineMediaTimeKey))
+            {
+                Json::Value stamped = value;
+                stamped[kOfflineMediaTimeKey] = m_clock.nowMs() - kOfflineClockStartMs;
+                getJsonQueue().push_back(stamped);
+            }
+            else
+            {
+                getJsonQueue().push_back(value);
+            }
             m_preUpdateTimeMs = getNowMs();
         }
 
         void start()
         {
             logInfo(MIXLOG << "job start: " << m_name);
+            m_startTimeMs = getNowMs();
+            {
+                std::unique_lock<std::mutex> lock(m_startMutex);
+                m_started = true;
+            }
+            m_startCond.notify_all();
+            ThreadGroupGuard guard(m_key);
             OneCycleThread::startThread("luaJob:" + m_name);
         }
 
+        // false while the job waits in the admission queue
+        bool isStarted() const { return m_started; }
+        // blocks until the job starts or stops, false on timeout or stop
+        bool waitStarted(uint32_t timeoutMs)
+        {
+            std::unique_lock<std::mutex> lock(m_startMutex);
+            m_startCond.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                 [this]() { return m_started || isStop(); });
+            return m_started;
+        }
+
         bool canStop()
         {
             return isTimeout();
@@ -97,7 +207,14 @@ namespace hercules
         void stop()
         {
             logInfo(MIXLOG << "job stop: " << m_key);
+            stopFileInputs();
             OneCycleThread::stopThread();
+            m_offlineSignal.notify();
+            {
+                // a waiter between its check and its wait would miss the notify
+                std::unique_lock<std::mutex> lock(m_startMutex);
+            }
+            m_startCond.notify_all();
         }
 
         void join()
@@ -106,15 +223,69 @@ namespace hercules
         }
 
         void subscribeJobFrame(const std::string &streamName, SubscribeContext *ctx);
+        // hands a mixed frame to the jobs pulling streamName, see FrameBus
+        int publishFrame(const std::string &streamName, MediaFrame &frame, MediaType type);
+        void setStreamVisible(const std::string &streamName, bool visible);
+        void setStreamDisplaySize(const std::string &streamName, int width, int height);
+        void setOutputFps(int fps);
+        // format the audio of every input is resampled to before mixing, jobs that
+        // differ from the default decode their inputs privately
+        void setAudioOutput(int sampleRate, int channels, int frameSamples);
+        // virtual time of the script's next mix tick, offline clocks jump there
+        void setNextTick(uint32_t ms) { m_nextTickMs = ms; }
+        // called by the mix tick, returns the level the mixer should run at
+        int reportMixTick(int lateMs, int frameMs, int queueDepth);
+        OverloadStats getOverloadStats() const;
+        // per input stream name
+        std::map<std::string, JitterStats> getJitterStats();
+        // per input stream name, shared inputs count for every job pulling them
+        std::map<std::string, DecodeStats> getDecodeStats();
 
         int addAVData(AVData &data);
+        void endInput(const std::string &streamName);
+        int addFileInput(const std::string &streamName, const std::string &fileName,
+                         bool loop, bool realtime);
         void sendData(const AVData &data);
 
     private:
-        int addVideoData(AVData &data);
-        int addAudioData(AVData &data);
+        int addVideoData(AVData &data, StreamIndex index);
+        int addAudioData(AVData &data, StreamIndex index);
+
+        SubscribeContext *findSubscribeContext(StreamIndex index);
+        // lock free once the job has seen the name, the job holds it in the registry until it is gone
+        StreamIndex streamIndex(const std::string &streamName);
+
+        std::shared_ptr<SharedInput> joinSharedInput(StreamIndex index, const std::string &streamName,
+                                                     SubscribeContext *ctx);
+        void leaveSharedInputs();
+        // callers hold m_decoderMutex
+        InputHint inputHint(StreamIndex index);
+        void syncSharedInputs();
 
-        ThreadQueue<std::string> &getJsonQueue() { return m_jsonQueue; }
+        void markOfflineInput(StreamIndex index, MediaType type, uint32_t dts);
+        Queue<MediaFrame> *findSubscribedQueue(StreamIndex index, MediaType type);
+        size_t offlineBuffered(StreamIndex index, MediaType type);
+        void waitOfflineBuffer(StreamIndex index, MediaType type, uint32_t dts);
+        bool waitOfflineInput();
+        bool isOfflineOutputBusy(size_t limit);
+        void drainOfflineOutput();
+
+        // offline waits wake up on any change of the queues they look at
+        template <typename T>
+        void watchOfflineQueue(Queue<T> *queue)
+        {
+            if (m_offline && queue != nullptr)
+            {
+                queue->setSignal(&m_offlineSignal);
+                queue->setPopSignal(&m_offlineSignal);
+            }
+        }
+
+        bool isJsonDue(const Json::Value &value) const;
+        bool popJson(Json::Value &value, size_t timeoutMs);
+        void stopFileInputs();
+
+        ThreadQueue<Json::Value> &getJsonQueue() { return m_jsonQueue; }
         void threadEntry();
         void luaJob();
 
@@ -122,17 +293,51 @@ namespace hercules
         std::string m_key;
         std::string m_name;
         std::string m_script;
-        ThreadQueue<std::string> m_jsonQueue;
+        ThreadQueue<Json::Value> m_jsonQueue;
+        LayoutModel m_layout;
 
         uint64_t m_preUpdateTimeMs;
+        uint64_t m_createTimeMs;
+        uint64_t m_startTimeMs;
+        std::atomic<int64_t> m_firstFrameCostMs;
+        std::atomic<bool> m_started;
+        std::mutex m_startMutex;
+        std::condition_variable m_startCond;
+
+        std::mutex m_fileInputMutex;
+        std::vector<FileInput *> m_fileInputs;
 
+        // copied on a new name, read with atomic_load
+        std::mutex m_streamIndexMutex;
+        std::shared_ptr<const std::unordered_map<std::string, StreamIndex>> m_streamIndexes;
+
+        // keyed by interned stream name, see StreamRegistry
         std::mutex m_decoderMutex;
-        std::map<std::string, DecoderCtx *> m_decoders;
-        std::map<std::string, AudioDecoderCtx *> m_audioDecoders;
+        FlatStreamMap<DecoderCtx *> m_decoders;
+        FlatStreamMap<StreamHint> m_streamHints;
+        DecodeQuality m_decodeQuality;
+        int m_outputFps;
+        OverloadController m_overload;
+        OverloadLevel m_overloadLevel;
+        FlatStreamMap<AudioDecoderCtx *> m_audioDecoders;
+        std::atomic<bool> m_sharedInput;
+        int m_audioSampleRate;
+        int m_audioChannels;
+        int m_audioFrameSamples;
+        FlatStreamMap<std::shared_ptr<SharedInput>> m_sharedInputs;
         std::mutex m_subMutex;
-        std::map<std::string, SubscribeContext *> m_subCtxMap;
+        FlatStreamMap<SubscribeContext *> m_subCtxMap;
 
         DataCallback m_dataCb;
+
+        bool m_offline;
+        std::atomic<bool> m_offlineDone;
+        VirtualClock m_clock;
+        std::atomic<uint32_t> m_nextTickMs;
+        QueueSignal m_offlineSignal;
+        std::mutex m_offlineMutex;
+        FlatStreamMap<OfflineInput> m_offlineInputs;
+        std::vector<Queue<MediaFrame> *> m_outputQueues;
     };
 
 } // namespace hercules
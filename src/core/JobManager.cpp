@@ -16,6 +16,7 @@
 #include "JobManager.h"
 #include "Log.h"
 #include "ThreadPool.h"
+#include "LatencyStats.h"
 
 #include "json/json.h"
 
@@ -30,7 +31,7 @@ namespace hercules
     using std::string;
 
     Job *JobManager::addTask(const std::string &json, const Json::Value &val, 
-        const DataCallback &cb)
+        const DataCallback &cb, AdmissionResult &result)
     {
         Job *job = JobManager::getInstance()->findJob(val["task_id"].asString());
         logInfo(MIXLOG << "fix json: " << json);
@@ -39,17 +40,33 @@ namespace hercules
         {
             logInfo(MIXLOG << "new job, key: " << val["task_id"]);
 
+            result = m_admission.admit(taskKey, val);
+            if (result.m_decision == AdmissionDecision::REJECT)
+            {
+                logWarn(MIXLOG << "job rejected, key: " << taskKey << ", cost: " << result.m_cost
+                    << ", headroom: " << result.m_headroom);
+                return NULL;
+            }
+
             job = new Job();
             job->init(val["task_id"].asString(), val["output_stream"]["streamname"].asString(), 
                 val["task_file"].asString(), cb);
+            job->setOffline(val["offline"].asBool());
+            job->setDecodeQuality(Decoder::parseDecodeQuality(val["decode_quality"].asString()));
             insertJob(taskKey, job);
 
-            string sJson = json;
             Job *rawJob = findJob(taskKey);
             if (rawJob)
             {
-                rawJob->pushJson(sJson);
-                rawJob->start();
+                rawJob->pushJson(val);
+                if (result.m_decision == AdmissionDecision::ADMIT)
+                {
+                    rawJob->start();
+                }
+                else
+                {
+                    logInfo(MIXLOG << "job queued, key: " << taskKey << ", cost: " << result.m_cost);
+                }
             }
             else
             {
@@ -62,12 +79,15 @@ namespace hercules
             if (rawJob)
             {
                 logInfo(MIXLOG << "update job: " << taskKey);
-                rawJob->pushJson(json);
+                m_admission.update(taskKey, val);
+                rawJob->pushJson(val);
             }
             else
             {
                 logErr(MIXLOG << "update failed: " << taskKey);
             }
+            result = AdmissionResult();
+            result.m_headroom = m_admission.getHeadroom();
         }
         return job;
     }
@@ -88,7 +108,7 @@ namespace hercules
         if (rawJob)
         {
             logInfo(MIXLOG << "update job: " << taskKey);
-            rawJob->pushJson(json);
+            rawJob->pushJson(tValue);
         }
         else
         {
@@ -153,9 +173,31 @@ namespace hercules
     {
         logInfo(MIXLOG << "remove job: " << key);
 
-        std::unique_lock<std::mutex> lockGuard(m_jobMapMutex);
+        {
+            std::unique_lock<std::mutex> lockGuard(m_jobMapMutex);
+            m_jobMap.erase(key);
+        }
 
-        m_jobMap.erase(key);
+        LatencyStats::getInstance()->remove(key);
+        m_admission.release(key);
+        startQueuedJobs();
+    }
+
+    void JobManager::startQueuedJobs()
+    {
+        std::string key;
+        while (!(key = m_admission.popAdmissible()).empty())
+        {
+            Job *job = findJob(key);
+            if (job != NULL && !job->isStarted())
+            {
+                job->start();
+            }
+            else
+            {
+                m_admission.release(key);
+            }
+        }
     }
 
     void JobManager::checkTimeoutJob()
@@ -181,6 +223,7 @@ namespace hercules
                 {
                     logInfo(MIXLOG << "job: " << key << ", timeout");
                     job->stop();
+                    LatencyStats::getInstance()->remove(key);
                     iter = m_jobMap.erase(iter);
                     deleteJobs.insert(job);
                     continue;
@@ -214,4 +257,138 @@ namespace hercules
         job->subscribeJobFrame(streamName, ctx);
     }
 
+    void JobManager::registerJobOutput(const std::string &key, Queue<MediaFrame> *queue)
+    {
+        Job *job = findJob(key);
+        if (job == nullptr)
+        {
+            return;
+        }
+        job->registerOutput(queue);
+    }
+
+    int JobManager::publishJobFrame(const std::string &key, const std::string &streamName,
+                                    MediaFrame &frame, MediaType type)
+    {
+        Job *job = findJob(key);
+        if (job == nullptr)
+        {
+            return -1;
+        }
+        return job->publishFrame(streamName, frame, type);
+    }
+
+    void JobManager::setStreamVisible(const std::string &key, const std::string &streamName,
+                                      bool visible)
+    {
+        Job *job = findJob(key);
+        if (job == nullptr)
+        {
+            return;
+        }
+        job->setStreamVisible(streamName, visible);
+    }
+
+    void JobManager::setStreamDisplaySize(const std::string &key, const std::string &streamName,
+                                          int width, int height)
+    {
+        Job *job = findJob(key);
+        if (job == nullptr)
+        {
+            return;
+        }
+        job->setStreamDisplaySize(streamName, width, height);
+    }
+
+    void JobManager::setJobOutputFps(const std::string &key, int fps)
+    {
+        Job *job = findJob(key);
+        if (job == nullptr)
+        {
+            return;
+        }
+        job->setOutputFps(fps);
+    }
+
+    bool JobManager::isJobOffline(const std::string &key)
+    {
+        Job *job = findJob(key);
+        return job != nullptr && job->isOffline();
+    }
+
+    void JobManager::setJobNextTick(const std::string &key, uint32_t ms)
+    {
+        Job *job = findJob(key);
+        if (job == nullptr)
+        {
+            return;
+        }
+        job->setNextTick(ms);
+    }
+
+    void JobManager::setJobAudioOutput(const std::string &key, int sampleRate, int channels,
+                                       int frameSamples)
+    {
+        Job *job = findJob(key);
+        if (job == nullptr)
+        {
+            return;
+        }
+        job->setAudioOutput(sampleRate, channels, frameSamples);
+    }
+
+    int JobManager::reportMixTick(const std::string &key, int lateMs, int frameMs, int queueDepth)
+    {
+        Job *job = findJob(key);
+        if (job == nullptr)
+        {
+            return static_cast<int>(OverloadLevel::NORMAL);
+        }
+        return job->reportMixTick(lateMs, frameMs, queueDepth);
+    }
+
+    std::map<std::string, OverloadStats> JobManager::getOverloadStats()
+    {
+        std::map<std::string, OverloadStats> stats;
+        stats[""] = ProcessOverload::getInstance()->getStats();
+
+        std::unique_lock<std::mutex> lockGuard(m_jobMapMutex);
+        for (const auto &kv : m_jobMap)
+        {
+            if (kv.second != NULL)
+            {
+                stats[kv.first] = kv.second->getOverloadStats();
+            }
+        }
+        return stats;
+    }
+
+    std::map<std::string, std::map<std::string, JitterStats>> JobManager::getJitterStats()
+    {
+        std::map<std::string, std::map<std::string, JitterStats>> stats;
+        std::unique_lock<std::mutex> lockGuard(m_jobMapMutex);
+        for (const auto &kv : m_jobMap)
+        {
+            if (kv.second != NULL)
+            {
+                stats[kv.first] = kv.second->getJitterStats();
+            }
+        }
+        return stats;
+    }
+
+    std::map<std::string, std::map<std::string, DecodeStats>> JobManager::getDecodeStats()
+    {
+        std::map<std::string, std::map<std::string, DecodeStats>> stats;
+        std::unique_lock<std::mutex> lockGuard(m_jobMapMutex);
+        for (const auto &kv : m_jobMap)
+        {
+            if (kv.second != NULL)
+            {
+                stats[kv.first] = kv.second->getDecodeStats();
+            }
+        }
+        return stats;
+    }
+
 } // namespace hercules
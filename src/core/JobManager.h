@@ -16,6 +16,8 @@
 
 #include "Singleton.h"
 #include "MixSdk.h"
+#include "AdmissionControl.h"
+#include "OverloadControl.h"
 
 #include "json/json.h"
 
@@ -41,22 +43,43 @@ namespace hercules
         Job *getOrCreateJob(const std::string &key);
         bool insertJob(const std::string &key, Job *job);
         void removeJob(const std::string &key);
-        Job *addTask(const std::string &json, const Json::Value &val, const DataCallback &cb);
+        Job *addTask(const std::string &json, const Json::Value &val, const DataCallback &cb,
+            AdmissionResult &result);
         void updateJson(const std::string &json);
         void subscribeJobFrame(const std::string &key,
             const std::string &streamName, SubscribeContext *ctx);
+        void registerJobOutput(const std::string &key, Queue<MediaFrame> *queue);
+        int publishJobFrame(const std::string &key, const std::string &streamName,
+            MediaFrame &frame, MediaType type);
+        void setStreamVisible(const std::string &key, const std::string &streamName, bool visible);
+        void setStreamDisplaySize(const std::string &key, const std::string &streamName,
+            int width, int height);
+        void setJobOutputFps(const std::string &key, int fps);
+        bool isJobOffline(const std::string &key);
+        void setJobNextTick(const std::string &key, uint32_t ms);
+        void setJobAudioOutput(const std::string &key, int sampleRate, int channels, int frameSamples);
+        int reportMixTick(const std::string &key, int lateMs, int frameMs, int queueDepth);
+        std::map<std::string, OverloadStats> getOverloadStats();
+        std::map<std::string, std::map<std::string, JitterStats>> getJitterStats();
+        std::map<std::string, std::map<std::string, DecodeStats>> getDecodeStats();
 
         void checkTimeoutJob();
 
+        AdmissionControl &getAdmission() { return m_admission; }
+
         int jobCount()
         {
             std::unique_lock<std::mutex> lockGuard(m_jobMapMutex);
             return m_jobMap.size();
         }
 
+    private:
+        void startQueuedJobs();
+
     private:
         std::map<std::string, Job *> m_jobMap;
         std::mutex m_jobMapMutex;
+        AdmissionControl m_admission;
     };
 
 } // namespace hercules
@@ -0,0 +1,107 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "LayoutModel.h"
+
+#include <string>
+
+namespace hercules
+{
+
+    using std::map;
+    using std::string;
+
+    bool LayoutModel::isLayout(const Json::Value &root)
+    {
+        return root.isObject() && !root.isMember("type") && root["input_stream_list"].isArray();
+    }
+
+    void LayoutModel::parse(Json::Value &root, map<string, Entry> &entries)
+    {
+        map<string, int> occurrence;
+        Json::Value &list = root["input_stream_list"];
+        for (Json::ArrayIndex i = 0; i < list.size(); ++i)
+        {
+            Json::Value &value = list[i];
+            if (!value.isObject())
+            {
+                continue;
+            }
+
+            Entry entry;
+            entry.m_type = value["type"].asString();
+            entry.m_name = value.isMember("stream_name") ?
+                value["stream_name"].asString() : value["content"].asString();
+
+            string id = entry.m_type + "/" + entry.m_name;
+            entry.m_key = id + "#" + std::to_string(occurrence[id]++);
+
+            value["layout_key"] = entry.m_key;
+            entry.m_value = value;
+            entries[entry.m_key] = entry;
+        }
+    }
+
+    void LayoutModel::reset(Json::Value &root)
+    {
+        m_entries.clear();
+        parse(root, m_entries);
+        m_outStream = root["out_stream"];
+    }
+
+    int LayoutModel::update(Json::Value &root, Json::Value &diff)
+    {
+        map<string, Entry> entries;
+        parse(root, entries);
+
+        int changes = 0;
+        diff = Json::Value(Json::objectValue);
+        diff["removed"] = Json::Value(Json::arrayValue);
+        diff["changed"] = Json::Value(Json::arrayValue);
+
+        for (const auto &kv : m_entries)
+        {
+            if (entries.find(kv.first) == entries.end())
+            {
+                Json::Value removed;
+                removed["layout_key"] = kv.first;
+                diff["removed"].append(removed);
+                ++changes;
+            }
+        }
+
+        for (const auto &kv : entries)
+        {
+            auto iter = m_entries.find(kv.first);
+            if (iter == m_entries.end() || iter->second.m_value != kv.second.m_value)
+            {
+                diff["changed"].append(kv.second.m_value);
+                ++changes;
+            }
+        }
+
+        const Json::Value &outStream = root["out_stream"];
+        if (outStream != m_outStream)
+        {
+            diff["out_stream"] = outStream;
+            ++changes;
+        }
+
+        m_entries.swap(entries);
+        m_outStream = outStream;
+
+        return changes;
+    }
+
+} // namespace hercules
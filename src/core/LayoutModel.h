@@ -0,0 +1,63 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "json/json.h"
+
+#include <map>
+#include <string>
+
+namespace hercules
+{
+
+    // parsed input_stream_list/out_stream of one job, each entry is identified by
+    // type + stream name/content + occurrence, so an update can be reduced to
+    // the entries that really changed before it reaches lua
+    class LayoutModel
+    {
+    public:
+        struct Entry
+        {
+            std::string m_key;
+            std::string m_type;
+            std::string m_name;
+            Json::Value m_value;
+        };
+
+        LayoutModel() {}
+
+        // commands like audioMixerDump carry a type and are not layouts
+        static bool isLayout(const Json::Value &root);
+
+        // take root as current layout, entries in root get their layout_key
+        void reset(Json::Value &root);
+
+        // diff root against current layout and take it as current,
+        // diff gets removed entries (layout_key only), changed entries and
+        // out_stream if it changed,
+        // return number of changes
+        int update(Json::Value &root, Json::Value &diff);
+
+        size_t size() const { return m_entries.size(); }
+
+    private:
+        static void parse(Json::Value &root, std::map<std::string, Entry> &entries);
+
+    private:
+        std::map<std::string, Entry> m_entries;
+        Json::Value m_outStream;
+    };
+
+} // namespace hercules
@@ -20,6 +20,7 @@
 #include "AVFrameUtils.h"
 #include "Log.h"
 #include "JobManager.h"
+#include "InputRegistry.h"
 
 #include "json/json.h"
 
@@ -29,6 +30,13 @@ namespace hercules
 {
 
     MixTask *MixTaskManager::addTask(const std::string &task, const DataCallback &dataCb)
+    {
+        AdmissionResult result;
+        return addTask(task, dataCb, result);
+    }
+
+    MixTask *MixTaskManager::addTask(const std::string &task, const DataCallback &dataCb,
+        AdmissionResult &result)
     {
         if (m_fontFile.empty())
         {
@@ -46,8 +54,11 @@ namespace hercules
         if (tValue["task_type"] == "lua")
         {
             MixTask *job = reinterpret_cast<MixTask *>(
-                JobManager::getInstance()->addTask(task, tValue, dataCb));
-            m_tasks[tValue["task_id"].asString()] = job;
+                JobManager::getInstance()->addTask(task, tValue, dataCb, result));
+            if (job != nullptr)
+            {
+                m_tasks[tValue["task_id"].asString()] = job;
+            }
             return job;
         }
         return nullptr;
@@ -87,6 +98,78 @@ namespace hercules
         return ret;
     }
 
+    void MixTaskManager::setThreadPlacement(bool enable, int coresPerTask)
+    {
+        ThreadManager::getInstance()->setPlacement(enable, coresPerTask);
+    }
+
+    void MixTaskManager::dumpThreads()
+    {
+        ThreadManager::getInstance()->dumpAllThread();
+    }
+
+    CpuUsage MixTaskManager::getCpuUsage()
+    {
+        CpuUsage usage = ThreadManager::getInstance()->getCpuUsage();
+        InputRegistry::getInstance()->apportion(usage);
+        return usage;
+    }
+
+    void MixTaskManager::setSharedInput(bool enable)
+    {
+        InputRegistry::getInstance()->setEnabled(enable);
+    }
+
+    std::map<std::string, int> MixTaskManager::getSharedInputs()
+    {
+        return InputRegistry::getInstance()->getSubscriberCounts();
+    }
+
+    std::map<std::string, std::map<std::string, JitterStats>> MixTaskManager::getJitterStats()
+    {
+        return JobManager::getInstance()->getJitterStats();
+    }
+
+    std::map<std::string, std::map<std::string, DecodeStats>> MixTaskManager::getDecodeStats()
+    {
+        return JobManager::getInstance()->getDecodeStats();
+    }
+
+    std::map<std::string, std::map<std::string, InputLatency>> MixTaskManager::getLatencyStats()
+    {
+        return LatencyStats::getInstance()->getStats();
+    }
+
+    void MixTaskManager::resetLatencyStats(const std::string &taskId)
+    {
+        LatencyStats::getInstance()->reset(taskId);
+    }
+
+    void MixTaskManager::setAdmissionCapacity(double cores)
+    {
+        JobManager::getInstance()->getAdmission().setCapacity(cores);
+    }
+
+    void MixTaskManager::setAdmissionQueue(bool queueWhenFull)
+    {
+        JobManager::getInstance()->getAdmission().setQueueWhenFull(queueWhenFull);
+    }
+
+    void MixTaskManager::setCostCoefficients(const CostCoefficients &coefficients)
+    {
+        JobManager::getInstance()->getAdmission().setCoefficients(coefficients);
+    }
+
+    double MixTaskManager::getHeadroom()
+    {
+        return JobManager::getInstance()->getAdmission().getHeadroom();
+    }
+
+    std::map<std::string, OverloadStats> MixTaskManager::getOverloadStats()
+    {
+        return JobManager::getInstance()->getOverloadStats();
+    }
+
     void MixTaskManager::stopAll()
     {
         for (auto task : m_tasks)
@@ -21,6 +21,11 @@
 #include "Log.h"
 #include "FlvFile.h"
 #include "Singleton.h"
+#include "StreamRegistry.h"
+#include "AdmissionControl.h"
+#include "OverloadControl.h"
+#include "CodecUtil.h"
+#include "LatencyStats.h"
 
 #include "json/json.h"
 
@@ -55,7 +60,8 @@ namespace hercules
 
     struct AVData
     {
-        explicit AVData(DataType type = DATA_TYPE_FLV_VIDEO) : m_dataType(type)
+        explicit AVData(DataType type = DATA_TYPE_FLV_VIDEO)
+            : m_dataType(type)
         {
         }
 
@@ -87,6 +93,18 @@ namespace hercules
         {
             logDebug(MIXLOG << "MixTask addAVData");
         }
+        // offline tasks complete once every input fed so far has ended and drained
+        virtual void endInput(const std::string &)
+        {
+            logDebug(MIXLOG << "MixTask endInput");
+        }
+        // addFileInput(streamName, fileName, loop, realtime) reads an flv file as the
+        // input streamName on a thread of the task, in place of feeding addAVData;
+        // at the end of the file endInput is called
+        virtual int addFileInput(const std::string &, const std::string &, bool, bool)
+        {
+            return EC_ERROR;
+        }
 
         virtual void start() = 0;
         virtual void stop() = 0;
@@ -110,8 +128,45 @@ namespace hercules
         const std::string &fontFile() { return m_fontFile; }
         int stopTask(const std::string &taskKey);
         MixTask *addTask(const std::string &task, const DataCallback &dataCb);
+        // nullptr when rejected, a queued task starts once running tasks free enough cpu
+        MixTask *addTask(const std::string &task, const DataCallback &dataCb, AdmissionResult &result);
         void stopAll();
 
+        // cores tasks may commit, <= 0 uses 80% of the cpus this process may run on;
+        // admission only accounts and never refuses until this is called
+        void setAdmissionCapacity(double cores);
+        void setAdmissionQueue(bool queueWhenFull);
+        void setCostCoefficients(const CostCoefficients &coefficients);
+        // cores left for new tasks, negative when overcommitted
+        double getHeadroom();
+        // current degradation level and transition counts per task id, the
+        // process wide controller under ""
+        std::map<std::string, OverloadStats> getOverloadStats();
+
+        // pin the threads of each task to a core set on one numa node, off by default,
+        // only threads started afterwards are affected
+        void setThreadPlacement(bool enable, int coresPerTask = kThreadPlacementCores);
+        void dumpThreads();
+        // cpu percent of one core per task id and stage (decode, resample, mix,
+        // encode, publish, other) over the last sample interval, shared threads under ""
+        CpuUsage getCpuUsage();
+        // decode each input stream name once for all live tasks pulling it, off by
+        // default since tasks must then name the same source alike and nothing
+        // else; only tasks added afterwards are affected
+        void setSharedInput(bool enable);
+        // live tasks per shared input stream name
+        std::map<std::string, int> getSharedInputs();
+        // playout delay, underrun and late drop counts per task id and input stream name
+        std::map<std::string, std::map<std::string, JitterStats>> getJitterStats();
+        // video decode suspension and skipped packets per task id and input stream name
+        std::map<std::string, std::map<std::string, DecodeStats>> getDecodeStats();
+        // p50/p90/p99/max in ms per task id, input stream name and stage (recv_deliver,
+        // deliver_decode, decode_mixed, mixed_encode, encode_send, end_to_end),
+        // sampled as the output packets leave, since start or the last reset
+        std::map<std::string, std::map<std::string, InputLatency>> getLatencyStats();
+        // an empty task id resets every task
+        void resetLatencyStats(const std::string &taskId);
+
     private:
         std::map<std::string, MixTask *> m_tasks;
         std::mutex m_taskMutex;
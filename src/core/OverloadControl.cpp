@@ -0,0 +1,152 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "OverloadControl.h"
+#include "ThreadManager.h"
+#include "Log.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+
+namespace hercules
+{
+
+    OverloadController::OverloadController()
+        : m_level(static_cast<int>(OverloadLevel::NORMAL))
+        , m_stepDowns(0)
+        , m_stepUps(0)
+        , m_overWindows(0)
+        , m_idleWindows(0)
+        , m_windowStartMs(0)
+        , m_windowTicks(0)
+        , m_windowMisses(0)
+        , m_windowMaxQueue(0)
+    {
+    }
+
+    bool OverloadController::evaluate(bool overloaded, bool idle)
+    {
+        m_overWindows = overloaded ? m_overWindows + 1 : 0;
+        m_idleWindows = idle ? m_idleWindows + 1 : 0;
+
+        int level = m_level;
+        if (m_overWindows >= kOverloadDownWindows && level < static_cast<int>(OverloadLevel::LOW_DECODE))
+        {
+            step(1, "overloaded");
+            return true;
+        }
+        if (m_idleWindows >= kOverloadUpWindows && level > static_cast<int>(OverloadLevel::NORMAL))
+        {
+            step(-1, "headroom");
+            return true;
+        }
+        return false;
+    }
+
+    bool OverloadController::onTick(bool late, int queueDepth, uint64_t nowMs)
+    {
+        if (m_windowStartMs == 0)
+        {
+            m_windowStartMs = nowMs;
+        }
+        ++m_windowTicks;
+        m_windowMisses += late ? 1 : 0;
+        m_windowMaxQueue = std::max(m_windowMaxQueue, queueDepth);
+
+        if (nowMs < m_windowStartMs + kOverloadWindowMs)
+        {
+            return false;
+        }
+
+        double missRatio = static_cast<double>(m_windowMisses) / m_windowTicks;
+        bool overloaded = missRatio >= kOverloadMissRatio || m_windowMaxQueue >= kOverloadQueueHigh;
+        bool idle = missRatio <= kOverloadIdleMissRatio && m_windowMaxQueue <= kOverloadQueueLow;
+        if (overloaded)
+        {
+            logDebug(MIXLOG << "overload window: " << m_name << ", ticks: " << m_windowTicks
+                << ", misses: " << m_windowMisses << ", max queue: " << m_windowMaxQueue);
+        }
+
+        m_windowStartMs = nowMs;
+        m_windowTicks = 0;
+        m_windowMisses = 0;
+        m_windowMaxQueue = 0;
+        return evaluate(overloaded, idle);
+    }
+
+    OverloadStats OverloadController::getStats() const
+    {
+        OverloadStats stats;
+        stats.m_level = getLevel();
+        stats.m_stepDowns = m_stepDowns;
+        stats.m_stepUps = m_stepUps;
+        return stats;
+    }
+
+    void OverloadController::step(int delta, const std::string &reason)
+    {
+        int from = m_level;
+        m_level = from + delta;
+        if (delta > 0)
+        {
+            ++m_stepDowns;
+        }
+        else
+        {
+            ++m_stepUps;
+        }
+        m_overWindows = 0;
+        m_idleWindows = 0;
+
+        logInfo(MIXLOG << "overload level: " << m_name << ", " << from << " -> " << m_level
+            << ", reason: " << reason << ", step downs: " << m_stepDowns << ", step ups: " << m_stepUps);
+    }
+
+    static uint64_t processCpuNs()
+    {
+        struct timespec ts;
+        if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0)
+        {
+            return 0;
+        }
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    ProcessOverload::ProcessOverload() : m_lastSampleMs(0), m_lastCpuNs(0)
+    {
+        m_controller.setName("process");
+    }
+
+    OverloadLevel ProcessOverload::getLevel(uint64_t nowMs)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        if (nowMs >= m_lastSampleMs + kOverloadWindowMs)
+        {
+            // every thread counts, including codec workers and exited threads
+            uint64_t cpuNs = processCpuNs();
+            if (m_lastSampleMs != 0 && cpuNs >= m_lastCpuNs)
+            {
+                double util = (cpuNs - m_lastCpuNs) / 1e6 / (nowMs - m_lastSampleMs)
+                    / ThreadManager::getInstance()->getCpuCount();
+                m_controller.evaluate(util >= kOverloadCpuHigh, util <= kOverloadCpuLow);
+            }
+            m_lastSampleMs = nowMs;
+            m_lastCpuNs = cpuNs;
+        }
+        return m_controller.getLevel();
+    }
+
+} // namespace hercules
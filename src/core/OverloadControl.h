@@ -0,0 +1,120 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "Singleton.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace hercules
+{
+
+    constexpr uint64_t kOverloadWindowMs = 1000;
+    // a window is overloaded when this share of mix ticks missed its deadline
+    constexpr double kOverloadMissRatio = 0.1;
+    constexpr double kOverloadIdleMissRatio = 0.01;
+    // frames waiting in front of the encoder
+    constexpr int kOverloadQueueHigh = 4;
+    constexpr int kOverloadQueueLow = 1;
+    // process cpu share of the allowed cpus
+    constexpr double kOverloadCpuHigh = 0.95;
+    constexpr double kOverloadCpuLow = 0.8;
+    // windows in a row before a step, stepping up is slow so a level that
+    // just relieved the host is not dropped straight back into overload
+    constexpr int kOverloadDownWindows = 2;
+    constexpr int kOverloadUpWindows = 10;
+
+    // each level keeps the cuts of the levels below it
+    enum class OverloadLevel
+    {
+        NORMAL = 0,
+        FAST_RESIZE = 1,     // nearest neighbour scaling
+        NO_ANTIALIAS = 2,    // hard edged clip polygons
+        FAST_PRESET = 3,     // cheaper x264 preset
+        DECIMATE = 4,        // half output frame rate
+        LOW_DECODE = 5,      // skip loop filter on all inputs
+    };
+
+    struct OverloadStats
+    {
+        OverloadStats() : m_level(OverloadLevel::NORMAL), m_stepDowns(0), m_stepUps(0)
+        {
+        }
+        OverloadLevel m_level;
+        uint64_t m_stepDowns;
+        uint64_t m_stepUps;
+    };
+
+    // steps one level per decision, down after kOverloadDownWindows overloaded
+    // windows and up after kOverloadUpWindows idle ones
+    class OverloadController
+    {
+    public:
+        OverloadController();
+
+        void setName(const std::string &name) { m_name = name; }
+
+        // returns true when the level changed
+        bool evaluate(bool overloaded, bool idle);
+
+        // per mix tick, evaluates once a window is complete
+        bool onTick(bool late, int queueDepth, uint64_t nowMs);
+
+        OverloadLevel getLevel() const { return static_cast<OverloadLevel>(m_level.load()); }
+        OverloadStats getStats() const;
+
+    private:
+        void step(int delta, const std::string &reason);
+
+    private:
+        std::string m_name;
+        std::atomic<int> m_level;
+        std::atomic<uint64_t> m_stepDowns;
+        std::atomic<uint64_t> m_stepUps;
+        int m_overWindows;
+        int m_idleWindows;
+
+        uint64_t m_windowStartMs;
+        int m_windowTicks;
+        int m_windowMisses;
+        int m_windowMaxQueue;
+    };
+
+    // host wide level from the cpu time of the whole process, every job
+    // runs at least at this level
+    class ProcessOverload : public Singleton<ProcessOverload>
+    {
+        friend class Singleton<ProcessOverload>;
+
+    private:
+        ProcessOverload();
+        ~ProcessOverload() {}
+
+    public:
+        OverloadLevel getLevel(uint64_t nowMs);
+        OverloadStats getStats() const { return m_controller.getStats(); }
+
+    private:
+        std::mutex m_mutex;
+        OverloadController m_controller;
+        uint64_t m_lastSampleMs;
+        uint64_t m_lastCpuNs;
+    };
+
+} // namespace hercules
@@ -17,7 +17,9 @@
 #include "Decoder.h"
 #include "Encoder.h"
 #include "FFmpegAudioMixer.h"
+#include "FileWatcher.h"
 #include "Job.h"
+#include "JobManager.h"
 #include "Log.h"
 #include "Lua.h"
 #include "MediaFrame.h"
@@ -25,12 +27,16 @@
 #include "OpenCVOperator.h"
 #include "Property.h"
 #include "PublisherWrapper.h"
+#include "ScriptCache.h"
 #include "TimeUse.h"
 
 #include "json/json.h"
 #include "opencv2/imgcodecs.hpp"
 
 #include <pthread.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -117,6 +123,67 @@ namespace hercules
         return TimestampAdjuster::getElapseFromServerStart();
     }
 
+    void registerJobOutput(const std::string &jobKey, MediaFrameQueue *queue)
+    {
+        JobManager::getInstance()->registerJobOutput(jobKey, queue);
+    }
+
+    void setStreamVisible(const std::string &jobKey, const std::string &streamName, bool visible)
+    {
+        JobManager::getInstance()->setStreamVisible(jobKey, streamName, visible);
+    }
+
+    void setStreamDisplaySize(const std::string &jobKey, const std::string &streamName,
+                              int width, int height)
+    {
+        JobManager::getInstance()->setStreamDisplaySize(jobKey, streamName, width, height);
+    }
+
+    void setJobOutputFps(const std::string &jobKey, int fps)
+    {
+        JobManager::getInstance()->setJobOutputFps(jobKey, fps);
+    }
+
+    bool isJobOffline(const std::string &jobKey)
+    {
+        return JobManager::getInstance()->isJobOffline(jobKey);
+    }
+
+    void setJobNextTick(const std::string &jobKey, uint32_t ms)
+    {
+        JobManager::getInstance()->setJobNextTick(jobKey, ms);
+    }
+
+    void setJobAudioOutput(const std::string &jobKey, int sampleRate, int channels, int frameSamples)
+    {
+        JobManager::getInstance()->setJobAudioOutput(jobKey, sampleRate, channels, frameSamples);
+    }
+
+    int opusFrameMs(int frameMs)
+    {
+        return getOpusFrameMs(frameMs);
+    }
+
+    bool canOpenAudioEncoder(const std::string &codec, int channels, int sampleRate, int frameMs)
+    {
+        return AudioEncoder::canOpen(channels, sampleRate, 192, codec, frameMs);
+    }
+
+    int reportMixTick(const std::string &jobKey, int lateMs, int frameMs, int queueDepth)
+    {
+        return JobManager::getInstance()->reportMixTick(jobKey, lateMs, frameMs, queueDepth);
+    }
+
+    int publishJobVideo(const std::string &jobKey, const std::string &streamName, MediaFrame &frame)
+    {
+        return JobManager::getInstance()->publishJobFrame(jobKey, streamName, frame, MediaType::VIDEO);
+    }
+
+    int publishJobAudio(const std::string &jobKey, const std::string &streamName, MediaFrame &frame)
+    {
+        return JobManager::getInstance()->publishJobFrame(jobKey, streamName, frame, MediaType::AUDIO);
+    }
+
     // ==== STL support ====
 
     Lua::Lua()
@@ -124,11 +191,12 @@ namespace hercules
         L = luaL_newstate();
         luaL_openlibs(L);
         luabind::open(L);
-        m_lastModTime = -1;
+        m_dirty = true;
     }
 
     Lua::~Lua()
     {
+        FileWatcher::getInstance()->unwatch(&m_dirty);
         lua_close(L);
     }
 
@@ -144,6 +212,18 @@ namespace hercules
                 def("getNowMs", &getNowMs),
                 def("getNowMs32", &getNowMs32),
                 def("getRunMs32", &getRunMs32),
+                def("registerJobOutput", &registerJobOutput),
+                def("setStreamVisible", &setStreamVisible),
+                def("setStreamDisplaySize", &setStreamDisplaySize),
+                def("setJobOutputFps", &setJobOutputFps),
+                def("setJobAudioOutput", &setJobAudioOutput),
+                def("isJobOffline", &isJobOffline),
+                def("setJobNextTick", &setJobNextTick),
+                def("opusFrameMs", &opusFrameMs),
+                def("canOpenAudioEncoder", &canOpenAudioEncoder),
+                def("reportMixTick", &reportMixTick),
+                def("publishJobVideo", &publishJobVideo),
+                def("publishJobAudio", &publishJobAudio),
                 def("getCWD", &getCWD),
                 def("isGif", &isGif)];
     }
@@ -178,6 +258,7 @@ namespace hercules
                  .def("getIdTimestamp", &MediaBase::getIdTimestamp)
                  .def("getInIdTimestamp", &MediaBase::getInIdTimestamp)
                  .def("getIdTimestampStr", &MediaBase::getIdTimestampStr)
+                 .def("clearTimeTrace", &MediaBase::clearTimeTrace)
                  .def("isVideo", &MediaBase::isVideo)
                  .def("isAudio", &MediaBase::isAudio)
                  .def("isIFrame", &MediaBase::isIFrame)
@@ -235,7 +316,9 @@ namespace hercules
                  .def_readwrite("m_publishDataStream", &StreamOpt::m_publishDataStream)
                  .def_readwrite("m_fixUid", &StreamOpt::m_fixUid)
                  .def_readwrite("m_phonyUid", &StreamOpt::m_phonyUid)
-                 .def_readwrite("m_smooth", &StreamOpt::m_smooth),
+                 .def_readwrite("m_smooth", &StreamOpt::m_smooth)
+                 .def_readwrite("m_maxBurstMs", &StreamOpt::m_maxBurstMs)
+                 .def_readwrite("m_catchUpRate", &StreamOpt::m_catchUpRate),
 
              class_<PublisherWrapper>("PublisherWrapper")
                  .def(constructor<const string &, const string &>())
@@ -251,6 +334,7 @@ namespace hercules
                  .def("setPushParam", &PublisherWrapper::setPushParam)
                  .def("setVideoCodec", &PublisherWrapper::setVideoCodec)
                  .def("setAudioCodec", &PublisherWrapper::setAudioCodec)
+                 .def("addDestination", &PublisherWrapper::addDestination)
                  .def("addTraceInfo", (void (PublisherWrapper::*)(
                     const std::string &, uint64_t, const std::string &)) &
                     PublisherWrapper::addTraceInfo)
@@ -314,6 +398,8 @@ namespace hercules
                  .def("addCircleStroke", &OpenCVOperator::addCircleStroke)
                  .def("addCircleYUV", &OpenCVOperator::addCircleYUV)
                  .def("addCircleAlphaCustom", &OpenCVOperator::addCircleAlphaCustom)
+                 .def("setFastResize", &OpenCVOperator::setFastResize)
+                 .def("setAntiAlias", &OpenCVOperator::setAntiAlias)
                  .def("yuvToRgbAndDumpFile", &OpenCVOperator::yuvToRgbAndDumpFile)
                  .def("yuvDump", &OpenCVOperator::yuvDump)
                  .def("setAsTempLayer", &OpenCVOperator::setAsTempLayer)
@@ -333,6 +419,7 @@ namespace hercules
                  .def("join", &Encoder::join)
                  .def("setCodec", &Encoder::setCodec)
                  .def("setLowLatency", &Encoder::setLowLatency)
+                 .def("setFastPreset", &Encoder::setFastPreset)
                  .def("pushMediaFrame", &Encoder::pushMediaFrame)
                  .def("stop", &Encoder::stop)];
     }
@@ -347,6 +434,7 @@ namespace hercules
                  .def("join", &AudioEncoder::join)
                  .def("setCodec", &AudioEncoder::setCodec)
                  .def("setLowLatency", &AudioEncoder::setLowLatency)
+                 .def("setFrameDuration", &AudioEncoder::setFrameDuration)
                  .def("pushMediaFrame", &AudioEncoder::pushMediaFrame)
                  .def("stop", &AudioEncoder::stop)];
     }
@@ -375,6 +463,9 @@ namespace hercules
                  .def("getVideoFrameQueue", &SubscribeContext::getVideoFrameQueue)
                  .def("getAudioFrameQueue", &SubscribeContext::getAudioFrameQueue)
                  .def("subscribeJobFrame", &SubscribeContext::subscribeJobFrame)
+                 .def("setJitterTarget", &SubscribeContext::setJitterTarget)
+                 .def("popAudioFrame", &SubscribeContext::popAudioFrame)
+                 .def("popVideoFrame", &SubscribeContext::popVideoFrame)
         ];
     }
 
@@ -400,44 +491,157 @@ namespace hercules
         bindDecoder();
         bindSubscribeContext();
         bindFFmpegAudioMixer();
+        hookRequire();
 
+        FileWatcher::getInstance()->watch(m_script, &m_dirty);
         reloadScript();
     }
 
     void Lua::reloadScript()
     {
-        time_t mtime = 0;
-        if (getFileLastModTime(mtime) != 0)
+        m_dirty = false;
+
+        // drop cached modules so the next require loads the edited file
+        lua_getglobal(L, "package");
+        lua_getfield(L, -1, "loaded");
+        for (const auto &module : m_modules)
+        {
+            lua_pushnil(L);
+            lua_setfield(L, -2, module.c_str());
+        }
+        lua_pop(L, 2);
+
+        if (ScriptCache::getInstance()->load(L, m_script) != 0
+            || lua_pcall(L, 0, LUA_MULTRET, 0) != 0)
+        {
+            logErr(MIXLOG << "error: jobKey:" << m_jobKey << ", load script: " << m_script
+                << " fail, err: " << lua_tostring(L, -1));
+            lua_pop(L, 1);
+        }
+        else
+        {
+            logInfo(MIXLOG << "jobKey:" << m_jobKey << ", load script: " << m_script);
+        }
+    }
+
+    // put traceRequire in front of package.loaders, it records the module and
+    // loads it from ScriptCache, modules it can not find go to the standard loaders
+    void Lua::hookRequire()
+    {
+        lua_getglobal(L, "package");
+        lua_getfield(L, -1, "loaders");
+        if (lua_istable(L, -1))
+        {
+            for (int i = lua_objlen(L, -1); i >= 1; --i)
+            {
+                lua_rawgeti(L, -1, i);
+                lua_rawseti(L, -2, i + 1);
+            }
+            lua_pushlightuserdata(L, this);
+            lua_pushcclosure(L, &Lua::traceRequire, 1);
+            lua_rawseti(L, -2, 1);
+        }
+        lua_pop(L, 2);
+    }
+
+    int Lua::traceRequire(lua_State *L)
+    {
+        Lua *lua = static_cast<Lua *>(lua_touserdata(L, lua_upvalueindex(1)));
+        const char *module = lua_tostring(L, 1);
+        if (lua == nullptr || module == nullptr)
         {
-            return;
+            return 0;
         }
 
-        if (m_lastModTime != mtime)
+        string fileName = lua->searchModule(module);
+        if (fileName.empty())
         {
-            m_lastModTime = mtime;
+            return 0;
+        }
 
-            luaL_dofile(L, m_script.c_str());
+        lua->addDependency(module, fileName);
+        if (ScriptCache::getInstance()->load(L, fileName) != 0)
+        {
+            return luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+                module, fileName.c_str(), lua_tostring(L, -1));
         }
+
+        return 1;
     }
 
-    int Lua::start(const string &jobKey, const string &name, const string &sJson)
+    void Lua::addDependency(const string &module, const string &fileName)
+    {
+        if (m_modules.insert(module).second)
+        {
+            FileWatcher::getInstance()->watch(fileName, &m_dirty);
+        }
+    }
+
+    string Lua::searchModule(const string &module)
+    {
+        lua_getglobal(L, "package");
+        lua_getfield(L, -1, "path");
+        const char *str = lua_tostring(L, -1);
+        string path = str != nullptr ? str : "";
+        lua_pop(L, 2);
+
+        string name = module;
+        std::replace(name.begin(), name.end(), '.', '/');
+
+        size_t begin = 0;
+        while (begin <= path.size())
+        {
+            size_t end = path.find(';', begin);
+            if (end == string::npos)
+            {
+                end = path.size();
+            }
+
+            string fileName = path.substr(begin, end - begin);
+            size_t pos = 0;
+            while ((pos = fileName.find('?', pos)) != string::npos)
+            {
+                fileName.replace(pos, 1, name);
+                pos += name.size();
+            }
+
+            if (!fileName.empty() && access(fileName.c_str(), R_OK) == 0)
+            {
+                return fileName;
+            }
+
+            begin = end + 1;
+        }
+
+        return "";
+    }
+
+    int Lua::start(const string &jobKey, const string &name, Json::Value &value)
     {
         m_jobKey = jobKey;
 
-        luabind::object oTable = parseJson(sJson);
+        luabind::object oTable = processJson(value);
         oTable["job_key"] = jobKey;
         oTable["name"] = name;
         return doFunc("start", oTable);
     }
 
-    int Lua::update(const string &jobKey, const string &name, const string &sJson)
+    int Lua::update(const string &jobKey, const string &name, Json::Value &value)
     {
-        luabind::object oTable = parseJson(sJson);
+        luabind::object oTable = processJson(value);
         oTable["job_key"] = jobKey;
         oTable["name"] = name;
         return doFunc("update", oTable);
     }
 
+    int Lua::updateLayout(const string &jobKey, const string &name, Json::Value &diff)
+    {
+        luabind::object oTable = processJson(diff);
+        oTable["job_key"] = jobKey;
+        oTable["name"] = name;
+        return doFunc("updateLayout", oTable);
+    }
+
     int Lua::process()
     {
         return doFunc("process");
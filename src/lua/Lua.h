@@ -34,6 +34,8 @@ extern "C"
 #include "lualib.h"
 }
 
+#include <atomic>
+#include <set>
 #include <string>
 
 struct lua_State;
@@ -61,10 +63,12 @@ namespace hercules
 
         void initScript(const std::string &script);
         void reloadScript();
+        void addDependency(const std::string &module, const std::string &fileName);
 
-        int start(const std::string &jobKey, const std::string &name, const std::string &sJson);
+        int start(const std::string &jobKey, const std::string &name, Json::Value &value);
         int stop();
-        int update(const std::string &jobKey, const std::string &name, const std::string &sJson);
+        int update(const std::string &jobKey, const std::string &name, Json::Value &value);
+        int updateLayout(const std::string &jobKey, const std::string &name, Json::Value &diff);
 
         int process();
 
@@ -83,7 +87,11 @@ namespace hercules
         {
             try
             {
-                reloadScript();
+                // set by FileWatcher, reload between calls instead of stat() every time
+                if (m_dirty)
+                {
+                    reloadScript();
+                }
                 luabind::call_function<void>(L, sFunc.c_str(), args...);
             }
             catch (luabind::error &ex)
@@ -101,21 +109,18 @@ namespace hercules
             return 0;
         }
 
-        int getFileLastModTime(time_t &mtime)
-        {
-            struct stat f_stat;
-            int ret = stat(m_script.c_str(), &f_stat);
-            mtime = f_stat.st_mtime;
-
-            return ret;
-        }
-
         int luabindErrorHandler(lua_State *L);
 
+    private:
+        void hookRequire();
+        std::string searchModule(const std::string &module);
+        static int traceRequire(lua_State *L);
+
     private:
         lua_State *L;
         std::string m_script;
-        time_t m_lastModTime;
+        std::atomic<bool> m_dirty;
+        std::set<std::string> m_modules;
 
         std::string m_jobKey;
     };
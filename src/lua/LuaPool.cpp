@@ -0,0 +1,218 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "LuaPool.h"
+#include "FileWatcher.h"
+#include "ScriptCache.h"
+#include "Lua.h"
+#include "Log.h"
+
+#include <chrono>
+#include <string>
+
+namespace hercules
+{
+
+    LuaPool::LuaPool()
+    {
+        // pooled vms use both on destruction, make sure they outlive the pool
+        FileWatcher::getInstance();
+        ScriptCache::getInstance();
+
+        // first acquire runs on a job thread, do not inherit its placement
+        ThreadGroupGuard guard("");
+        startThread("LuaPool");
+    }
+
+    LuaPool::~LuaPool()
+    {
+        stopThread();
+        m_cond.notify_all();
+        joinThread();
+
+        for (auto &kv : m_scripts)
+        {
+            for (auto lua : kv.second.m_ready)
+            {
+                delete lua;
+            }
+        }
+        m_scripts.clear();
+    }
+
+    Lua *LuaPool::acquire(const std::string &script)
+    {
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            Script &entry = m_scripts[script];
+            entry.m_lastUseMs = getNowMs();
+            m_cond.notify_one();
+            if (!entry.m_ready.empty())
+            {
+                Lua *lua = entry.m_ready.front();
+                entry.m_ready.pop_front();
+                ++entry.m_users;
+                return lua;
+            }
+        }
+
+        logInfo(MIXLOG << "no ready vm, build in place, script: " << script);
+        Lua *lua = new Lua;
+        lua->initScript(script);
+
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        ++m_scripts[script].m_users;
+        return lua;
+    }
+
+    void LuaPool::release(const std::string &script)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        auto iter = m_scripts.find(script);
+        if (iter != m_scripts.end() && iter->second.m_users > 0)
+        {
+            --iter->second.m_users;
+            iter->second.m_lastUseMs = getNowMs();
+        }
+    }
+
+    void LuaPool::prewarm(const std::string &script, size_t count)
+    {
+        std::unique_lock<std::mutex> lockGuard(m_mutex);
+        Script &entry = m_scripts[script];
+        entry.m_target = count;
+        entry.m_prewarmed = true;
+        m_cond.notify_one();
+    }
+
+    bool LuaPool::findShortScript(std::string &script)
+    {
+        if (readyCount() >= kLuaPoolMaxReady)
+        {
+            return false;
+        }
+
+        // most recently used script first
+        const std::pair<const std::string, Script> *best = nullptr;
+        for (const auto &kv : m_scripts)
+        {
+            if (kv.second.m_ready.size() < kv.second.m_target
+                && (best == nullptr || kv.second.m_lastUseMs > best->second.m_lastUseMs))
+            {
+                best = &kv;
+            }
+        }
+        if (best == nullptr)
+        {
+            return false;
+        }
+        script = best->first;
+        return true;
+    }
+
+    size_t LuaPool::readyCount() const
+    {
+        size_t count = 0;
+        for (const auto &kv : m_scripts)
+        {
+            count += kv.second.m_ready.size();
+        }
+        return count;
+    }
+
+    std::vector<Lua *> LuaPool::evictIdle()
+    {
+        std::vector<Lua *> evicted;
+        uint64_t now = getNowMs();
+        for (auto iter = m_scripts.begin(); iter != m_scripts.end();)
+        {
+            const Script &entry = iter->second;
+            if (entry.m_prewarmed || entry.m_users > 0 || entry.m_lastUseMs + kLuaPoolIdleMs > now)
+            {
+                ++iter;
+                continue;
+            }
+            logInfo(MIXLOG << "drop idle script: " << iter->first << ", ready: " << entry.m_ready.size());
+            evicted.insert(evicted.end(), entry.m_ready.begin(), entry.m_ready.end());
+            iter = m_scripts.erase(iter);
+        }
+
+        // over the cap, e.g. after prewarm, the least recently used scripts give up theirs
+        size_t ready = readyCount();
+        while (ready > kLuaPoolMaxReady)
+        {
+            Script *oldest = nullptr;
+            for (auto &kv : m_scripts)
+            {
+                if (!kv.second.m_ready.empty() && (oldest == nullptr || kv.second.m_lastUseMs < oldest->m_lastUseMs))
+                {
+                    oldest = &kv.second;
+                }
+            }
+            evicted.push_back(oldest->m_ready.back());
+            oldest->m_ready.pop_back();
+            --ready;
+        }
+        return evicted;
+    }
+
+    void LuaPool::threadEntry()
+    {
+        while (!isStop())
+        {
+            checkTimer();
+
+            std::string script;
+            {
+                std::unique_lock<std::mutex> lockGuard(m_mutex);
+                if (!findShortScript(script))
+                {
+                    m_cond.wait_for(lockGuard, std::chrono::milliseconds(100));
+                    continue;
+                }
+            }
+
+            uint64_t begin = getNowMs();
+            Lua *lua = new Lua;
+            lua->initScript(script);
+
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            auto iter = m_scripts.find(script);
+            if (iter == m_scripts.end())
+            {
+                // dropped as idle while building
+                lockGuard.unlock();
+                delete lua;
+                continue;
+            }
+            iter->second.m_ready.push_back(lua);
+            logInfo(MIXLOG << "vm ready, script: " << script << ", cost: " << getNowMs() - begin
+                << ", ready: " << iter->second.m_ready.size());
+        }
+    }
+
+    void LuaPool::oneSecondTimeout(uint64_t)
+    {
+        std::vector<Lua *> evicted;
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            evicted = evictIdle();
+        }
+        for (auto lua : evicted)
+        {
+            delete lua;
+        }
+    }
+
+} // namespace hercules
@@ -0,0 +1,89 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "OneCycleThread.h"
+#include "Singleton.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace hercules
+{
+
+    class Lua;
+
+    // ready vms kept per script
+    constexpr size_t kLuaPoolSize = 4;
+    // ready vms kept over all scripts, the least recently used give theirs up first
+    constexpr size_t kLuaPoolMaxReady = 8;
+    // a script no job has used for this long loses its ready vms
+    constexpr uint64_t kLuaPoolIdleMs = 60 * 1000;
+
+    // vms with bindings registered and script loaded, built in the background
+    // so a starting job does not pay for it, a lua_State can not be cloned
+    // so each template is handed out once and replaced.
+    // the script's top level runs on the pool thread long before, or without,
+    // a job using the vm, so it must only define functions and tables: no io,
+    // no calls into the job and nothing that depends on when it runs
+    class LuaPool : public OneCycleThread, public Singleton<LuaPool>
+    {
+        friend class Singleton<LuaPool>;
+
+    private:
+        LuaPool();
+        ~LuaPool();
+
+    public:
+        // ready vm for script, built in place if none is ready yet
+        Lua *acquire(const std::string &script);
+        // the job that acquired a vm for script has deleted it
+        void release(const std::string &script);
+
+        // keep count vms ready for script, also when no job uses it
+        void prewarm(const std::string &script, size_t count = kLuaPoolSize);
+
+        virtual void threadEntry();
+        virtual void oneSecondTimeout(uint64_t counter);
+
+    private:
+        struct Script
+        {
+            Script() : m_target(kLuaPoolSize), m_prewarmed(false), m_users(0), m_lastUseMs(0) {}
+
+            size_t m_target;
+            bool m_prewarmed;
+            // jobs running a vm of this script
+            size_t m_users;
+            uint64_t m_lastUseMs;
+            std::deque<Lua *> m_ready;
+        };
+
+        bool findShortScript(std::string &script);
+        size_t readyCount() const;
+        // under m_mutex, the vms to delete are returned, closing one is slow
+        std::vector<Lua *> evictIdle();
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::map<std::string, Script> m_scripts;
+    };
+
+} // namespace hercules
@@ -0,0 +1,83 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ScriptCache.h"
+#include "Log.h"
+
+#include <sys/stat.h>
+
+#include <string>
+
+namespace hercules
+{
+
+    int ScriptCache::writer(lua_State *, const void *p, size_t size, void *ud)
+    {
+        static_cast<std::string *>(ud)->append(static_cast<const char *>(p), size);
+        return 0;
+    }
+
+    int ScriptCache::load(lua_State *L, const std::string &fileName)
+    {
+        struct stat st;
+        if (stat(fileName.c_str(), &st) != 0)
+        {
+            return luaL_loadfile(L, fileName.c_str());
+        }
+        int64_t mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+        std::shared_ptr<const std::string> bytecode;
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            auto iter = m_entries.find(fileName);
+            if (iter != m_entries.end() && iter->second.m_mtimeNs == mtimeNs
+                && iter->second.m_size == st.st_size)
+            {
+                bytecode = iter->second.m_bytecode;
+            }
+        }
+
+        std::string chunkName = "@" + fileName;
+        if (bytecode)
+        {
+            return luaL_loadbuffer(L, bytecode->data(), bytecode->size(), chunkName.c_str());
+        }
+
+        int ret = luaL_loadfile(L, fileName.c_str());
+        if (ret != 0)
+        {
+            return ret;
+        }
+
+        std::shared_ptr<std::string> dump = std::make_shared<std::string>();
+        if (lua_dump(L, &ScriptCache::writer, dump.get()) != 0)
+        {
+            logWarn(MIXLOG << "dump script: " << fileName << " fail, not cached");
+            return ret;
+        }
+
+        Entry entry;
+        entry.m_mtimeNs = mtimeNs;
+        entry.m_size = st.st_size;
+        entry.m_bytecode = dump;
+        {
+            std::unique_lock<std::mutex> lockGuard(m_mutex);
+            m_entries[fileName] = entry;
+        }
+
+        logInfo(MIXLOG << "cache script: " << fileName << ", bytecode size: " << dump->size());
+        return ret;
+    }
+
+} // namespace hercules
@@ -0,0 +1,64 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "Singleton.h"
+
+extern "C"
+{
+#include "lua.h"
+#include "lauxlib.h"
+}
+
+#include <sys/types.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace hercules
+{
+
+    // compiled chunks shared by all vms, keyed by path and checked against
+    // mtime/size on lookup so an edited file is compiled again
+    class ScriptCache : public Singleton<ScriptCache>
+    {
+        friend class Singleton<ScriptCache>;
+
+    private:
+        ScriptCache() {}
+        ~ScriptCache() {}
+
+    public:
+        // same contract as luaL_loadfile: chunk or error message on top of L
+        int load(lua_State *L, const std::string &fileName);
+
+    private:
+        static int writer(lua_State *L, const void *p, size_t size, void *ud);
+
+    private:
+        struct Entry
+        {
+            int64_t m_mtimeNs;
+            off_t m_size;
+            std::shared_ptr<const std::string> m_bytecode;
+        };
+
+        std::mutex m_mutex;
+        std::map<std::string, Entry> m_entries;
+    };
+
+} // namespace hercules
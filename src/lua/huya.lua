@@ -80,6 +80,21 @@ font_file = font_file
 _G.painter = _G.painter
 
 _G.onPull = _G.onPull or {}
+-- last visibility sent to the decoder of each pulled stream
+_G.stream_visible = _G.stream_visible or {}
+_G.stream_display_size = _G.stream_display_size or {}
+_G.decode_fps = _G.decode_fps or 0
+_G.skipped_blend = _G.skipped_blend or 0
+-- degradation level from reportMixTick, see OverloadLevel in OverloadControl.h
+OVERLOAD_FAST_RESIZE = 1
+OVERLOAD_NO_ANTIALIAS = 2
+OVERLOAD_FAST_PRESET = 3
+OVERLOAD_DECIMATE = 4
+_G.overload_level = _G.overload_level or 0
+-- bumped by anything that may change the picture, see canRepeatCanvas
+_G.canvas_version = _G.canvas_version or 0
+_G.repeated_canvas = _G.repeated_canvas or 0
+_G.mix_video_fps = _G.mix_video_fps or 0
 _G.onPush = _G.onPush or {}
 _G.onDown = _G.onDown or {}
 
@@ -185,6 +200,8 @@ InitAnim()
 function start(table)
     LOG("lua start")
     update_ms()
+    -- the top level ran when the pool built this vm, the job starts now
+    start_ms_ = now_ms_
     LogTableWithIndent('', table)
     resourceInit(table)
     addPushStream(table.out_stream)
@@ -208,6 +225,7 @@ function resourceInit(table)
     _G.pre_input_streamname_list = {}
     _G.cur_input_streamname_list = {}
     _G.painter = OpenCVOperator()
+    _G.overload_level = 0
 
     _G.streamlist = {}
     _G.imagelist = {}
@@ -220,6 +238,7 @@ function resourceInit(table)
     _G.state_trace_time_ms = now_ms()
 
     _G.job_key = table.task_id
+    _G.job_offline = isJobOffline(_G.job_key)
     _G.out_stream_name = table.out_stream.stream_name
 
     _G.mix_audio_tick = 0
@@ -301,6 +320,11 @@ function addPushStream(value)
     name = value.stream_name
 
     if _G.onPush[name] == nil then
+        if value.push_type == 'frame_bus' then
+            addFrameBusStream(value)
+            return
+        end
+
         property = value
 
         if property.codec.video ~= nil then
@@ -308,9 +332,20 @@ function addPushStream(value)
         end
 
         outStream = {}
+        if value.destinations ~= nil then
+            value.push_type = 'fanout'
+        end
         stream_publisher = PublisherWrapper(value.push_type, _G.job_key)
         trace_uid = 1
         stream_publisher:setPushParam(name, name, trace_uid)
+        if value.destinations ~= nil then
+            -- destinations are added before the codecs so they pick them up too
+            for _, dest in ipairs(value.destinations) do
+                if stream_publisher:addDestination(dest.push_type, dest.url or '') ~= 0 then
+                    WARN('bad destination for ' .. name .. ', type:' .. tostring(dest.push_type))
+                end
+            end
+        end
         stream_publisher:addTraceInfo(_G.job_key, trace_uid, _G.out_stream_name)
 
         publish_stream_opt = StreamOpt()
@@ -323,10 +358,22 @@ function addPushStream(value)
         if value.codec.other ~= nil and value.codec.other.scriptag ~= nil then
             publish_stream_opt.m_publishDataStream = true
         end
+        -- pacing is opt-in, an offline render runs ahead of the wall clock it paces against
+        if value.smooth ~= nil and not isJobOffline(_G.job_key) then
+            publish_stream_opt.m_smooth = value.smooth
+        end
+        if value.max_burst_ms ~= nil then
+            publish_stream_opt.m_maxBurstMs = value.max_burst_ms
+        end
+        if value.catch_up_rate ~= nil then
+            publish_stream_opt.m_catchUpRate = value.catch_up_rate
+        end
         stream_publisher:setOpt(publish_stream_opt)
 
         outStream.video_queue = MediaFrameQueue()
         outStream.audio_queue = MediaFrameQueue()
+        registerJobOutput(_G.job_key, outStream.video_queue)
+        registerJobOutput(_G.job_key, outStream.audio_queue)
         outStream.name = name
         outStream.state = 1
 
@@ -341,6 +388,7 @@ function addPushStream(value)
             encoder:init(name, outStream.video_queue, stream_publisher:getVideoQueue()) -- TODO maybe err
             encoder:setCodec(video_codec.width, video_codec.height,
                 video_codec.fps, video_codec.kbps, video_codec.codec)
+            encoder:setFastPreset(_G.overload_level >= OVERLOAD_FAST_PRESET)
 
             outStream.encoder = encoder
             encoder:start()
@@ -366,9 +414,27 @@ function addPushStream(value)
                 codec = audio_codec.codec
             end
 
+            if codec == 'opus' and not canOpenAudioEncoder(codec, channels, 48000, audio_codec.frame_ms or 10) then
+                -- this build has no libopus, publish aac rather than no audio
+                WARN('out stream: ' .. name .. ', opus encoder unavailable, fall back to aac')
+                codec = 'aac'
+                audio_codec.codec = 'aac'
+            end
+
+            if codec == 'opus' then
+                -- inputs are resampled straight to opus frames, before jobInit adds them
+                sample_rate = 48000
+                audio_codec.frame_ms = opusFrameMs(audio_codec.frame_ms or 10)
+                setJobAudioOutput(_G.job_key, sample_rate, channels,
+                    sample_rate * audio_codec.frame_ms / 1000)
+            end
+
             audioEncoder = AudioEncoder()
             audioEncoder:init(name, outStream.audio_queue, stream_publisher:getAudioQueue())
             audioEncoder:setCodec(channels, sample_rate, 192, codec)
+            if codec == 'opus' then
+                audioEncoder:setFrameDuration(audio_codec.frame_ms)
+            end
             audioEncoder:start()
             outStream.audioEncoder = audioEncoder
         end
@@ -379,6 +445,33 @@ function addPushStream(value)
     LOG("addPushStream end")
 end
 
+-- mixed frames of a frame_bus output go raw to the jobs pulling its stream name,
+-- nothing is encoded or published
+function addFrameBusStream(value)
+    outStream = {}
+    outStream.video_queue = MediaFrameQueue()
+    outStream.audio_queue = MediaFrameQueue()
+    outStream.name = value.stream_name
+    outStream.state = 1
+    outStream.frame_bus = true
+    outStream.property = value
+    _G.onPush[value.stream_name] = outStream
+    LOG('add frame bus stream ' .. value.stream_name)
+end
+
+function publishBusFrame(name, frame, is_video)
+    local reached
+    if is_video then
+        reached = publishJobVideo(_G.job_key, name, frame)
+    else
+        reached = publishJobAudio(_G.job_key, name, frame)
+    end
+    if reached < 0 and not _G.onPush[name].bus_taken then
+        _G.onPush[name].bus_taken = true
+        WARN('out_stream_name:' .. _G.out_stream_name .. ', frame bus ' .. name .. ' is published by another job')
+    end
+end
+
 function addSimpleText(value)
     table.insert(_G.streamlist, value)
 end
@@ -410,6 +503,9 @@ function addPullStream(value)
         subscribeContext:subscribeVideoFrame()
         subscribeContext:subscribeAudioFrame()
         subscribeContext:subscribeJobFrame(_G.job_key, name)
+        if value.jitter_target ~= nil then
+            subscribeContext:setJitterTarget(value.jitter_target)
+        end
         LOG("addPullStream 3")
 
         inStream = {}
@@ -439,14 +535,59 @@ if _ANIM_ then
 end
 
 
+-- streamlist items created by each layout entry, keyed by layout_key
+_G.layout_items = _G.layout_items or {}
+
+function addLayoutItem(value)
+    local first = #_G.streamlist + 1
+    if initFunctionTable[value.type] ~= nil then
+        initFunctionTable[value.type](value)
+    else
+        table.insert(_G.streamlist, value)
+    end
+
+    if value.layout_key ~= nil then
+        local items = {}
+        for i = first, #_G.streamlist do
+            table.insert(items, _G.streamlist[i])
+        end
+        _G.layout_items[value.layout_key] = items
+    end
+end
+
+function removeLayoutItems(layout_key)
+    local items = _G.layout_items[layout_key]
+    if items == nil then
+        return
+    end
+    _G.layout_items[layout_key] = nil
+
+    for _, item in pairs(items) do
+        for i = #_G.streamlist, 1, -1 do
+            if _G.streamlist[i] == item then
+                table.remove(_G.streamlist, i)
+            end
+        end
+        if item.type == 'av_stream' then
+            for i = #_G.cur_input_streamname_list, 1, -1 do
+                if _G.cur_input_streamname_list[i] == item.stream_name then
+                    table.remove(_G.cur_input_streamname_list, i)
+                end
+            end
+        end
+    end
+end
+
+function markCanvasDirty()
+    _G.canvas_version = _G.canvas_version + 1
+end
+
 function jobInit(tables)
+    markCanvasDirty()
     _G.cur_input_streamname_list = {}
+    _G.layout_items = {}
     for key, value in pairs(tables) do
-        if initFunctionTable[value.type] ~= nil then
-            initFunctionTable[value.type](value)
-        else
-            table.insert(_G.streamlist, value)
-        end
+        addLayoutItem(value)
     end
 end
 
@@ -480,15 +621,17 @@ function checkOutput(output)
             _G.out_stream_name = name
             FDLOG('MediaLua', 'job_key:' .. _G.job_key .. ', out stream change:' .. key .. ' -> ' .. name)
             LOG('job_key:' .. _G.job_key .. ', out stream change:' .. key .. ' -> ' .. name .. ', publish again')
-            value.pusher:stop()
-            value.pusher:join()
-
-            value.pusher:setPushParam(name, name, _G.output_uid)
-            value.pusher:removeTraceInfo(_G.job_key, _G.output_uid, key)
-            value.pusher:addTraceInfo(_G.job_key, _G.output_uid, _G.out_stream_name)
-            value.pusher:setStreamName(_G.out_stream_name)
             value.name = name
-            value.pusher:start()
+            if value.pusher ~= nil then
+                value.pusher:stop()
+                value.pusher:join()
+
+                value.pusher:setPushParam(name, name, _G.output_uid)
+                value.pusher:removeTraceInfo(_G.job_key, _G.output_uid, key)
+                value.pusher:addTraceInfo(_G.job_key, _G.output_uid, _G.out_stream_name)
+                value.pusher:setStreamName(_G.out_stream_name)
+                value.pusher:start()
+            end
 
             if value.encoder ~= nil then
                 value.encoder:removeTraceInfo(_G.job_key, _G.output_uid, key)
@@ -531,8 +674,10 @@ function checkOutput(output)
                 h = _G.onPush[name].property.codec.video.height
                 if w ~= output.codec.video.width or h ~= output.codec.video.height then
                     LOG('out_stream_name:' .. _G.out_stream_name .. ',output change! setCodec:'.. output.codec.video.height)
-                    _G.onPush[name].encoder:setCodec(output.codec.video.width, output.codec.video.height, output.codec.video.fps,
-                                                     output.codec.video.kbps, output.codec.video.codec)
+                    if _G.onPush[name].encoder ~= nil then
+                        _G.onPush[name].encoder:setCodec(output.codec.video.width, output.codec.video.height, output.codec.video.fps,
+                                                         output.codec.video.kbps, output.codec.video.codec)
+                    end
                     _G.onPush[name].property = output
                     LOG('out_stream_name:' .. _G.out_stream_name .. ',w:'
                         .. _G.onPush[name].property.codec.video.width .. ',h:' .. _G.onPush[name].property.codec.video.height)
@@ -560,13 +705,39 @@ function update(table)
 
 end
 
+-- diff from LayoutModel: removed and changed entries carry layout_key,
+-- out_stream is only present when it changed
+function updateLayout(diff)
+    markCanvasDirty()
+    if diff.removed ~= nil then
+        for _, value in pairs(diff.removed) do
+            removeLayoutItems(value.layout_key)
+        end
+    end
+
+    if diff.changed ~= nil then
+        for _, value in pairs(diff.changed) do
+            removeLayoutItems(value.layout_key)
+            addLayoutItem(value)
+        end
+    end
+
+    if diff.out_stream ~= nil then
+        fillPushDefaultArgs(diff.out_stream)
+        checkOutput(diff.out_stream)
+        updateBgColor(diff.out_stream)
+    end
+end
+
 function stop()
 
     for key,value in pairs(_G.onPush) do
-        LOG('stop push:' .. key)
-        value.pusher:stop()
-        LOG('join push:' .. key)
-        value.pusher:join()
+        if value.pusher ~= nil then
+            LOG('stop push:' .. key)
+            value.pusher:stop()
+            LOG('join push:' .. key)
+            value.pusher:join()
+        end
 
         if value.encoder ~= nil then
             LOG('stop encoder:' .. key)
@@ -603,6 +774,7 @@ function http_url_update()
                 end
                 _G.imagelist[value.content].bin = logo
                 table.insert(_G.streamlist, value)
+                markCanvasDirty()
             end
         else
             newOnDown[key] = value
@@ -611,21 +783,37 @@ function http_url_update()
     _G.onDown = newOnDown
 end
 
+-- earliest virtual time a mix tick is due, offline jobs jump their clock there
+function dueMixTick(tick, tick_ms)
+    due = math.ceil((tick + 1) * tick_ms)
+    if _G.next_mix_ms == nil or due < _G.next_mix_ms then
+        _G.next_mix_ms = due
+    end
+end
+
 function process()
     update_ms()
 
+    _G.next_mix_ms = nil
     for k, v in pairs(_G.onPush) do
         if _G.onPush[k].property.codec.audio ~= nil then
             onAudioMix(k)
+            dueMixTick(_G.mix_audio_tick, frame_ms)
         end
         if _G.onPush[k].property.codec.video ~= nil then
             onVideoMix(k)
+            dueMixTick(_G.mix_video_tick, frame_ms)
         end
     end
+    if _G.job_offline and _G.next_mix_ms ~= nil then
+        setJobNextTick(_G.job_key, _G.next_mix_ms)
+    end
 
     if now_ms() - _G.state_trace_time_ms >= 1000 then
         _G.state_trace_time_ms = now_ms()
         LOG('memory use:' .. collectgarbage("count") .. ' KB')
+        LOG('out_stream_name:' .. _G.out_stream_name .. ', skipped blend:' .. _G.skipped_blend
+            .. ', overload level:' .. _G.overload_level .. ', repeated canvas:' .. _G.repeated_canvas)
     end
 end
 
@@ -638,7 +826,7 @@ function onAudioMix(name)
     frame_ms = 44100.0/2048.0
 
     if _G.onPush[name].property.codec.audio.codec == 'opus' then
-        frame_ms = 10
+        frame_ms = _G.onPush[name].property.codec.audio.frame_ms or 10
     end
 
     if _G.mix_audio_tick == 0 then
@@ -666,7 +854,7 @@ function onAudioMix(name)
         audio_frame = MediaFrame()
         audio_queue = value.subscribeContext:getAudioFrameQueue()
         if audio_queue ~= nil then
-            if audio_queue:pop(audio_frame, 0) then
+            if value.subscribeContext:popAudioFrame(audio_frame) then
                 onPull[key].time_ref = audio_frame:getDts()
                 if dst_frame == nil then
                     dst_frame = audio_frame
@@ -679,7 +867,14 @@ function onAudioMix(name)
     end
 
     if dst_frame ~= nil then
-        onPush[name].audio_queue:push(now_ms(), dst_frame)
+        if onPush[name].frame_bus then
+            -- subscribers align the canvas to this audio, both stamped with our mix clock
+            dst_frame:setDts(now_ms())
+            dst_frame:setPts(now_ms())
+            publishBusFrame(name, dst_frame, false)
+        else
+            onPush[name].audio_queue:push(now_ms(), dst_frame)
+        end
     end
 end
 
@@ -688,9 +883,11 @@ function collectFrame()
         video_small_frame = MediaFrame()
         video_queue = value.subscribeContext:getVideoFrameQueue()
         if video_queue ~= nil then
-            if video_queue:pop_by_given_time_ref(value.time_ref, video_small_frame) then
+            -- live inputs play out through their jitter buffer, time_ref only serves offline jobs
+            if value.subscribeContext:popVideoFrame(video_small_frame, value.time_ref) then
                 value.frame = video_small_frame
                 value.getVideo = true
+                markCanvasDirty()
             end
         end
     end
@@ -1101,40 +1298,192 @@ if _ANIM_ then
     _ANIM_.InitMixFunc(mixFunctionTable)
 end
 
-function onVideoMix(name)
-    fps = _G.onPush[name].property.codec.video.fps
-    _G.push_fps = fps
-    frame_ms = 1000.0/fps
-    tick = now_ms() / frame_ms
+-- layers that only change through markCanvasDirty, animations redraw every tick
+staticLayerTypes =
+{
+    image_url = true,
+    av_stream = true,
+    single_text = true,
+    image_resource = true
+}
 
-    if _G.mix_video_tick == 0 then
-        _G.mix_video_tick = math.floor(now_ms() / frame_ms)
-        return
+-- a push stream re-sends its last canvas while nothing changed since it was drawn,
+-- the encoder skips repeated canvases
+function canRepeatCanvas(out)
+    if out.last_canvas == nil or out.canvas_version ~= _G.canvas_version then
+        return false
+    end
+    for _, value in pairs(_G.streamlist) do
+        if not staticLayerTypes[value.type] then
+            return false
+        end
     end
+    return true
+end
 
-    if tick - _G.mix_video_tick < 1.0 then
-        return
+-- an av_stream layer hides whatever lies fully inside its rect below it
+function isOpaqueLayer(value)
+    if value.type ~= 'av_stream' or value.hidden == true or value.clip_polygon ~= nil then
+        return false
     end
+    if value.mix_type ~= 0 and value.mix_type ~= 2 then
+        return false
+    end
+    local pull = _G.onPull[value.stream_name]
+    return pull ~= nil and pull.frame ~= nil and not pull.frame:isTransparentLayer()
+end
 
-    if debug_flag then
-        diff = now_ms() - _G.pre_mix_video_ms
-        LOG('out_stream_name:' .. _G.out_stream_name .. ', get mixed video diff:' .. diff)
+-- streamlist is sorted bottom to top, walk it top down collecting opaque rects
+function computeVisibility(w, h)
+    local visible = {}
+    local covers = {}
+    for i = #_G.streamlist, 1, -1 do
+        local value = _G.streamlist[i]
+        local rect = value.put_rect
+        local shown = value.hidden ~= true
+        if shown and rect ~= nil then
+            local left = math.max(rect.left, 0)
+            local top = math.max(rect.top, 0)
+            local right = math.min(rect.right, w)
+            local bottom = math.min(rect.bottom, h)
+            shown = right > left and bottom > top
+            for _, c in ipairs(covers) do
+                if not shown then
+                    break
+                end
+                if c.left <= left and c.top <= top and c.right >= right and c.bottom >= bottom then
+                    shown = false
+                end
+            end
+            if shown and isOpaqueLayer(value) then
+                table.insert(covers, { left = left, top = top, right = right, bottom = bottom })
+            end
+        end
+        visible[i] = shown
     end
+    return visible
+end
 
-    _G.pre_mix_video_ms = now_ms()
-    _G.mix_video_tick = math.floor(tick)
+-- size of the source a layer needs, 0 when it can not be told
+function layerSourceSize(value)
+    local rect = value.put_rect
+    local pull = _G.onPull[value.stream_name]
+    if value.type ~= 'av_stream' or rect == nil or pull == nil or pull.frame == nil then
+        return 0, 0
+    end
+    local w = rect.right - rect.left
+    local h = rect.bottom - rect.top
+    local crop = value.crop_rect
+    if crop ~= nil and crop.right > crop.left and crop.bottom > crop.top then
+        w = math.ceil(w * pull.frame:getWidth() / (crop.right - crop.left))
+        h = math.ceil(h * pull.frame:getHeight() / (crop.bottom - crop.top))
+    end
+    return w, h
+end
 
-    collectFrame()
+function markDrawn(drawn, stream_name, w, h)
+    local size = drawn[stream_name]
+    if size == nil then
+        drawn[stream_name] = { w = w, h = h }
+    elseif size.w > 0 and w > 0 then
+        size.w = math.max(size.w, w)
+        size.h = math.max(size.h, h)
+    else
+        size.w = 0
+        size.h = 0
+    end
+end
+
+-- a pulled stream stays decoded while any of its layers is drawn, and is
+-- decoded for the largest of them
+function updateStreamHints(visible)
+    local drawn = {}
+    for i, value in ipairs(_G.streamlist) do
+        if visible[i] then
+            if value.stream_name ~= nil then
+                markDrawn(drawn, value.stream_name, layerSourceSize(value))
+            end
+            -- containers draw their children wherever they like
+            if value.input_list ~= nil then
+                for _, element in pairs(value.input_list) do
+                    if element.stream_name ~= nil then
+                        markDrawn(drawn, element.stream_name, 0, 0)
+                    end
+                end
+            end
+        end
+    end
+    for stream_name, _ in pairs(_G.onPull) do
+        local size = drawn[stream_name]
+        local shown = size ~= nil
+        if _G.stream_visible[stream_name] ~= shown then
+            _G.stream_visible[stream_name] = shown
+            LOG('out_stream_name:' .. _G.out_stream_name .. ', stream:' .. stream_name .. ' visible:' .. tostring(shown))
+            setStreamVisible(_G.job_key, stream_name, shown)
+        end
+        if shown then
+            local pre = _G.stream_display_size[stream_name]
+            if pre == nil or pre.w ~= size.w or pre.h ~= size.h then
+                _G.stream_display_size[stream_name] = size
+                setStreamDisplaySize(_G.job_key, stream_name, size.w, size.h)
+            end
+        end
+    end
+end
+
+function applyOverloadLevel(level)
+    if level == _G.overload_level then
+        return
+    end
+    LOG('out_stream_name:' .. _G.out_stream_name .. ', overload level:' .. _G.overload_level .. ' -> ' .. level)
+    markCanvasDirty()
+    _G.painter:setFastResize(level >= OVERLOAD_FAST_RESIZE)
+    _G.painter:setAntiAlias(level < OVERLOAD_NO_ANTIALIAS)
+    for _, push in pairs(_G.onPush) do
+        if push.encoder ~= nil then
+            push.encoder:setFastPreset(level >= OVERLOAD_FAST_PRESET)
+        end
+    end
+    _G.overload_level = level
+end
 
+-- frame rate the mixer runs at, halved while decimating
+function mixFps(fps)
+    fps = tonumber(fps) or 0
+    if _G.overload_level >= OVERLOAD_DECIMATE then
+        return fps / 2
+    end
+    return fps
+end
+
+-- inputs only need to be decoded as often as the fastest output samples them
+function updateOutputFps()
+    local max_fps = 0
+    for _, push in pairs(_G.onPush) do
+        if push.property.codec.video ~= nil then
+            max_fps = math.max(max_fps, math.ceil(mixFps(push.property.codec.video.fps)))
+        end
+    end
+    if max_fps ~= _G.decode_fps then
+        _G.decode_fps = max_fps
+        setJobOutputFps(_G.job_key, max_fps)
+    end
+end
+
+function composeCanvas(name)
     video_frame = MediaFrame()
     w = _G.onPush[name].property.codec.video.width
     h = _G.onPush[name].property.codec.video.height
     _G.painter:createYUV(video_frame, w, h, _G.bg_y, _G.bg_u, _G.bg_v)
 
     table.sort(_G.streamlist, _G.sort_function)
+    visible = computeVisibility(w, h)
+    updateStreamHints(visible)
     for key, value in pairs(_G.streamlist) do
 	LOG('@ pktrace, out_stream_name:' .. _G.out_stream_name .. ' z_order: ' .. key .. ' type: '..value.type)
-        if mixFunctionTable[value.type] ~= nil then
+        if not visible[key] then
+            _G.skipped_blend = _G.skipped_blend + 1
+        elseif mixFunctionTable[value.type] ~= nil then
             mixFunctionTable[value.type](video_frame, value)
         end
     end
@@ -1152,6 +1501,53 @@ function onVideoMix(name)
 
     mixImage(video_frame, user_logo)
 
+    return video_frame
+end
+
+function onVideoMix(name)
+    updateOutputFps()
+    fps = mixFps(_G.onPush[name].property.codec.video.fps)
+    _G.push_fps = fps
+    frame_ms = 1000.0/fps
+    tick = now_ms() / frame_ms
+
+    -- ticks count in frames, restart the count when the frame rate changes
+    if _G.mix_video_tick == 0 or fps ~= _G.mix_video_fps then
+        _G.mix_video_fps = fps
+        _G.mix_video_tick = math.floor(now_ms() / frame_ms)
+        return
+    end
+
+    if tick - _G.mix_video_tick < 1.0 then
+        return
+    end
+
+    late_ms = math.floor((tick - _G.mix_video_tick - 1.0) * frame_ms)
+    applyOverloadLevel(reportMixTick(_G.job_key, late_ms, math.floor(frame_ms),
+        _G.onPush[name].video_queue:size()))
+
+    if debug_flag then
+        diff = now_ms() - _G.pre_mix_video_ms
+        LOG('out_stream_name:' .. _G.out_stream_name .. ', get mixed video diff:' .. diff)
+    end
+
+    _G.pre_mix_video_ms = now_ms()
+    _G.mix_video_tick = math.floor(tick)
+
+    collectFrame()
+
+    local out = _G.onPush[name]
+    if canRepeatCanvas(out) then
+        video_frame = out.last_canvas
+        -- a repeat carries no new input, its old stamps would only inflate the stage latencies
+        video_frame:clearTimeTrace()
+        _G.repeated_canvas = _G.repeated_canvas + 1
+    else
+        out.canvas_version = _G.canvas_version
+        video_frame = composeCanvas(name)
+        out.last_canvas = video_frame
+    end
+
     _G.dump_file_tick = _G.dump_file_tick + 1
     if dump_file_tick == _G.dump_file_interval then
 
@@ -1182,5 +1578,9 @@ function onVideoMix(name)
         LOG('out_stream_name:' .. _G.out_stream_name .. ', video dts:' .. video_dts)
     end
 
-    onPush[name].video_queue:push(video_frame:getDts(), video_frame)
+    if onPush[name].frame_bus then
+        publishBusFrame(name, video_frame, true)
+    else
+        onPush[name].video_queue:push(video_frame:getDts(), video_frame)
+    end
 end
@@ -16,6 +16,7 @@
 #include "MediaFrame.h"
 #include "Log.h"
 #include "ByteUtil.h"
+#include "Util.h"
 #include "Common.h"
 
 #include <arpa/inet.h>
@@ -109,6 +110,15 @@ namespace hercules
 
     void FFmpegAudioMixer::mixFrame(MediaFrame &src, MediaFrame &dst)
     {
+        if (!dst.makeWritable())
+        {
+            return;
+        }
+        // dst starts out as the first input's frame, its own record gets the stamp too
+        uint32_t nowMs = getNowMs32();
+        dst.mergeIdTimeTrace(src.getStreamIndex(), src.getDts(), src);
+        dst.addIdTimeTrace(src.getStreamIndex(), TimeTraceKey::MIXED, nowMs);
+        dst.addIdTimeTrace(dst.getStreamIndex(), TimeTraceKey::MIXED, nowMs);
         AVFrame *frameSrc = src.getAVFrame();
         AVFrame *frameDst = dst.getAVFrame();
         if(frameSrc == nullptr || frameDst == nullptr)
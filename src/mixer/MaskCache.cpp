@@ -0,0 +1,127 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "MaskCache.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace hercules
+{
+
+    const ShapeMask &MaskCache::polygon(const std::vector<std::vector<cv::Point>> &contours,
+        int width, int height, int scale, int lineType)
+    {
+        scale = std::max(1, scale);
+        Key key = {SHAPE_POLYGON, width, height, scale, lineType};
+        for (const auto &contour : contours)
+        {
+            key.push_back(static_cast<int>(contour.size()));
+            for (const auto &point : contour)
+            {
+                key.push_back(point.x);
+                key.push_back(point.y);
+            }
+        }
+
+        const ShapeMask *mask = find(key);
+        if (mask != nullptr)
+        {
+            return *mask;
+        }
+
+        std::vector<std::vector<cv::Point>> scaled = contours;
+        for (auto &contour : scaled)
+        {
+            for (auto &point : contour)
+            {
+                point.x *= scale;
+                point.y *= scale;
+            }
+        }
+
+        cv::Mat luma(height * scale, width * scale, CV_8UC1, cv::Scalar(0));
+        cv::fillPoly(luma, scaled, cv::Scalar(255), lineType);
+        if (scale > 1)
+        {
+            cv::resize(luma, luma, cv::Size(width, height), 0.0, 0.0, cv::INTER_AREA);
+        }
+        return insert(key, luma);
+    }
+
+    const ShapeMask &MaskCache::circle(const cv::Point &center, int radius, int width, int height,
+        int lineType)
+    {
+        Key key = {SHAPE_CIRCLE, width, height, 1, lineType, center.x, center.y, radius};
+        const ShapeMask *mask = find(key);
+        if (mask != nullptr)
+        {
+            return *mask;
+        }
+
+        cv::Mat luma(height, width, CV_8UC1, cv::Scalar(0));
+        cv::circle(luma, center, radius, cv::Scalar(255), -1, lineType);
+        return insert(key, luma);
+    }
+
+    void MaskCache::clear()
+    {
+        m_entries.clear();
+        m_index.clear();
+        m_bytes = 0;
+    }
+
+    const ShapeMask *MaskCache::find(const Key &key)
+    {
+        auto iter = m_index.find(key);
+        if (iter == m_index.end())
+        {
+            ++m_misses;
+            return nullptr;
+        }
+
+        ++m_hits;
+        m_entries.splice(m_entries.begin(), m_entries, iter->second);
+        return &iter->second->second;
+    }
+
+    const ShapeMask &MaskCache::insert(const Key &key, const cv::Mat &luma)
+    {
+        ShapeMask mask;
+        mask.m_luma = luma;
+        cv::resize(luma, mask.m_chroma, cv::Size(luma.cols / 2, luma.rows / 2), 0.0, 0.0, cv::INTER_AREA);
+        size_t bytes = mask.m_luma.total() + mask.m_chroma.total();
+
+        // the newest mask always stays, even when it alone exceeds the budget
+        while (!m_entries.empty() && m_bytes + bytes > kMaskCacheBytes)
+        {
+            const ShapeMask &last = m_entries.back().second;
+            m_bytes -= last.m_luma.total() + last.m_chroma.total();
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+        }
+
+        m_entries.emplace_front(key, mask);
+        m_index[key] = m_entries.begin();
+        m_bytes += bytes;
+
+        logDebug(MIXLOG << "mask cache miss, size: " << luma.cols << "x" << luma.rows
+            << ", entries: " << m_entries.size() << ", bytes: " << m_bytes
+            << ", hits: " << m_hits << ", misses: " << m_misses);
+        return m_entries.front().second;
+    }
+
+} // namespace hercules
@@ -0,0 +1,77 @@
+// Copyright 2021 HUYA
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "opencv2/opencv.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace hercules
+{
+
+    // masks of all layouts of a job usually fit, a layout change evicts the old ones
+    constexpr size_t kMaskCacheBytes = 32 * 1024 * 1024;
+
+    // 8-bit coverage, 255 is fully inside the shape
+    struct ShapeMask
+    {
+        cv::Mat m_luma;      // w x h
+        cv::Mat m_chroma;    // w/2 x h/2, for the subsampled u and v planes
+    };
+
+    // rasterised shapes keyed by their parameters and target size, one per
+    // OpenCVOperator so no locking, least recently used masks go first
+    class MaskCache
+    {
+    public:
+        MaskCache() : m_bytes(0), m_hits(0), m_misses(0) {}
+
+        // filled like cv::fillPoly, scale > 1 rasterises at scale times the size
+        // and averages down
+        const ShapeMask &polygon(const std::vector<std::vector<cv::Point>> &contours,
+            int width, int height, int scale, int lineType);
+        const ShapeMask &circle(const cv::Point &center, int radius, int width, int height,
+            int lineType);
+
+        void clear();
+
+    private:
+        enum Shape
+        {
+            SHAPE_POLYGON = 0,
+            SHAPE_CIRCLE = 1,
+        };
+
+        typedef std::vector<int> Key;
+        typedef std::list<std::pair<Key, ShapeMask>> Entries;
+
+        const ShapeMask *find(const Key &key);
+        const ShapeMask &insert(const Key &key, const cv::Mat &luma);
+
+    private:
+        Entries m_entries;
+        std::map<Key, Entries::iterator> m_index;
+        size_t m_bytes;
+        uint64_t m_hits;
+        uint64_t m_misses;
+    };
+
+} // namespace hercules
@@ -55,9 +55,9 @@ namespace hercules
 
     extern int toWchar(const char *src, wchar_t *&dest, const char *locale = "en_US.utf8");
 
-#define RESIZE_ALGORITHM cv::INTER_LINEAR
-
     OpenCVOperator::OpenCVOperator()
+        : m_resizeAlgorithm(cv::INTER_LINEAR)
+        , m_clipLineType(LineTypes::LINE_AA)
     {
         try
         {
@@ -74,6 +74,8 @@ namespace hercules
     }
 
     OpenCVOperator::OpenCVOperator(const std::string &fontFile)
+        : m_resizeAlgorithm(cv::INTER_LINEAR)
+        , m_clipLineType(LineTypes::LINE_AA)
     {
         try
         {
@@ -104,6 +106,16 @@ namespace hercules
         }
     }
 
+    void OpenCVOperator::setFastResize(bool fast)
+    {
+        m_resizeAlgorithm = fast ? cv::INTER_NEAREST : cv::INTER_LINEAR;
+    }
+
+    void OpenCVOperator::setAntiAlias(bool antiAlias)
+    {
+        m_clipLineType = antiAlias ? LineTypes::LINE_AA : LineTypes::LINE_8;
+    }
+
     void OpenCVOperator::setFontType(const string &file)
     {
         if (!isFileExist(file))
@@ -245,12 +257,9 @@ namespace hercules
             int srcW = tMediaFrame.getWidth();
             int srcH = tMediaFrame.getHeight();
 
-            Mat alpha = cv::Mat(srcH, srcW, CV_32FC1);
-            alpha.setTo(0);
-
-            cv::fillPoly(alpha, contours, 255, LineTypes::LINE_AA);
-            cv::resize(alpha, alpha, cv::Size(srcW, srcH), 0.0, 0.0, RESIZE_ALGORITHM);
-            alpha = alpha / 255.0;
+            Mat alpha;
+            m_maskCache.polygon(contours, srcW, srcH, 1, m_clipLineType).m_luma.convertTo(
+                alpha, CV_32FC1, 1.0 / 255.0);
             tMediaFrame.setAlpha(alpha);
         }
         catch (cv::Exception &ex)
@@ -317,10 +326,9 @@ namespace hercules
                 return;
             }
 
-            Mat alpha = cv::Mat(RGBMat.rows, RGBMat.cols, CV_32FC1);
-            alpha.setTo(0);
-            circle(alpha, center, radius + 2, 255, -1, LineTypes::LINE_AA);
-            alpha = alpha / 255.0;
+            Mat alpha;
+            m_maskCache.circle(center, radius + 2, RGBMat.cols, RGBMat.rows, LineTypes::LINE_AA)
+                .m_luma.convertTo(alpha, CV_32FC1, 1.0 / 255.0);
             tMediaFrame.setAlpha(alpha);
         }
         catch (cv::Exception &ex)
@@ -351,10 +359,9 @@ namespace hercules
             int srcH = tMediaFrame.getHeight();
             Mat srcMat = cv::Mat(srcH * 3 / 2, srcW, CV_8UC1, srcBuffer);
 
-            Mat alpha = cv::Mat(srcH, srcW, CV_32FC1);
-            alpha.setTo(0);
-            circle(alpha, circleCenter, radius, 255, -1, LineTypes::LINE_AA);
-            alpha = alpha / 255.0;
+            Mat alpha;
+            m_maskCache.circle(circleCenter, radius, srcW, srcH, LineTypes::LINE_AA)
+                .m_luma.convertTo(alpha, CV_32FC1, 1.0 / 255.0);
             tMediaFrame.setAlpha(alpha);
         }
         catch (cv::Exception &ex)
@@ -497,7 +504,7 @@ namespace hercules
             {
                 w = w / 2 * 2;
                 h = h / 2 * 2;
-                cv::resize(mRgbLogo, mRgbLogo, cv::Size(w, h), 0.0, 0.0, RESIZE_ALGORITHM);
+                cv::resize(mRgbLogo, mRgbLogo, cv::Size(w, h), 0.0, 0.0, m_resizeAlgorithm);
             }
             std::vector<cv::Mat> channels;
             cv::split(mRgbLogo, channels);
@@ -568,16 +575,8 @@ namespace hercules
     {
         TimeUse t(__FUNCTION__);
 
-        dst.addIdTimestamp(src.getStreamId(), src.getDts());
-        auto timeTrace = src.getIdTimeTrace();
-        for (const auto &kv : timeTrace)
-        {
-            for (const auto &key_time : kv.second)
-            {
-                dst.addIdTimeTrace(src.getStreamId(), key_time.first, key_time.second);
-            }
-        }
-        dst.addIdTimeTrace(src.getStreamId(), TimeTraceKey::MIXED, getNowMs32());
+        dst.mergeIdTimeTrace(src.getStreamIndex(), src.getDts(), src);
+        dst.addIdTimeTrace(src.getStreamIndex(), TimeTraceKey::MIXED, getNowMs32());
 
         int x = point.x, y = point.y;
 
@@ -680,51 +679,36 @@ namespace hercules
                 rect.width / 2, rect.height / 2));
 
             cv::Mat formatSrcY, formatSrcU, formatSrcV;
-            resize(srcLocY, formatSrcY, cv::Size(w, h), 0.0, 0.0, RESIZE_ALGORITHM);
-            resize(srcLocU, formatSrcU, cv::Size(w / 2, h / 2), 0.0, 0.0, RESIZE_ALGORITHM);
-            resize(srcLocV, formatSrcV, cv::Size(w / 2, h / 2), 0.0, 0.0, RESIZE_ALGORITHM);
+            resize(srcLocY, formatSrcY, cv::Size(w, h), 0.0, 0.0, m_resizeAlgorithm);
+            resize(srcLocU, formatSrcU, cv::Size(w / 2, h / 2), 0.0, 0.0, m_resizeAlgorithm);
+            resize(srcLocV, formatSrcV, cv::Size(w / 2, h / 2), 0.0, 0.0, m_resizeAlgorithm);
 
             const bool clipPolygonMode = !src.isAlpha() && !clipPolygon.empty();
             if (src.isAlpha() || clipPolygonMode)
             {
                 float alphaRate = src.getAlphaRate();
-                cv::Mat srcMask;
+                cv::Mat srcLocMask, small_mask;
                 if (clipPolygonMode)
-                    srcMask = cv::Mat(h, w, CV_32FC1, alphaRate);
+                {
+                    // both planes straight from the cached coverage, scaled to the alpha rate
+                    const ShapeMask &mask = clipMask(clipPolygon, w, h, clipFactor);
+                    mask.m_luma.convertTo(srcLocMask, CV_32FC1, alphaRate / 255.0);
+                    mask.m_chroma.convertTo(small_mask, CV_32FC1, alphaRate / 255.0);
+                }
                 else
-                    srcMask = src.getAlpha() * alphaRate;
-                cv::Mat srcLocMask, small_mask;
-                cv::resize(srcMask(rect), srcLocMask, cv::Size(w, h), 0.0, 0.0, RESIZE_ALGORITHM);
-
-                if (!clipPolygon.empty())
                 {
-                    TimeUse t("clip polygon", 1);
-
-                    int scale = std::max(1, static_cast<int>(clipFactor));
-                    std::vector<std::vector<cv::Point>> contours_;
-                    contours_.push_back(clipPolygon);
-                    std::vector<cv::Point> &points = contours_.back();
-                    if (scale > 1)
+                    cv::Mat srcMask = src.getAlpha() * alphaRate;
+                    cv::resize(srcMask(rect), srcLocMask, cv::Size(w, h), 0.0, 0.0, m_resizeAlgorithm);
+                    if (!clipPolygon.empty())
                     {
-                        for (auto &point : points)
-                        {
-                            point.x *= scale;
-                            point.y *= scale;
-
-                            logDebug(MIXLOG << "clip pt.x: " << point.x << ", pt.y: " << point.y);
-                        }
+                        cv::Mat alpha;
+                        clipMask(clipPolygon, w, h, clipFactor).m_luma.convertTo(
+                            alpha, CV_32FC1, 1.0 / 255.0);
+                        srcLocMask = srcLocMask.mul(alpha);
                     }
-
-                    Mat alpha = cv::Mat(h * scale, w * scale, CV_32FC1, 0.0f);
-                    cv::fillPoly(alpha, contours_, 1.0f, LineTypes::LINE_AA);
-                    if (scale > 1)
-                        cv::resize(alpha, alpha, cv::Size(w, h), 0.0, 0.0, RESIZE_ALGORITHM);
-
-                    srcLocMask = srcLocMask.mul(alpha);
+                    resize(srcLocMask, small_mask, cv::Size(w / 2, h / 2), 0.0, 0.0, m_resizeAlgorithm);
                 }
 
-                resize(srcLocMask, small_mask, cv::Size(w / 2, h / 2), 0.0, 0.0, RESIZE_ALGORITHM);
-
                 cv::Mat fSrcY, fSrcU, fSrcV, fDstY, fDstU, fDstV;
                 formatSrcY.convertTo(fSrcY, CV_32FC1);
                 formatSrcU.convertTo(fSrcU, CV_32FC1);
@@ -784,6 +768,17 @@ namespace hercules
         return;
     }
 
+    const ShapeMask &OpenCVOperator::clipMask(const std::vector<cv::Point> &clipPolygon, int w, int h,
+        double clipFactor)
+    {
+        TimeUse t("clip polygon", 1);
+
+        // supersampling only helps the anti-aliased edge
+        int scale = m_clipLineType == LineTypes::LINE_AA ? std::max(1, static_cast<int>(clipFactor)) : 1;
+        std::vector<std::vector<cv::Point>> contours(1, clipPolygon);
+        return m_maskCache.polygon(contours, w, h, scale, m_clipLineType);
+    }
+
     void OpenCVOperator::addGif(MediaFrame &dst, const std::string &file, int fps,
                                 cv::Point &point, int w, int h)
     {
@@ -1117,9 +1112,9 @@ namespace hercules
 
             cv::Mat &alpha = const_cast<MediaFrame &>(frame).getAlpha();
             cv::Mat localYAlpha, localUVAlpha;
-            resize(alpha, localYAlpha, cv::Size(scaledw, scaledh), 0, 0, RESIZE_ALGORITHM);
+            resize(alpha, localYAlpha, cv::Size(scaledw, scaledh), 0, 0, m_resizeAlgorithm);
             resize(localYAlpha, localUVAlpha, cv::Size(scaledw / 2, scaledh / 2),
-                   0, 0, RESIZE_ALGORITHM);
+                   0, 0, m_resizeAlgorithm);
 
             cv::Mat yMat;
             cv::Mat uMat;
@@ -1156,9 +1151,9 @@ namespace hercules
             cv::Mat srcVMat = cv::Mat(h / 2, w / 2, CV_8UC1, yuvbuffer + w * h + w / 2 * h / 2);
 
             cv::Mat formatSrcY, formatSrcU, formatSrcV;
-            resize(srcYMat, formatSrcY, cv::Size(scaledw, scaledh), 0, 0, RESIZE_ALGORITHM);
-            resize(srcUMat, formatSrcU, cv::Size(scaledw / 2, scaledh / 2), 0, 0, RESIZE_ALGORITHM);
-            resize(srcVMat, formatSrcV, cv::Size(scaledw / 2, scaledh / 2), 0, 0, RESIZE_ALGORITHM);
+            resize(srcYMat, formatSrcY, cv::Size(scaledw, scaledh), 0, 0, m_resizeAlgorithm);
+            resize(srcUMat, formatSrcU, cv::Size(scaledw / 2, scaledh / 2), 0, 0, m_resizeAlgorithm);
+            resize(srcVMat, formatSrcV, cv::Size(scaledw / 2, scaledh / 2), 0, 0, m_resizeAlgorithm);
 
             formatSrcY.copyTo(dstYMat);
             formatSrcU.copyTo(dstUMat);
@@ -1185,7 +1180,7 @@ namespace hercules
             cv::Mat oriUMat = cv::Mat(h / 2, w / 2, CV_8UC1, oriBuffer + h * w);
             cv::Mat oriVMat = cv::Mat(h / 2, w / 2, CV_8UC1, oriBuffer + h * w + h / 2 * w / 2);
 
-            resize(alpha, localUVAlpha, cv::Size(w / 2, h / 2), 0, 0, RESIZE_ALGORITHM);
+            resize(alpha, localUVAlpha, cv::Size(w / 2, h / 2), 0, 0, m_resizeAlgorithm);
             oriYMat.convertTo(yMat, CV_32FC1);
             oriUMat.convertTo(uMat, CV_32FC1);
             oriVMat.convertTo(vMat, CV_32FC1);
@@ -1275,9 +1270,9 @@ namespace hercules
                                    dstBuffer + dstH * dstW + dstH / 2 * dstW / 2);
 
             cv::Mat fitY, fitU, fitV;
-            resize(baseLocY, fitY, cv::Size(dstW, dstH), 0.0, 0.0, RESIZE_ALGORITHM);
-            resize(baseLocU, fitU, cv::Size(dstW / 2, dstH / 2), 0.0, 0.0, RESIZE_ALGORITHM);
-            resize(baseLocV, fitV, cv::Size(dstW / 2, dstH / 2), 0.0, 0.0, RESIZE_ALGORITHM);
+            resize(baseLocY, fitY, cv::Size(dstW, dstH), 0.0, 0.0, m_resizeAlgorithm);
+            resize(baseLocU, fitU, cv::Size(dstW / 2, dstH / 2), 0.0, 0.0, m_resizeAlgorithm);
+            resize(baseLocV, fitV, cv::Size(dstW / 2, dstH / 2), 0.0, 0.0, m_resizeAlgorithm);
 
             fitY.copyTo(dstY);
             fitU.copyTo(dstU);
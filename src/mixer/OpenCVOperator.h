@@ -15,6 +15,7 @@
 #pragma once
 
 #include "GifUtil.h"
+#include "MaskCache.h"
 
 #include "opencv2/opencv.hpp"
 
@@ -65,6 +66,10 @@ namespace hercules
 
         void setFontType(const std::string &file);
 
+        // cheaper scaling and hard clip edges, used when the host is overloaded
+        void setFastResize(bool fast);
+        void setAntiAlias(bool antiAlias);
+
         void getWordSize(const std::string &, cv::Size &result, const std::string &fontName,
             int font_size, int leanType = 1, float inclination = 0);
 
@@ -114,11 +119,16 @@ namespace hercules
         int getYUVMat(cv::Mat &YUVMat, cv::Mat &BGRMat);
         int getRGBMat(cv::Mat &YUVMat, cv::Mat &BGRMat);
         CvxText *getFont(const std::string &);
+        const ShapeMask &clipMask(const std::vector<cv::Point> &clipPolygon, int w, int h,
+            double clipFactor);
 
     private:
         OpenCVOperator(const OpenCVOperator &);
 
     private:
+        int m_resizeAlgorithm;
+        int m_clipLineType;
+        MaskCache m_maskCache;
         CvxText *m_default_font;
         std::map<std::string, CvxText *> m_font_map;
 